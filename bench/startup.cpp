@@ -0,0 +1,106 @@
+#include <fcntl.h>
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "debug_info.hpp"
+
+
+// Startup cost of the debug info of each binary: open the ELF, load the DWARF and walk
+// the root DIE and line table of every unit, the part of startup that grows with the
+// debug sections. Run it on test_types and test_types_gz to compare compressed and
+// uncompressed sections.
+//
+//   bench_startup [-n <runs>] <binary>...
+
+namespace {
+
+    double load_once( const std::string& path, std::size_t& lines ) {
+
+        auto start = std::chrono::steady_clock::now();
+
+        int fd = ::open( path.c_str(), O_RDONLY );
+
+        if ( fd < 0 ) {
+            return -1;
+        }
+
+        elf::elf elf( elf::create_mmap_loader( fd ) );
+        MiniDbg::DebugFile separate;
+        dwarf::dwarf dwarf = MiniDbg::load_dwarf( elf, path, separate );
+
+        lines = 0;
+
+        if ( dwarf.valid() ) {
+
+            for ( const dwarf::compilation_unit& cu : dwarf.compilation_units() ) {
+
+                cu.root().has( dwarf::DW_AT::name );
+
+                for ( auto it = cu.get_line_table().begin(); it != cu.get_line_table().end(); ++it ) {
+                    ++lines;
+                }
+            }
+        }
+
+        MiniDbg::close_debug_file( separate );
+
+        return std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count();
+    }
+}
+
+
+int main( int argc, char* argv[] ) {
+
+    int runs = 20;
+    int first = 1;
+
+    if ( argc > 2 && std::string( argv[1] ) == "-n" ) {
+
+        runs = std::stoi( argv[2] );
+        first = 3;
+    }
+
+    if ( first >= argc ) {
+
+        std::cerr << "usage: " << argv[0] << " [-n <runs>] <binary>..." << std::endl;
+        return 1;
+    }
+
+    std::cout << std::left << std::setw( 40 ) << "binary" << std::right << std::setw( 10 ) << "lines"
+              << std::setw( 12 ) << "min ms" << std::setw( 12 ) << "median ms" << std::endl;
+
+    for ( int i = first; i < argc; ++i ) {
+
+        std::vector<double> times;
+        std::size_t lines = 0;
+
+        for ( int run = 0; run < runs; ++run ) {
+
+            double ms = load_once( argv[i], lines );
+
+            if ( ms < 0 ) {
+                break;
+            }
+
+            times.push_back( ms );
+        }
+
+        if ( times.empty() ) {
+
+            std::cerr << "[" << "Cannot open " << argv[i] << "]" << std::endl;
+            continue;
+        }
+
+        std::sort( times.begin(), times.end() );
+
+        std::cout << std::left << std::setw( 40 ) << argv[i] << std::right << std::setw( 10 ) << lines
+                  << std::fixed << std::setprecision( 3 ) << std::setw( 12 ) << times.front()
+                  << std::setw( 12 ) << times[ times.size() / 2 ] << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,66 @@
+#ifndef MINIDBG_ADDRESS_SPACE_HPP
+#define MINIDBG_ADDRESS_SPACE_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+
+namespace MiniDbg {
+
+    struct MemoryRegion {
+
+        enum Permission : std::uint8_t { read = 1, write = 2, execute = 4, shared = 8 };
+
+        std::uint64_t start;    // [start, end)
+        std::uint64_t end;
+        std::uint8_t permissions;
+        std::uint64_t offset;   // into the mapped file
+        std::string path;       // file, [heap], [stack], [vdso], ... or empty for anonymous memory
+
+        bool allows( std::uint8_t wanted ) const { return ( permissions & wanted ) == wanted; }
+    };
+
+    // Per region counters from /proc/<pid>/smaps, in kB
+    struct RegionUsage {
+
+        std::uint64_t rss = 0;
+        std::uint64_t pss = 0;
+        std::uint64_t private_dirty = 0;
+        std::uint64_t swap = 0;
+    };
+
+    // /proc/<pid>/maps parsed into regions sorted by address. The inferior can only
+    // change its mappings while it runs, so the map remembers the process and the run
+    // generation it was read in and parses the file again on the first lookup after a
+    // resume or for another pid.
+    class AddressSpace {
+
+    public:
+
+        void clear();
+
+        // nullptr when address is not mapped
+        const MemoryRegion* find( pid_t pid, std::uint64_t generation, std::uint64_t address );
+
+        // true when [address, address + size) is mapped with at least these permissions
+        bool check( pid_t pid, std::uint64_t generation, std::uint64_t address, std::size_t size, std::uint8_t permissions );
+
+        const std::vector<MemoryRegion>& regions( pid_t pid, std::uint64_t generation );
+
+        // smaps is expensive to produce for the kernel, only read when asked for
+        std::vector<RegionUsage> usage( pid_t pid );
+
+    private:
+
+        void refresh( pid_t pid, std::uint64_t generation );
+
+        std::vector<MemoryRegion> m_regions;
+        pid_t m_pid = 0;
+        std::uint64_t m_generation = 0;
+        bool m_valid = false;
+    };
+}
+
+#endif
@@ -11,34 +11,35 @@ namespace MiniDbg {
     
     public:
 
-        Breakpoint( pid_t pid, std::intptr_t addr ) : m_pid( pid ), m_addr( addr ), m_enabled( false ), m_saved_data( 0 ) {}
+        Breakpoint( std::intptr_t addr ) : m_addr( addr ), m_enabled( false ), m_saved_data( 0 ) {}
 
-        void Enable() {
+        // tid may be any ptrace-stopped thread of the process, memory is shared between them
+        void Enable( pid_t tid ) {
         
-            long data = ::ptrace( PTRACE_PEEKDATA, m_pid, m_addr, nullptr );
+            long data = ::ptrace( PTRACE_PEEKDATA, tid, m_addr, nullptr );
             m_saved_data = static_cast<uint8_t>( data & 0xFF ); //save bottom byte
             
             long int3 = 0xCC;
             long data_with_int3 = ( ( data & ~0xFF ) | int3 ); //set bottom byte to 0xcc
 
-            ::ptrace( PTRACE_POKEDATA, m_pid, m_addr, data_with_int3 );
+            ::ptrace( PTRACE_POKEDATA, tid, m_addr, data_with_int3 );
             m_enabled = true;
         }
 
-        void Disable() {
+        void Disable( pid_t tid ) {
 
-            long data = ::ptrace( PTRACE_PEEKDATA, m_pid, m_addr, nullptr );
+            long data = ::ptrace( PTRACE_PEEKDATA, tid, m_addr, nullptr );
             long restored_data = ( ( data & ~0xFF )  | m_saved_data );
-            ::ptrace( PTRACE_POKEDATA, m_pid, m_addr, restored_data );
+            ::ptrace( PTRACE_POKEDATA, tid, m_addr, restored_data );
             m_enabled = false;
         }
 
         bool is_enabled() const { return m_enabled; }      
         std::intptr_t get_address() const { return m_addr; }
+        uint8_t get_saved_data() const { return m_saved_data; }
     
     private:
 
-        pid_t m_pid;
         std::intptr_t m_addr;
         bool m_enabled;
         uint8_t m_saved_data; //data which used to be at the breakpoint address
@@ -46,4 +47,3 @@ namespace MiniDbg {
 }
 
 #endif
-
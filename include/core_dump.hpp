@@ -0,0 +1,46 @@
+#ifndef MINIDBG_CORE_DUMP_HPP
+#define MINIDBG_CORE_DUMP_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+#include <sys/user.h>
+
+#include "address_space.hpp"
+
+
+namespace MiniDbg {
+
+    // Registers of one ptrace-stopped thread, as the core notes want them
+    struct CoreThread {
+
+        pid_t tid;
+        int signal = 0;                         // pending, the one that stopped it
+        user_regs_struct regs;
+        user_fpregs_struct fpregs;
+        std::vector<std::uint8_t> xstate;       // PTRACE_GETREGSET NT_X86_XSTATE, empty when unsupported
+    };
+
+    CoreThread capture_core_thread( pid_t tid, int signal );
+
+    struct CoreDumpStats {
+
+        std::size_t segments = 0;
+        std::uint64_t memory = 0;       // bytes of segment data in the file
+        std::uint64_t written = 0;      // of those, not left as a hole for being zero
+        double seconds = 0;
+    };
+
+    // ELF core of a stopped process: a PT_LOAD per mapping and NT_PRPSINFO, NT_AUXV,
+    // NT_FILE and per thread NT_PRSTATUS, NT_FPREGSET and NT_X86_XSTATE, the first thread
+    // being the one gdb shows. Like the kernel's default coredump_filter, read-only file
+    // mappings keep only their first page (the ELF header, for the build-id), the rest is
+    // in the file they map. Memory is read in large process_vm_readv chunks, each
+    // written out on a second thread while the next is read, and zero pages are left as
+    // holes of a sparse file.
+    bool write_core_file( const std::string& path, pid_t pid, const std::vector<MemoryRegion>& regions,
+                          const std::vector<CoreThread>& threads, CoreDumpStats& stats, std::string& error );
+}
+
+#endif
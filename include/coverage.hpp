@@ -0,0 +1,88 @@
+#ifndef MINIDBG_COVERAGE_HPP
+#define MINIDBG_COVERAGE_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <set>
+#include <ostream>
+#include <sys/types.h>
+
+#include "dwarf/dwarf++.hh"
+#include "elf/elf++.hh"
+
+#include "debug_info.hpp"
+
+
+namespace MiniDbg {
+
+    // Line coverage of an unmodified binary. Every is_stmt address of the program's line
+    // tables gets an int3 before the first instruction runs; a hit restores the original
+    // byte and the thread goes on from there, so code that ran once is back to native
+    // speed. The int3s go in with one /proc/<pid>/mem read and write per run of nearby
+    // addresses instead of a PEEKDATA and a POKEDATA each. Only the program itself is
+    // covered, not its shared libraries; a fork child gets its copy of the int3s
+    // removed and runs untraced, a vfork child shares them until it calls exec.
+    class CoverageRun {
+
+    public:
+
+        explicit CoverageRun( std::vector<std::string> argv ) : m_argv( std::move( argv ) ) {}
+        ~CoverageRun();
+
+        bool prepare();
+
+        // Until the program exits, status as waitpid gave it
+        bool run( int& status );
+
+        // lcov tracefile, DA:<line>,<0|1> per instrumented line
+        bool write_lcov( const std::string& path ) const;
+        void print_summary( std::ostream& os ) const;
+
+    private:
+
+        struct Probe {
+
+            std::uint64_t address;      // unrelocated
+            std::vector<std::uint32_t> lines;   // into m_lines, every line with a row at this address
+            std::uint8_t saved = 0;
+            bool armed = false;
+        };
+
+        struct Line {
+
+            std::string file;
+            unsigned number;
+            bool hit = false;
+        };
+
+        bool launch();
+        bool arm();
+        bool disarm_all( pid_t pid );
+        bool handle_trap( pid_t tid );
+        void handle_new_process( pid_t pid, bool vfork );
+        Probe* find_probe( std::uint64_t address );
+
+        std::vector<std::string> m_argv;
+
+        elf::elf m_elf;
+        dwarf::dwarf m_dwarf;
+        DebugFile m_debug_file;
+
+        std::vector<Probe> m_probes;        // sorted by address
+        std::vector<Line> m_lines;
+
+        pid_t m_pid = 0;
+        int m_mem_fd = -1;                  // /proc/<pid>/mem, writes go through read-only text
+        std::uint64_t m_load_address = 0;
+
+        std::set<pid_t> m_forked;           // fork children whose first stop is still to come
+        std::set<pid_t> m_vforked;
+        std::set<pid_t> m_early;            // stopped before their parent's event said what they are
+
+        double m_arm_ms = 0;
+        std::size_t m_writes = 0;
+    };
+}
+
+#endif
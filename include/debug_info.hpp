@@ -0,0 +1,52 @@
+#ifndef MINIDBG_DEBUG_INFO_HPP
+#define MINIDBG_DEBUG_INFO_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "dwarf/dwarf++.hh"
+#include "elf/elf++.hh"
+
+#include "section_loader.hpp"
+
+
+namespace MiniDbg {
+
+    // A separate debug file, kept mapped for as long as the DWARF built from it is in use.
+    // sections reads the debug sections the DWARF came from, this file or the binary.
+    struct DebugFile {
+
+        std::string path;
+        elf::elf elf;
+        std::shared_ptr<SectionLoader> sections;
+    };
+
+    // Directories searched for separate debug files, /usr/lib/debug unless set
+    void set_debug_file_directories( const std::vector<std::string>& directories );
+    const std::vector<std::string>& debug_file_directories();
+
+    // Hex NT_GNU_BUILD_ID of a binary, empty without one
+    std::string read_build_id( const elf::elf& elf );
+
+    // CRC-32 as used by .gnu_debuglink, of the whole file
+    bool file_crc32( const std::string& path, std::uint32_t& crc );
+    std::uint32_t crc32( std::uint32_t crc, const void* data, std::size_t size );
+
+    // The separate debug file of the binary at path: <dir>/.build-id/xx/rest.debug with a
+    // matching build-id first, then the .gnu_debuglink name next to the binary, in its .debug
+    // directory and under every debug directory, accepted only when the CRC matches. Empty
+    // when nothing matches.
+    std::string find_debug_file( const elf::elf& elf, const std::string& path );
+
+    // DWARF of the binary at path, from its own sections or from its separate debug file,
+    // which is opened into separate. Compressed sections are expanded as they are read.
+    // Invalid when neither has any.
+    dwarf::dwarf load_dwarf( const elf::elf& elf, const std::string& path, DebugFile& separate );
+
+    void close_debug_file( DebugFile& separate );
+}
+
+#endif
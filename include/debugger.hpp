@@ -4,6 +4,9 @@
 #include <utility>
 #include <string>
 #include <unordered_map>
+#include <map>
+#include <atomic>
+#include <set>
 
 #include <linux/types.h>
 #include <sys/stat.h>
@@ -18,6 +21,22 @@
 #include "breakpoint.hpp"
 #include "symbols.hpp"
 #include "dwarf_helpers.hpp"
+#include "function_index.hpp"
+#include "unwinder.hpp"
+#include "types.hpp"
+#include "location.hpp"
+#include "perf_counters.hpp"
+#include "threads.hpp"
+#include "spsc_queue.hpp"
+#include "inferior.hpp"
+#include "display.hpp"
+#include "modules.hpp"
+#include "address_space.hpp"
+#include "debug_info.hpp"
+#include "syscalls.hpp"
+#include "signals.hpp"
+#include "snapshot.hpp"
+#include "heap_tracker.hpp"
 
 
 namespace MiniDbg {
@@ -40,6 +59,7 @@ namespace MiniDbg {
         void handle_command( const std::string& line );
 
         void continue_execution();
+        void resume_execution();
         void process_status( int status );
 
         void set_breakpoint_at_address( std::intptr_t addr );   
@@ -47,17 +67,38 @@ namespace MiniDbg {
         void set_breakpoint_at_source_line( const std::string& file, unsigned line );
         void remove_breakpoint( std::intptr_t addr );
         void step_over_breakpoint();
+        bool displaced_step( const Breakpoint& bp );
+        void step_over_in_place( Breakpoint& bp );
+        bool single_step_thread( ThreadState& thread, int& signal );
+        uint64_t displaced_scratch_area( uint64_t pc );
+        const DisplacedInstruction& prepare_displaced_instruction( uint64_t pc );
 
         void dump_registers(); 
         void print_backtrace();
+        std::vector<UnwoundFrame> unwind_stack( std::size_t max_frames );
+        bool get_return_address( uint64_t& return_address );
         void read_variables();
+        void read_scope_variables( const dwarf::die& scope, uint64_t pc );
+        dwarf::die find_variable( const std::string& name, uint64_t pc );
+        dwarf::die find_global_variable( const std::string& name );
+        bool locate_variable( const dwarf::die& variable, ValueRef& value, bool globals_only = false );
+        bool format_variable( const ValueRef& value, std::string& out );
+        bool dereference( ValueRef& value );
+        bool evaluate_expression( const std::string& expression, ValueRef& value, bool globals_only = false );
+        std::string format_contents( const ValueRef& value, const std::uint8_t* data );
+        void print_expression( const std::string& expression );
+
+        void add_display( const std::string& expression );
+        void remove_display( int number );
+        void show_displays( int number = 0 );
         
         uint64_t get_pc();
         uint64_t get_offset_pc();
         void set_pc( uint64_t pc );
 
         void wait_for_signal();
-        siginfo_t get_signal_info();
+        bool process_wait_event( pid_t tid, int status );
+        siginfo_t get_signal_info( pid_t tid );
         void handle_sigtrap( siginfo_t info );
 
         void initialize_load_address();
@@ -77,31 +118,153 @@ namespace MiniDbg {
         void step_out();
         void step_in();
         void step_over();
+        void run_until( uint64_t address );
+        void finish_inlined_frame( const InlinedFrame& frame );
 
         std::vector<Symbol> lookup_symbol( const std::string& name );
 
-        void execute_debuggee( const std::string& prog_name ) ;
+        void execute_debuggee( const std::string& prog_name, const std::vector<sock_filter>& filter ) ;
         void attach_to_debuggee( const int pid ) ;
         void launch_debuggee( const std::string& prog_name );
-        void detach_debuggee();
+        void detach_debuggee( bool force );
+
+        void load_debug_info( const std::string& path );
+        const dwarf::dwarf& debug_dwarf();
+        FunctionIndex& function_index();
+        void profile( unsigned hz, unsigned seconds, pid_t pid );
+        void monitor( const std::vector<std::string>& args );
+
+        void set_stat_mode( bool enabled );
+        void print_stat();
+
+        ThreadState& add_thread( pid_t tid, pid_t pid );
+        ThreadState& current_thread();
+        bool seize_threads( pid_t pid );
+        void detach_threads();
+        void resume_thread( ThreadState& thread, __ptrace_request request );
+        void resume_all_threads();
+        void stop_all_threads( pid_t pid = 0 );     // 0: the threads of every inferior
+        void interrupt_thread( ThreadState& thread );
+        bool handle_thread_event( pid_t tid, int status );
+        void report_thread_stop( const ThreadState& thread );
+        void print_threads();
+        void select_thread( int number );
+        bool check_thread_stopped();
+        void handle_set_command( const std::vector<std::string>& args );
+
+        bool setup_event_loop();
+        void tracer_loop();
+        bool poll_inferior_events( int timeout_ms );
+        bool drain_wait_events();
+        void interrupt_inferior();
+        int watch_inferior_exit( pid_t pid );
+        void notify_command_done();
+
+        int add_inferior( pid_t parent_pid, pid_t child_pid );
+        int inferior_number( pid_t pid );
+        bool is_inferior( pid_t pid );
+        bool is_breakpoint( pid_t pid, uint64_t addr );
+        void switch_to_inferior( int number );
+        void select_next_inferior();
+        void print_inferiors();
+        bool handle_fork_event( ThreadState& parent, bool vfork );
+        void handle_vfork_done( ThreadState& thread );
+        void handle_exec_event( ThreadState& thread );
+        void handle_inferior_exit( pid_t pid, int status );
+        void detach_pending_inferiors();
+
+        void initialize_modules();
+        bool handle_solib_event( pid_t tid );
+        void update_modules();
+        bool set_module_breakpoint( Module& module, const std::string& location );
+        void print_module_location( const Module& module, uint64_t pc );
+        void print_shared_libraries();
+
+        const MemoryRegion* find_region( uint64_t address );
+        bool check_memory( uint64_t address, std::size_t size, std::uint8_t permissions );
+        void print_mappings( bool usage );
+        void find_memory( const std::vector<std::string>& args );
+        void snapshot( const std::vector<std::string>& args );
+
+        void heaptrack( const std::vector<std::string>& args );
+        void arm_heap_breakpoints( const elf::elf& elf, uint64_t load_address, bool dynamic_only );
+        void stop_heap_tracking( bool disarm );
+        bool handle_heap_event( pid_t tid );
+        std::string describe_return_address( uint64_t pc );
+        void print_heap_report( const std::string& title );
+
+        void gcore( const std::vector<std::string>& args );
+
+        void catch_syscall( const std::vector<std::string>& args );
+        void remove_catchpoint( int number );
+        void print_catchpoints();
+        std::set<long> caught_syscalls();
+        bool syscall_stops_needed( pid_t pid );
+        bool handle_syscall_stop( ThreadState& thread, bool seccomp );
+        void print_syscall_stop( const ThreadState& thread );
+        void pass_through_process( pid_t pid );
+        bool handle_passthrough_event( pid_t tid, int status );
 
         void clear_debuggee_data();
+        void forget_untraced_process( const std::string& prog_name );
         std::string get_executable_path_by_pid( const int pid );
 
     private:    
 
-        std::string m_prog_name;
-        pid_t m_pid;
-        
-        uint64_t m_load_address = 0;
-        dwarf::dwarf m_dwarf;
-        elf::elf m_elf;
-        int m_fd;
+        std::map<pid_t, ThreadState> m_threads;
+        int m_next_thread_number = 1;
+        bool m_non_stop = false;
+
+        static constexpr std::size_t max_backtrace_frames = 256;
+
+        static constexpr long ptrace_options = PTRACE_O_TRACECLONE | PTRACE_O_TRACEFORK | PTRACE_O_TRACEVFORK |
+                                               PTRACE_O_TRACEVFORKDONE | PTRACE_O_TRACEEXEC | PTRACE_O_TRACESYSGOOD |
+                                               PTRACE_O_TRACESECCOMP;
+
+        // every inferior, the selected one included; the map never moves an entry, so the
+        // per-process state is reached through m_inferior and nothing has to be swapped
+        std::map<int, Inferior> m_inferiors;
+        Inferior* m_inferior = nullptr;
+        int m_inferior_number = 1;
+        int m_next_inferior_number = 2;
+        bool m_follow_fork_child = false;
+        bool m_detach_on_fork = true;
+        std::vector<pid_t> m_pending_detach;
+        std::set<pid_t> m_vfork_parents;      // breakpoints lifted while a detached vfork child shares memory
+
+        uint64_t m_run_generation = 1;                      // bumped on every resume, the mappings may have changed since
+
+        HeapTracker m_heap_tracker;
+        pid_t m_heap_pid = 0;                               // the process being tracked, 0 when off
+        std::unordered_map<uint64_t, HeapFunction> m_heap_entries;
+        std::set<uint64_t> m_heap_returns;                  // call sites an allocator returns to
+        std::set<uint64_t> m_heap_breakpoints;              // inserted by the tracker, never reported
 
-        std::unordered_map<std::intptr_t, Breakpoint> m_breakpoints;
+        PerfCounters m_perf_counters;
+        bool m_stat_enabled = false;
+
+        std::vector<SyscallCatchpoint> m_catchpoints;
+        int m_next_catchpoint_number = 1;
+        std::map<pid_t, std::set<long>> m_seccomp_filters;  // syscalls the filter of each process traps, the rest need PTRACE_SYSCALL
+        std::set<pid_t> m_passthrough;                      // filtered processes kept seized after a detach, only resumed
+
+        SignalTable m_signals;
+
+        std::vector<Display> m_displays;
+        int m_next_display_number = 1;
 
         State m_state = State::NOT_RUNNING;
 
+        // the tracer thread owns every ptrace call, the UI thread only edits lines
+        SpscQueue<std::string, 64> m_commands;
+        std::atomic<bool> m_quit { false };
+
+        int m_epoll_fd = -1;            // tracer: commands + inferior events
+        int m_inferior_epoll_fd = -1;   // signalfd and pidfds, also used while a command waits for a stop
+        int m_signal_fd = -1;           // SIGCHLD, SIGINT
+        int m_command_fd = -1;          // eventfd, UI -> tracer
+        int m_done_fd = -1;             // eventfd, tracer -> UI
+
     };
 }
 
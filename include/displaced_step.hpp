@@ -0,0 +1,34 @@
+#ifndef MINIDBG_DISPLACED_STEP_HPP
+#define MINIDBG_DISPLACED_STEP_HPP
+
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+
+#include "x86_decoder.hpp"
+
+
+namespace MiniDbg {
+
+    // Copy of the instruction under a breakpoint, relocated to run from the scratch area
+    struct DisplacedInstruction {
+
+        bool usable = false;            // false: step it in place with the int3 lifted
+        std::uint64_t scratch = 0;      // where the copy runs, in or next to the module holding it
+        std::array<std::uint8_t, 16> bytes {};
+        Instruction insn;
+    };
+
+    // Per inferior: a rip-relative operand only reaches +-2 GiB, so every module gets its own
+    // scratch area, the slack after its executable segment in the last page of the mapping.
+    // The executable uses its ELF entry point, which is never executed again once the program
+    // is running. Decoded instructions are cached per breakpoint address and the copy sitting
+    // in each scratch area is remembered to skip rewriting it.
+    struct DisplacedStepping {
+
+        std::unordered_map<std::uint64_t, std::uint64_t> loaded;    // scratch area -> breakpoint address
+        std::unordered_map<std::uint64_t, DisplacedInstruction> cache;
+    };
+}
+
+#endif
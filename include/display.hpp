@@ -0,0 +1,21 @@
+#ifndef MINIDBG_DISPLAY_HPP
+#define MINIDBG_DISPLAY_HPP
+
+#include <string>
+
+
+namespace MiniDbg {
+
+    // Expression printed at every stop. The text shown last time is kept so the next
+    // stop can highlight a change; the raw bytes of the object alone would miss the
+    // elements of a pretty-printed container, which live elsewhere.
+    struct Display {
+
+        int number = 0;
+        std::string expression;
+        std::string last;
+        bool shown = false;
+    };
+}
+
+#endif
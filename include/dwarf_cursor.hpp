@@ -0,0 +1,90 @@
+#ifndef MINIDBG_DWARF_CURSOR_HPP
+#define MINIDBG_DWARF_CURSOR_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+
+namespace MiniDbg {
+
+    // Bounds checked reader over DWARF data (CFI, location expressions and lists),
+    // a read past the end yields 0 and clears ok
+    struct Cursor {
+
+        const std::uint8_t* p;
+        const std::uint8_t* end;
+        bool ok = true;
+
+        Cursor( const std::uint8_t* begin, const std::uint8_t* limit ) : p( begin ), end( limit ) {}
+
+        bool more() const { return ok && p < end; }
+
+        template<typename T>
+        T fixed() {
+
+            T value {};
+
+            if ( end - p < static_cast<std::ptrdiff_t>( sizeof( T ) ) ) {
+
+                ok = false;
+                p = end;
+                return value;
+            }
+
+            std::memcpy( &value, p, sizeof( T ) );
+            p += sizeof( T );
+            return value;
+        }
+
+        std::uint64_t uleb() {
+
+            std::uint64_t result = 0;
+            int shift = 0;
+
+            while ( true ) {
+
+                std::uint8_t b = fixed<std::uint8_t>();
+                result |= shift < 64 ? static_cast<std::uint64_t>( b & 0x7F ) << shift : 0;
+                shift += 7;
+
+                if ( !ok || !( b & 0x80 ) ) {
+                    return result;
+                }
+            }
+        }
+
+        std::int64_t sleb() {
+
+            std::int64_t result = 0;
+            int shift = 0;
+            std::uint8_t b;
+
+            do {
+                b = fixed<std::uint8_t>();
+                result |= shift < 64 ? static_cast<std::int64_t>( b & 0x7F ) << shift : 0;
+                shift += 7;
+            } while ( ok && ( b & 0x80 ) );
+
+            if ( shift < 64 && ( b & 0x40 ) ) {
+                result |= -( static_cast<std::int64_t>( 1 ) << shift );
+            }
+
+            return result;
+        }
+
+        void skip( std::uint64_t n ) {
+
+            if ( static_cast<std::uint64_t>( end - p ) < n ) {
+
+                ok = false;
+                p = end;
+                return;
+            }
+
+            p += n;
+        }
+    };
+}
+
+#endif
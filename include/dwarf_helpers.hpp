@@ -34,9 +34,16 @@ class ptrace_expr_context : public dwarf::expr_context {
 
         dwarf::taddr deref_size (dwarf::taddr address, unsigned size) override {
 
-            //std::cerr << "deref_size" << std::hex << address << std::endl;
-            
-            return ptrace( PTRACE_PEEKDATA, m_pid, address + m_load_address, nullptr );
+            // addresses on the expression stack are already runtime addresses,
+            // and DW_OP_deref_size only wants the low size bytes of the word
+            dwarf::taddr value = ptrace( PTRACE_PEEKDATA, m_pid, address, nullptr );
+
+            if ( size < sizeof( value ) ) {
+
+                value &= ( dwarf::taddr( 1 ) << ( size * 8 ) ) - 1;
+            }
+
+            return value;
         }
 
     private:
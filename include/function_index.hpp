@@ -0,0 +1,70 @@
+#ifndef MINIDBG_FUNCTION_INDEX_HPP
+#define MINIDBG_FUNCTION_INDEX_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "dwarf/dwarf++.hh"
+#include "elf/elf++.hh"
+
+
+namespace MiniDbg {
+
+    struct FunctionEntry {
+
+        std::uint64_t low;      // unrelocated addresses, [low, high)
+        std::uint64_t high;
+        std::string name;
+        dwarf::die die;         // invalid for functions known only from the symbol table
+    };
+
+    struct InlinedFrame {
+
+        dwarf::die die;             // DW_TAG_inlined_subroutine, the DW_TAG_subprogram for the outermost frame
+        std::string name;
+        std::string call_file;      // call site in the caller, empty for the outermost frame
+        unsigned call_line = 0;
+    };
+
+    // Sorted address -> function table built once from DW_TAG_subprogram ranges,
+    // with ELF function symbols filling the gaps left by code without debug info.
+    class FunctionIndex {
+
+    public:
+
+        void build( const elf::elf& elf, const dwarf::dwarf& dwarf );
+        void clear();
+
+        const FunctionEntry* find( std::uint64_t pc ) const;
+        std::size_t size() const { return m_entries.size(); }
+
+        // Frames inlined at pc, innermost first and the physical function last.
+        // Empty when pc is not covered by a DWARF function.
+        std::vector<InlinedFrame> inline_chain( std::uint64_t pc );
+
+    private:
+
+        // Inlined ranges of one function in preorder: sorted by low, enclosing ranges
+        // first, end is the index past the last range nested inside this one
+        struct InlineRange {
+
+            std::uint64_t low;
+            std::uint64_t high;
+            unsigned depth;
+            dwarf::die die;
+            std::size_t end;
+        };
+
+        void add_dwarf_functions( const dwarf::die& parent );
+        const std::vector<InlineRange>& inline_ranges( const FunctionEntry& func );
+
+        std::vector<FunctionEntry> m_entries;
+        std::unordered_map<std::uint64_t, std::vector<InlineRange>> m_inline_ranges;    // by function low, built on first use
+    };
+
+    std::string get_function_name( const dwarf::die& die );
+}
+
+#endif
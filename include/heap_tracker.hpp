@@ -0,0 +1,99 @@
+#ifndef MINIDBG_HEAP_TRACKER_HPP
+#define MINIDBG_HEAP_TRACKER_HPP
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <sys/types.h>
+#include <sys/user.h>
+
+
+namespace MiniDbg {
+
+    enum class HeapFunction { malloc, calloc, realloc, free };
+
+    const char* to_string( HeapFunction function );
+
+    // Return addresses, innermost first: the caller of the allocator and a few above it
+    constexpr std::size_t heap_stack_depth = 4;
+    using HeapStack = std::array<std::uint64_t, heap_stack_depth>;
+
+    // Copies the top of the stack of a thread stopped on the first instruction of an
+    // allocator and walks its frame pointers. Frames without one end the stack early.
+    HeapStack capture_heap_stack( pid_t tid, const user_regs_struct& regs );
+
+    // Live heap blocks of one process, filled from breakpoints on the allocator entry
+    // points and on the return addresses of their callers. A call is kept per thread
+    // between the two, the pointer is only known once the allocator returns.
+    class HeapTracker {
+
+    public:
+
+        // True when the return must be caught. A call made while the same thread is
+        // still inside an allocator (realloc using malloc, a PLT stub then the function)
+        // is nested in the outer one and ignored.
+        bool enter( pid_t tid, HeapFunction function, const user_regs_struct& regs, const HeapStack& stack );
+
+        // The thread reached return_address: true when it finished a pending call
+        bool leave( pid_t tid, std::uint64_t return_address, std::uint64_t result );
+
+        void forget_thread( pid_t tid ) { m_calls.erase( tid ); }
+        void clear();
+
+        // Call sites by live bytes, each stack as symbolize names it
+        void print_report( std::ostream& os, const std::function<std::string( std::uint64_t pc )>& symbolize, std::size_t top_n ) const;
+
+        std::size_t live_blocks() const { return m_blocks.size(); }
+
+    private:
+
+        struct Call {
+
+            HeapFunction function;
+            std::uint64_t size;
+            std::uint64_t pointer;          // realloc's old block
+            std::uint64_t stack_pointer;    // at entry, an outer call has a higher one
+            std::uint64_t return_address;
+            std::uint32_t site;
+        };
+
+        struct Site {
+
+            HeapStack stack;
+            std::uint64_t live_bytes = 0;
+            std::uint64_t live_blocks = 0;
+            std::uint64_t allocations = 0;
+            std::uint64_t bytes = 0;
+        };
+
+        struct Block {
+
+            std::uint64_t size;
+            std::uint32_t site;
+        };
+
+        std::uint32_t site_of( const HeapStack& stack );
+        void allocate( std::uint64_t pointer, std::uint64_t size, std::uint32_t site );
+        void release( std::uint64_t pointer );
+
+        std::unordered_map<pid_t, Call> m_calls;
+        std::unordered_map<std::uint64_t, Block> m_blocks;
+        std::vector<Site> m_sites;
+        std::map<HeapStack, std::uint32_t> m_site_index;
+
+        std::uint64_t m_live_bytes = 0;
+        std::uint64_t m_peak_bytes = 0;
+        std::uint64_t m_allocations = 0;
+        std::uint64_t m_frees = 0;
+        std::uint64_t m_unknown_frees = 0;     // blocks from before tracking started
+        std::uint64_t m_failures = 0;
+    };
+}
+
+#endif
@@ -3,7 +3,9 @@
 
 #include <string>
 #include <vector>
+#include <set>
 #include <sstream>
+#include <sys/types.h>
 
 std::vector<std::string> split( const std::string& s, char delimiter ) ;
 
@@ -11,4 +13,16 @@ bool is_prefix( const std::string& s, const std::string& of ) ;
 
 bool is_suffix( const std::string& s, const std::string& of ) ;
 
+std::string skip_words( const std::string& line, std::size_t n ) ;
+
+// The threads of a process from /proc/<pid>/task, empty when it is gone
+std::vector<pid_t> list_threads( pid_t pid ) ;
+
+// The thread group of a thread, tid itself when /proc can't tell
+pid_t read_tgid( pid_t tid ) ;
+
+// Seizes every thread of pid not in seized yet, rescanning until no new one shows up.
+// Returns the newly seized threads, also added to seized; interrupt stops each one right away.
+std::vector<pid_t> seize_all_threads( pid_t pid, long options, std::set<pid_t>& seized, bool interrupt ) ;
+
 #endif
\ No newline at end of file
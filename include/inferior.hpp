@@ -0,0 +1,56 @@
+#ifndef MINIDBG_INFERIOR_HPP
+#define MINIDBG_INFERIOR_HPP
+
+#include <string>
+#include <unordered_map>
+#include <cstdint>
+#include <sys/types.h>
+
+#include "dwarf/dwarf++.hh"
+#include "elf/elf++.hh"
+
+#include "breakpoint.hpp"
+#include "function_index.hpp"
+#include "displaced_step.hpp"
+#include "unwinder.hpp"
+#include "types.hpp"
+#include "location.hpp"
+#include "modules.hpp"
+#include "address_space.hpp"
+#include "debug_info.hpp"
+#include "snapshot.hpp"
+
+
+namespace MiniDbg {
+
+    // Per-process state of an inferior. Every one lives in Debugger::m_inferiors and
+    // the selected one is reached through Debugger::m_inferior, so state added here
+    // follows its process without any copying on a switch.
+    struct Inferior {
+
+        pid_t pid = 0;
+        pid_t tid = 0;
+        std::string prog_name;
+
+        std::uint64_t load_address = 0;
+        dwarf::dwarf dwarf;                 // built on the first query, use Debugger::debug_dwarf()
+        bool dwarf_loaded = false;
+        DebugFile debug_file;
+        elf::elf elf;
+        FunctionIndex function_index;
+        CfiUnwinder unwinder;
+        TypeCache types;
+        LocationCache locations;
+        ModuleTable modules;
+        std::vector<std::string> pending_breakpoints;     // function or file:line, set when a library providing it loads
+        AddressSpace address_space;
+        MemorySnapshot snapshot;
+
+        std::unordered_map<std::intptr_t, Breakpoint> breakpoints;
+        DisplacedStepping displaced;
+
+        int pid_fd = -1;
+    };
+}
+
+#endif
@@ -0,0 +1,143 @@
+#ifndef MINIDBG_LOCATION_HPP
+#define MINIDBG_LOCATION_HPP
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+#include <sys/types.h>
+#include <sys/user.h>
+
+#include "dwarf/dwarf++.hh"
+#include "elf/elf++.hh"
+
+#include "unwinder.hpp"
+#include "section_loader.hpp"
+
+
+namespace MiniDbg {
+
+    // Where one piece of an object is, once its location has been evaluated
+    struct LocationPiece {
+
+        enum class Kind : std::uint8_t { memory, reg, value, implicit, optimized_out };
+
+        Kind kind = Kind::optimized_out;
+        std::uint64_t value = 0;            // address, DWARF register number or computed value
+        std::uint64_t size = 0;             // bytes from DW_OP_piece, 0 for the whole object
+        std::vector<std::uint8_t> data;     // DW_OP_implicit_value
+    };
+
+    // Machine state a location is evaluated against
+    class LocationContext {
+
+    public:
+
+        virtual ~LocationContext() = default;
+
+        virtual bool reg( unsigned regnum, std::uint64_t& value ) = 0;
+        virtual bool read( std::uint64_t address, void* buffer, std::size_t size ) = 0;
+        virtual bool frame_base( std::uint64_t& value ) = 0;
+        virtual bool cfa( std::uint64_t& value ) = 0;
+        virtual std::uint64_t load_address() = 0;
+    };
+
+    // A DWARF location description decoded once. The shapes compilers emit for nearly
+    // every variable are evaluated directly, anything else runs the decoded operations
+    // on a stack machine without looking at the DWARF bytes again.
+    class CompiledLocation {
+
+    public:
+
+        bool compile( const std::uint8_t* begin, const std::uint8_t* end );
+        bool evaluate( LocationContext& context, std::vector<LocationPiece>& pieces ) const;
+
+    private:
+
+        struct Op {
+
+            std::uint8_t code;
+            std::uint64_t operand = 0;
+            std::uint64_t operand2 = 0;     // bregx offset, branch target as an op index, implicit data offset
+        };
+
+        enum class Shape : std::uint8_t { empty, reg, breg, fbreg, addr, implicit, stack_machine };
+
+        struct Piece {
+
+            Shape shape = Shape::empty;
+            unsigned reg = 0;
+            std::int64_t offset = 0;                // breg and fbreg offset, address of addr
+            std::vector<Op> ops;                    // stack_machine
+            bool stack_value = false;               // ops compute the value, not its address
+            std::vector<std::uint8_t> implicit;
+            std::uint64_t size = 0;
+        };
+
+        bool run( const Piece& piece, LocationContext& context, std::uint64_t& result ) const;
+
+        std::vector<Piece> m_pieces;
+    };
+
+    // Compiled DW_AT_location and DW_AT_frame_base descriptions by DIE offset. A plain
+    // exprloc covers every pc, a .debug_loc list gives one compiled entry per range.
+    class LocationCache {
+
+    public:
+
+        void build( const std::shared_ptr<SectionLoader>& sections );
+        void clear();
+
+        // nullptr when the attribute is missing or the object is not live at pc (unrelocated)
+        const CompiledLocation* find( const dwarf::die& die, dwarf::DW_AT attribute, std::uint64_t pc );
+
+    private:
+
+        struct Range {
+
+            std::uint64_t low;
+            std::uint64_t high;
+            CompiledLocation location;
+        };
+
+        std::vector<Range> compile( const dwarf::die& die, dwarf::DW_AT attribute );
+
+        std::shared_ptr<SectionLoader> m_sections;     // keeps .debug_loc mapped, or expanded
+        const std::uint8_t* m_debug_loc = nullptr;
+        std::size_t m_debug_loc_size = 0;
+
+        std::unordered_map<dwarf::section_offset, std::vector<Range>> m_ranges;     // sorted by low
+    };
+
+    // Evaluates against the registers of a stopped thread, DW_OP_fbreg through the
+    // DW_AT_frame_base of function and DW_OP_call_frame_cfa through the CFI
+    class FrameLocationContext : public LocationContext {
+
+    public:
+
+        FrameLocationContext( pid_t pid, const user_regs_struct& regs, std::uint64_t load_address,
+                              CfiUnwinder& unwinder, LocationCache& locations, const dwarf::die& function );
+
+        bool reg( unsigned regnum, std::uint64_t& value ) override;
+        bool read( std::uint64_t address, void* buffer, std::size_t size ) override;
+        bool frame_base( std::uint64_t& value ) override;
+        bool cfa( std::uint64_t& value ) override;
+        std::uint64_t load_address() override { return m_load_address; }
+
+    private:
+
+        pid_t m_pid;
+        std::array<std::uint64_t, n_unwind_registers> m_regs;
+        std::uint64_t m_pc;     // unrelocated
+        std::uint64_t m_load_address;
+        CfiUnwinder& m_unwinder;
+        LocationCache& m_locations;
+        dwarf::die m_function;
+        std::uint64_t m_frame_base = 0;
+        bool m_frame_base_ready = false;
+        bool m_in_frame_base = false;
+    };
+}
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef MINIDBG_MEMORY_HPP
+#define MINIDBG_MEMORY_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <sys/types.h>
+
+
+namespace MiniDbg {
+
+    // Bulk copy of inferior memory through process_vm_readv. The remote side is split
+    // into page sized pieces, so a read running into an unmapped page stops there and
+    // returns the number of bytes copied so far instead of failing as a whole.
+    std::size_t read_process_memory( pid_t pid, std::uint64_t address, void* buffer, std::size_t size ) ;
+
+    struct MemoryRange {
+
+        std::uint64_t address;
+        void* buffer;
+        std::size_t size;
+        bool ok = false;        // set once the whole range was copied
+    };
+
+    // Reads many ranges at once. Close ranges are merged into spans and the spans go
+    // out as the iovecs of as few process_vm_readv calls as possible. A span that stops
+    // short is retried page by page, so one bad range does not fail its neighbours.
+    // Returns the number of ranges copied in full.
+    std::size_t read_process_memory_ranges( pid_t pid, MemoryRange* ranges, std::size_t count ) ;
+
+    std::size_t write_process_memory( pid_t pid, std::uint64_t address, const void* buffer, std::size_t size ) ;
+}
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef MINIDBG_MEMORY_SEARCH_HPP
+#define MINIDBG_MEMORY_SEARCH_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+
+namespace MiniDbg {
+
+    // [start, end) of inferior memory to search
+    struct SearchRange {
+
+        std::uint64_t start;
+        std::uint64_t end;
+    };
+
+    struct SearchStats {
+
+        std::uint64_t bytes = 0;        // actually read
+        std::size_t matches = 0;
+        double seconds = 0;
+    };
+
+    // Offsets of pattern in data, vectorized with AVX2 or SSE2 where the CPU has them:
+    // candidates are positions where the first and the last byte of the pattern both
+    // match, only those are compared in full.
+    void scan_memory( const std::uint8_t* data, std::size_t size, const std::uint8_t* pattern, std::size_t length,
+                      const std::function<bool( std::size_t offset )>& found );
+
+    // Name of the scan kernel picked for this CPU
+    const char* scan_kernel_name();
+
+    // Searches the ranges with process_vm_readv in large chunks, reading the next chunk
+    // on a second thread while the current one is scanned. found gets the address of
+    // every match, in order, and returns false to stop the search.
+    SearchStats search_memory( pid_t pid, const std::vector<SearchRange>& ranges, const std::vector<std::uint8_t>& pattern,
+                               const std::function<bool( std::uint64_t address )>& found );
+}
+
+#endif
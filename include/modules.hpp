@@ -0,0 +1,91 @@
+#ifndef MINIDBG_MODULES_HPP
+#define MINIDBG_MODULES_HPP
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+#include "dwarf/dwarf++.hh"
+#include "elf/elf++.hh"
+
+#include "function_index.hpp"
+#include "debug_info.hpp"
+#include "unwinder.hpp"
+
+
+namespace MiniDbg {
+
+    // A shared object from the dynamic loader's link_map list. Its ELF is opened when
+    // it appears, the DWARF, function index and CFI are only built on first use.
+    struct Module {
+
+        Module() = default;
+        Module( const Module& ) = delete;
+        Module& operator=( const Module& ) = delete;
+        ~Module();
+
+        void load();
+
+        std::string path;
+        std::uint64_t link_map = 0;         // its entry in the loader's list
+        std::uint64_t load_address = 0;     // l_addr, added to every address in the file
+        std::uint64_t low = 0;              // relocated extent of the PT_LOAD segments, [low, high)
+        std::uint64_t high = 0;
+
+        elf::elf elf;
+        dwarf::dwarf dwarf;                 // invalid when neither the file nor a separate debug file has any
+        DebugFile debug_file;
+        FunctionIndex function_index;
+        CfiUnwinder unwinder;
+        bool loaded = false;
+    };
+
+    struct ModuleChanges {
+
+        std::vector<std::shared_ptr<Module>> added;
+        std::vector<std::shared_ptr<Module>> removed;
+    };
+
+    // Modules of one process kept in step with the dynamic loader through the r_debug
+    // protocol: the loader calls the r_brk hook before and after it edits the link_map
+    // list, which can be read again once r_state is back to RT_CONSISTENT. Copies share
+    // the modules, a fork child has the same files mapped at the same addresses.
+    class ModuleTable {
+
+    public:
+
+        // Finds _r_debug and the hook in the dynamic loader, the file mapped at interp_base
+        bool start( pid_t pid, std::uint64_t interp_base, const std::string& path );
+        void clear();
+
+        std::uint64_t hook() const { return m_hook; }
+
+        ModuleChanges update( pid_t pid );
+
+        // The module mapping a relocated address, loaded on the way; nullptr outside every module
+        Module* find( std::uint64_t address );
+
+        const std::vector<std::shared_ptr<Module>>& modules() const { return m_modules; }
+
+    private:
+
+        std::uint64_t m_r_debug = 0;
+        std::uint64_t m_hook = 0;
+        std::vector<std::shared_ptr<Module>> m_modules;     // sorted by low
+    };
+
+    // AT_* entry of the auxiliary vector of a process, 0 when it is missing
+    std::uint64_t read_auxv_entry( pid_t pid, std::uint64_t type );
+
+    // Unrelocated addresses to break on in one object: past the prologue of the functions
+    // called name, and the first statement of a source line
+    std::vector<std::uint64_t> function_breakpoint_addresses( const elf::elf& elf, const dwarf::dwarf& dwarf, const std::string& name );
+    std::vector<std::uint64_t> line_breakpoint_addresses( const dwarf::dwarf& dwarf, const std::string& file, unsigned line );
+
+    // Cheap check on the symbol table before building the debug data of a module
+    bool has_function_symbol( const elf::elf& elf, const std::string& name );
+}
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef MINIDBG_MONITOR_HPP
+#define MINIDBG_MONITOR_HPP
+
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+
+namespace MiniDbg {
+
+    // An object resolved once to an address and size, sampled from then on
+    struct MonitoredValue {
+
+        std::string expression;
+        std::uint64_t address;
+        std::size_t size;
+    };
+
+    // Samples values of a running process with process_vm_readv on a fixed period, with
+    // no ptrace stop and no attach. Every tick reads all values in one call and prints
+    // the ones that changed, as text or as CSV rows.
+    class Monitor {
+
+    public:
+
+        using Formatter = std::function<std::string( std::size_t index, const std::uint8_t* data )>;
+
+        Monitor( pid_t pid, std::vector<MonitoredValue> values, Formatter format ) ;
+
+        // Until seconds have passed (0: no limit), the process is gone or stop_fd turns readable
+        bool Run( double period_ms, unsigned seconds, int stop_fd, std::ostream& out, bool csv );
+
+        void print_summary( std::ostream& os ) const;
+
+    private:
+
+        void emit( std::ostream& out, bool csv, double at_ms, const std::vector<bool>& changed );
+
+        pid_t m_pid;
+        std::vector<MonitoredValue> m_values;
+        Formatter m_format;
+
+        std::vector<std::vector<std::uint8_t>> m_current;
+        std::vector<std::vector<std::uint8_t>> m_last;
+
+        std::size_t m_samples = 0;
+        std::size_t m_changes = 0;
+        std::size_t m_late = 0;             // ticks that started after the next one was due
+        double m_read_us = 0;               // total time spent in the reads
+        double m_elapsed_ms = 0;
+    };
+}
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef MINIDBG_PERF_COUNTERS_HPP
+#define MINIDBG_PERF_COUNTERS_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <ostream>
+#include <sys/types.h>
+
+
+namespace MiniDbg {
+
+    // perf_event_open counters attached to the debuggee. They are created disabled and
+    // only enabled around resumes, so ptrace work done by the debugger is not counted.
+    // An inherited counter only follows the threads its task creates later, so every
+    // thread alive at open gets its own and a counter is the sum of them.
+    class PerfCounters {
+
+    public:
+
+        ~PerfCounters() { Close(); }
+
+        bool Open( pid_t pid );
+        void Close();
+        bool is_open() const { return !m_counters.empty(); }
+
+        void Enable();
+        void Disable();
+
+        void print_deltas( std::ostream& os );
+
+    private:
+
+        struct Counter {
+
+            std::string name;
+            std::vector<int> fds;       // one per thread alive at open
+            std::uint64_t last_value;
+        };
+
+        std::uint64_t read_scaled( const Counter& counter ) const;
+
+        std::vector<Counter> m_counters;
+        bool m_enabled = false;
+    };
+}
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef MINIDBG_PROFILER_HPP
+#define MINIDBG_PROFILER_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <ostream>
+#include <sys/types.h>
+#include <sys/user.h>
+
+#include "function_index.hpp"
+#include "unwinder.hpp"
+#include "modules.hpp"
+
+
+namespace MiniDbg {
+
+    // Statistical profiler: seizes every thread of a process, interrupts it at a fixed
+    // rate, copies registers and the top of the stack and resumes it right away.
+    // Unwinding (CFI of the executable and its libraries) and symbolization work on the
+    // copies while the target keeps running.
+    class Profiler {
+
+    public:
+
+        Profiler( pid_t pid, FunctionIndex& index, CfiUnwinder& unwinder, ModuleTable& modules, std::uint64_t load_address ) ;
+
+        bool Run( unsigned hz, unsigned seconds );
+
+        void print_report( std::ostream& os, std::size_t top_n ) const;
+        bool write_folded_stacks( const std::string& path ) const;
+
+        static const std::size_t stack_copy_size = 32 * 1024;
+        static const std::size_t max_frames = 128;
+
+    private:
+
+        struct StackCopy {
+
+            user_regs_struct regs;
+            std::vector<std::uint8_t> stack;
+        };
+
+        void refresh_threads();
+        void take_sample();
+        bool wait_for_interrupt_stop( pid_t tid, bool& group_stop );
+        void release_threads();
+
+        std::vector<std::uint64_t> unwind( StackCopy& copy ) const;
+        std::string symbolize( std::uint64_t pc ) const;
+
+        pid_t m_pid;
+        FunctionIndex& m_index;
+        CfiUnwinder& m_unwinder;            // rows are cached as they are found
+        ModuleTable& m_modules;             // libraries are loaded on first use
+        std::uint64_t m_load_address;
+
+        std::map<pid_t, bool> m_threads;    // tid -> seized
+
+        std::vector<std::vector<std::uint64_t>> m_stacks;   // leaf first
+        std::vector<double> m_thread_pause_us;               // per thread per sample
+        std::vector<double> m_sample_pause_us;               // first interrupt .. last resume
+        std::chrono::steady_clock::duration m_elapsed {};
+
+        mutable std::map<std::uint64_t, std::string> m_symbol_cache;
+    };
+}
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef MINIDBG_PSTACK_HPP
+#define MINIDBG_PSTACK_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <ostream>
+#include <sys/types.h>
+#include <sys/user.h>
+
+#include "dwarf/dwarf++.hh"
+#include "elf/elf++.hh"
+
+#include "function_index.hpp"
+#include "unwinder.hpp"
+#include "modules.hpp"
+#include "address_space.hpp"
+#include "debug_info.hpp"
+
+
+namespace MiniDbg {
+
+    // One-shot stack dump of a live process. Symbols, DWARF and CFI of the executable and
+    // of every loaded library are prepared while the process runs; the threads are then
+    // stopped only for as long as copying their registers and stacks takes, and the
+    // unwinding and symbolization work on the copies after the detach.
+    class StackDump {
+
+    public:
+
+        explicit StackDump( pid_t pid ) : m_pid( pid ) {}
+        ~StackDump();
+
+        bool prepare();
+        bool capture();
+        void print( std::ostream& os );
+
+        static const std::size_t stack_copy_size = 256 * 1024;
+        static const std::size_t max_frames = 256;
+
+    private:
+
+        struct ThreadCopy {
+
+            pid_t tid;
+            std::string name;
+            user_regs_struct regs;
+            std::vector<std::uint8_t> stack;    // from rsp up
+        };
+
+        bool wait_for_interrupt( pid_t tid );
+
+        pid_t m_pid;
+        std::string m_path;
+        elf::elf m_elf;
+        dwarf::dwarf m_dwarf;
+        DebugFile m_debug_file;
+        FunctionIndex m_index;
+        CfiUnwinder m_unwinder;
+        std::uint64_t m_load_address = 0;
+        ModuleTable m_modules;
+        AddressSpace m_address_space;       // read once, before the stop
+
+        std::vector<ThreadCopy> m_threads;
+        double m_prepare_ms = 0;
+        double m_pause_us = 0;      // first interrupt .. last detach
+    };
+}
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef MINIDBG_SECTION_LOADER_HPP
+#define MINIDBG_SECTION_LOADER_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "dwarf/dwarf++.hh"
+#include "elf/elf++.hh"
+
+
+namespace MiniDbg {
+
+    // DWARF section loader that expands SHF_COMPRESSED (zlib, zstd) and .zdebug_*
+    // sections. A section is decompressed when it is first asked for and kept for the
+    // life of the loader, which the dwarf object holds on to. The first request of a
+    // compressed section also starts the other large sections every DWARF session
+    // reads (.debug_info, _abbrev, _str, _line) on worker threads, so their expansion
+    // overlaps instead of running one after another.
+    class SectionLoader : public dwarf::loader {
+
+    public:
+
+        explicit SectionLoader( const elf::elf& elf );
+
+        const void* load( dwarf::section_type type, std::size_t* size_out ) override;
+
+        // any debug section by its uncompressed name, nullptr when missing or corrupt
+        const void* load( const std::string& name, std::size_t& size );
+
+    private:
+
+        struct Section {
+
+            std::string name;                   // .debug_*, also for a .zdebug_* section
+            dwarf::section_type type;
+            bool has_type = false;
+            bool compressed = false;
+            std::uint32_t format = 0;           // ELFCOMPRESS_*, or zdebug_format
+            const std::uint8_t* data = nullptr;
+            std::size_t size = 0;
+            std::shared_future<std::vector<std::uint8_t>> contents;
+            bool started = false;
+        };
+
+        const void* load( Section& section, std::size_t& size );
+        void start( Section& section, std::launch policy );
+
+        elf::elf m_elf;     // keeps the raw sections mapped
+        std::vector<Section> m_sections;
+        std::mutex m_mutex;
+        bool m_prefetched = false;
+    };
+
+    std::shared_ptr<SectionLoader> create_section_loader( const elf::elf& elf );
+
+    // Expands one compressed section, empty on a corrupt or unsupported one
+    std::vector<std::uint8_t> decompress_section( std::uint32_t format, const std::uint8_t* data, std::size_t size );
+}
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef MINIDBG_SIGNALS_HPP
+#define MINIDBG_SIGNALS_HPP
+
+#include <array>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <signal.h>
+
+
+namespace MiniDbg {
+
+    // What to do when the debuggee receives a signal: stop in the debugger, print a
+    // line about it, and pass it on to the program when it resumes.
+    struct SignalAction {
+
+        bool stop = true;
+        bool print = true;
+        bool pass = true;
+    };
+
+    // The `handle` table consulted at every signal stop. Timer, child and I/O signals
+    // start as nostop noprint pass, so a busy program is not turned into round trips
+    // through the prompt; SIGINT is the debugger's own and is not passed.
+    class SignalTable {
+
+    public:
+
+        SignalTable();
+
+        const SignalAction& get( int signal ) const;
+
+        // handle <sig>|all [stop|nostop] [print|noprint] [pass|nopass]...
+        bool set( const std::vector<std::string>& args );
+
+        // one signal, or every signal when 0
+        void print( std::ostream& out, int signal = 0 ) const;
+
+    private:
+
+        std::array<SignalAction, NSIG> m_actions;
+    };
+
+    // SIGALRM, ALRM or 14; 0 when unknown
+    int signal_number( const std::string& name );
+    std::string signal_name( int signal );
+
+    // Raised by the instruction at the pc (SIGSEGV, SIGBUS, SIGILL, SIGFPE from the kernel):
+    // resumed without it, the instruction runs again and raises it again
+    bool is_fault_signal( const siginfo_t& info );
+}
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef MINIDBG_SNAPSHOT_HPP
+#define MINIDBG_SNAPSHOT_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+#include "elf/elf++.hh"
+
+#include "address_space.hpp"
+
+
+namespace MiniDbg {
+
+    // Bytes that differ from the snapshot, runs closer than a word apart are merged
+    struct MemoryChange {
+
+        std::uint64_t address;
+        std::vector<std::uint8_t> before;
+        std::vector<std::uint8_t> after;
+    };
+
+    struct SnapshotDiff {
+
+        std::vector<MemoryChange> changes;
+        std::size_t pages = 0;          // in the snapshot
+        std::size_t dirty_pages = 0;    // read again and compared
+    };
+
+    // Copy of the writable memory of a process, compared later against what it holds
+    // then. mark clears the soft-dirty bits through /proc/<pid>/clear_refs, so diff
+    // only reads and compares the pages pagemap says were written since. A kernel built
+    // without CONFIG_MEM_SOFT_DIRTY never sets the bit, every page is compared there.
+    class MemorySnapshot {
+
+    public:
+
+        bool mark( pid_t pid, const std::vector<MemoryRegion>& regions, std::string& error );
+        bool diff( pid_t pid, SnapshotDiff& result, std::string& error ) const;
+        void clear();
+
+        bool valid() const { return m_pid != 0; }
+        bool soft_dirty() const { return m_soft_dirty; }
+        std::size_t bytes() const;
+
+    private:
+
+        struct Saved {
+
+            std::uint64_t start;
+            std::uint64_t end;
+            std::vector<std::uint8_t> data;     // as far as it could be read
+        };
+
+        pid_t m_pid = 0;
+        bool m_soft_dirty = false;
+        std::vector<Saved> m_regions;
+    };
+
+    // STT_OBJECT symbol relocated into the process
+    struct DataSymbol {
+
+        std::uint64_t address;
+        std::uint64_t size;
+        std::string name;
+    };
+
+    void add_data_symbols( const elf::elf& elf, std::uint64_t load_address, std::vector<DataSymbol>& symbols );
+
+    // The object covering address in symbols sorted by address, nullptr when none does
+    const DataSymbol* find_data_symbol( const std::vector<DataSymbol>& symbols, std::uint64_t address );
+}
+
+#endif
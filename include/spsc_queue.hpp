@@ -0,0 +1,55 @@
+#ifndef MINIDBG_SPSC_QUEUE_HPP
+#define MINIDBG_SPSC_QUEUE_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+
+namespace MiniDbg {
+
+    // Bounded lock-free single producer / single consumer ring buffer.
+    // One slot is kept free to tell a full queue from an empty one.
+    template <typename T, std::size_t Capacity>
+    class SpscQueue {
+
+    public:
+
+        bool push( T value ) {
+
+            std::size_t tail = m_tail.load( std::memory_order_relaxed );
+            std::size_t next = ( tail + 1 ) % Capacity;
+
+            if ( next == m_head.load( std::memory_order_acquire ) ) {
+                return false;
+            }
+
+            m_items[ tail ] = std::move( value );
+            m_tail.store( next, std::memory_order_release );
+            return true;
+        }
+
+        bool pop( T& out ) {
+
+            std::size_t head = m_head.load( std::memory_order_relaxed );
+
+            if ( head == m_tail.load( std::memory_order_acquire ) ) {
+                return false;
+            }
+
+            out = std::move( m_items[ head ] );
+            m_head.store( ( head + 1 ) % Capacity, std::memory_order_release );
+            return true;
+        }
+
+    private:
+
+        std::array<T, Capacity> m_items;
+
+        alignas( 64 ) std::atomic<std::size_t> m_head { 0 };
+        alignas( 64 ) std::atomic<std::size_t> m_tail { 0 };
+    };
+}
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef MINIDBG_SYSCALLS_HPP
+#define MINIDBG_SYSCALLS_HPP
+
+#include <cstdint>
+#include <set>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+#include <linux/filter.h>
+
+
+namespace MiniDbg {
+
+    // x86-64 syscall number of a name, or of a decimal number; -1 when unknown
+    long syscall_number( const std::string& name );
+    std::string syscall_name( long number );
+
+    // One test on a syscall argument: arg<N> <op> <value>. A quoted value compares the
+    // NUL terminated string the argument points to, only with == and !=.
+    struct SyscallCondition {
+
+        int arg = 0;
+        std::string op;
+        std::uint64_t value = 0;
+        std::string text;
+        bool is_string = false;
+    };
+
+    struct SyscallCatchpoint {
+
+        int number;
+        std::set<long> syscalls;
+        std::vector<SyscallCondition> conditions;   // all of them must hold
+        std::string condition;                      // as typed
+        std::size_t hits = 0;
+    };
+
+    // "arg1 == \"/etc/passwd\" && arg2 > 0x1000", already split on spaces
+    bool parse_syscall_conditions( const std::vector<std::string>& tokens, std::vector<SyscallCondition>& conditions );
+    bool syscall_condition_holds( pid_t pid, const SyscallCondition& condition, const std::uint64_t args[6] );
+
+    // seccomp program returning SECCOMP_RET_TRACE for the given syscalls and ALLOW for the
+    // rest, other architectures and x32 calls included
+    std::vector<sock_filter> build_seccomp_filter( const std::set<long>& syscalls );
+
+    // Sets no_new_privs and the filter on the calling process, for the child before exec
+    bool install_seccomp_filter( const std::vector<sock_filter>& filter );
+
+    // Whether /proc/<pid>/status reports a seccomp filter
+    bool has_seccomp_filter( pid_t pid );
+}
+
+#endif
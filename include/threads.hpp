@@ -0,0 +1,49 @@
+#ifndef MINIDBG_THREADS_HPP
+#define MINIDBG_THREADS_HPP
+
+#include <string>
+#include <sys/types.h>
+#include <sys/user.h>
+#include <sys/ptrace.h>
+
+
+namespace MiniDbg {
+
+    enum class ThreadStatus {
+        running,
+        stopped
+    };
+
+    enum class StopReason {
+        none,
+        starting,       // auto-attached clone waiting for its first resume
+        breakpoint,
+        single_step,
+        signal,
+        interrupted,
+        syscall         // a syscall catchpoint
+    };
+
+    std::string to_string( StopReason reason ) ;
+
+    struct ThreadState {
+
+        pid_t tid;
+        pid_t pid;                              // thread group, i.e. the inferior it belongs to
+        int number;                             // user visible id for info threads / thread N
+
+        ThreadStatus status = ThreadStatus::stopped;
+        StopReason reason = StopReason::none;
+        int pending_signal = 0;                 // delivered on the next resume
+        int catchpoint = 0;                     // the syscall catchpoint it stopped at
+        bool group_stop = false;                // in a job control stop, resumed with PTRACE_LISTEN to stay in it
+        bool interrupt_pending = false;         // stopped at a catchpoint before a PTRACE_INTERRUPT landed, its trap follows the resume
+
+        __ptrace_request last_request = PTRACE_CONT;  // stepping state: how it was last resumed
+
+        user_regs_struct regs;                  // cached while stopped
+        bool regs_valid = false;
+    };
+}
+
+#endif
@@ -0,0 +1,125 @@
+#ifndef MINIDBG_TYPES_HPP
+#define MINIDBG_TYPES_HPP
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "dwarf/dwarf++.hh"
+
+
+namespace MiniDbg {
+
+    enum class TypeKind {
+        base,
+        pointer,
+        array,
+        structure,      // struct, class and union
+        enumeration,
+        unknown
+    };
+
+    // Compact layout of a DWARF type with typedefs and cv-qualifiers stripped
+    struct TypeLayout {
+
+        struct Field {
+
+            std::string name;
+            std::uint64_t offset;
+            const TypeLayout* type;
+            std::uint32_t bit_size = 0;     // 0 unless a bit-field
+            std::uint32_t bit_offset = 0;   // from the start of the field, little endian
+        };
+
+        // libstdc++ container recognised from its members: where the bookkeeping words
+        // sit inside the object and what one element looks like
+        struct Container {
+
+            enum class Kind : std::uint8_t { none, vector, string, tree, hashtable, list, smart_pointer };
+
+            Kind kind = Kind::none;
+            bool associative = false;           // map-like, elements are std::pair<const K, V>
+            std::uint64_t start = 0;            // first element pointer, or the list/tree/hashtable header
+            std::uint64_t finish = 0;           // vector end pointer
+            std::uint64_t count = 0;            // length or element count, if kept
+            std::uint64_t node_value = 0;       // offset of the element inside a node
+            const TypeLayout* element = nullptr;
+        };
+
+        TypeKind kind = TypeKind::unknown;
+        std::string name;
+        std::uint64_t size = 0;
+        std::uint8_t encoding = 0;          // DW_ATE_* of a base type
+        const TypeLayout* target = nullptr; // pointee or element
+        std::uint64_t count = 0;            // array elements, 0 if not known
+        std::vector<Field> fields;
+        std::vector<std::pair<std::int64_t, std::string>> enumerators;
+        Container container;
+
+        const Field* find_field( const std::string& field_name ) const;
+    };
+
+    // An object found while evaluating an expression. In memory at address, or held
+    // in contents when it lives in registers, is computed or is made of pieces; address
+    // is then the offset into contents. A bit-field keeps its field, address is then
+    // the first byte of its storage.
+    struct ValueRef {
+
+        const TypeLayout* type = nullptr;
+        std::uint64_t address = 0;
+        bool in_memory = true;
+        std::vector<std::uint8_t> contents;
+        const TypeLayout::Field* bitfield = nullptr;
+
+        // bytes to fetch: the object, or the storage bytes of a bit-field
+        std::size_t size() const {
+
+            return bitfield ? ( bitfield->bit_offset + bitfield->bit_size + 7 ) / 8 : type->size;
+        }
+    };
+
+    // Reads inferior memory for the formatter, returns the number of bytes copied
+    using MemoryReader = std::function<std::size_t( std::uint64_t address, void* buffer, std::size_t size )>;
+
+    // Type DIEs resolved to layouts once and kept by DIE offset, so formatting a
+    // value only walks the layout, never the DWARF tree. Typedefs and qualifiers map
+    // to the layout of the type they name. Copies share the layouts.
+    class TypeCache {
+
+    public:
+
+        const TypeLayout* resolve( const dwarf::die& type_die );
+        const TypeLayout* void_type();
+        void clear();
+
+        // elements printed per array or container, 0 for all
+        void set_element_limit( std::size_t limit ) { m_element_limit = limit; }
+
+        // data holds the whole object; pointers to char are followed through read
+        std::string format( const TypeLayout& type, const std::uint8_t* data, const MemoryReader& read ) const;
+        std::string format( const TypeLayout::Field& field, const std::uint8_t* data, const MemoryReader& read ) const;
+
+    private:
+
+        TypeLayout* make_layout();
+        void resolve_array( TypeLayout& layout, const dwarf::die& die );
+        void resolve_structure( TypeLayout& layout, const dwarf::die& die );
+        void detect_container( TypeLayout& layout, const dwarf::die& die );
+        const TypeLayout* template_type( const dwarf::die& die, const std::string& parameter );
+        void format_value( std::string& out, const TypeLayout& type, const std::uint8_t* data, const MemoryReader& read, int depth ) const;
+        void format_field( std::string& out, const TypeLayout::Field& field, const std::uint8_t* data, const MemoryReader& read, int depth ) const;
+        void format_container( std::string& out, const TypeLayout& type, const std::uint8_t* data, const MemoryReader& read, int depth ) const;
+        void format_element( std::string& out, const TypeLayout& container, const std::uint8_t* data, const MemoryReader& read, int depth ) const;
+
+        std::unordered_map<dwarf::section_offset, const TypeLayout*> m_layouts;
+        std::vector<std::shared_ptr<TypeLayout>> m_storage;
+        const TypeLayout* m_void = nullptr;
+        std::size_t m_element_limit = 200;
+    };
+}
+
+#endif
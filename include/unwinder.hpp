@@ -0,0 +1,149 @@
+#ifndef MINIDBG_UNWINDER_HPP
+#define MINIDBG_UNWINDER_HPP
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include <unordered_map>
+#include <utility>
+#include <sys/types.h>
+#include <sys/user.h>
+
+#include "elf/elf++.hh"
+
+
+namespace MiniDbg {
+
+    // DWARF numbering on x86-64: rax, rdx, rcx, rbx, rsi, rdi, rbp, rsp, r8-r15, return address
+    constexpr int n_unwind_registers = 17;
+    constexpr int return_address_column = 16;
+
+    struct RegisterRule {
+
+        enum class Kind : std::uint8_t { same_value, undefined, offset, val_offset, reg, expression };
+
+        Kind kind = Kind::same_value;
+        std::int64_t value = 0;         // offset from the CFA, or the register holding the value
+    };
+
+    // Result of running the CFA program of a function up to a pc
+    struct UnwindRow {
+
+        bool valid = false;
+        int cfa_register = 7;
+        std::int64_t cfa_offset = 0;
+        bool cfa_expression = false;    // not evaluated, unwinding stops there
+        std::array<RegisterRule, n_unwind_registers> rules;
+    };
+
+    // user_regs_struct in DWARF register order, indexed by DWARF register number
+    std::array<std::uint64_t, n_unwind_registers> dwarf_registers( const user_regs_struct& regs );
+
+    struct UnwoundFrame {
+
+        std::uint64_t pc;
+        std::uint64_t cfa;
+    };
+
+    // Stack contents fetched with process_vm_readv in growing windows above the stack
+    // pointer, so walking the frames does not cost a PEEKDATA per saved slot. Built from
+    // a copy taken earlier it reads that copy only, the process may be long gone.
+    class StackReader {
+
+    public:
+
+        StackReader( pid_t pid, std::uint64_t sp ) : m_pid( pid ), m_base( sp ) {}
+        StackReader( std::uint64_t sp, std::vector<std::uint8_t> copy ) : m_pid( 0 ), m_base( sp ), m_data( std::move( copy ) ) {}
+
+        bool read( std::uint64_t address, std::uint64_t& value );
+
+    private:
+
+        pid_t m_pid;
+        std::uint64_t m_base;
+        std::vector<std::uint8_t> m_data;
+    };
+
+    class CfiUnwinder;
+
+    // Unwinder and load address of the object holding a relocated pc, nullptr for the main one
+    using UnwinderResolver = std::function<CfiUnwinder*( std::uint64_t pc, std::uint64_t& load_address )>;
+
+    // Unwinder driven by .eh_frame and .debug_frame. FDEs are found through the binary
+    // search table of .eh_frame_hdr when there is one, otherwise through a sorted index
+    // built on load. Rows are cached per pc, so repeated backtraces only parse new code.
+    class CfiUnwinder {
+
+    public:
+
+        void build( const elf::elf& elf );
+        void clear();
+
+        const UnwindRow& find_row( std::uint64_t pc );      // unrelocated pc
+
+        // frames outside this object are unwound with the CFI of the object resolve hands back
+        std::vector<UnwoundFrame> unwind( pid_t pid, const user_regs_struct& regs, std::uint64_t load_address, std::size_t max_frames,
+                                          const UnwinderResolver& resolve = nullptr );
+        std::vector<UnwoundFrame> unwind( StackReader& stack, const user_regs_struct& regs, std::uint64_t load_address, std::size_t max_frames,
+                                          const UnwinderResolver& resolve = nullptr );
+
+    private:
+
+        struct Section {
+
+            const std::uint8_t* data = nullptr;
+            std::size_t size = 0;
+            std::uint64_t addr = 0;
+            bool is_eh = true;
+        };
+
+        struct Cie {
+
+            std::uint64_t code_align = 1;
+            std::int64_t data_align = 1;
+            int ra_column = return_address_column;
+            std::uint8_t fde_encoding = 0;
+            bool has_augmentation_data = false;
+            const std::uint8_t* instructions = nullptr;
+            const std::uint8_t* end = nullptr;
+        };
+
+        struct Fde {
+
+            std::uint64_t low = 0;
+            std::uint64_t high = 0;
+            const Cie* cie = nullptr;
+            const std::uint8_t* instructions = nullptr;
+            const std::uint8_t* end = nullptr;
+            bool is_eh = true;
+        };
+
+        struct FdeEntry {
+
+            std::uint64_t low;
+            bool is_eh;
+            std::size_t offset;
+        };
+
+        bool parse_fde( const Section& section, std::size_t offset, Fde& fde );
+        const Cie* get_cie( const Section& section, const std::uint8_t* entry );
+        bool find_fde( std::uint64_t pc, Fde& fde );
+        bool execute( const Section& section, const Fde& fde, const std::uint8_t* begin, const std::uint8_t* end,
+                      std::uint64_t pc, UnwindRow& row, const UnwindRow& initial );
+        void index_section( const Section& section );
+
+        elf::elf m_elf;     // keeps the section data below mapped
+        Section m_eh_frame;
+        Section m_debug_frame;
+        std::uint64_t m_hdr_addr = 0;
+        const std::uint8_t* m_hdr_table = nullptr;
+        std::size_t m_hdr_count = 0;
+
+        std::vector<FdeEntry> m_fdes;
+        std::unordered_map<const std::uint8_t*, Cie> m_cies;
+        std::unordered_map<std::uint64_t, UnwindRow> m_rows;
+    };
+}
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef MINIDBG_X86_DECODER_HPP
+#define MINIDBG_X86_DECODER_HPP
+
+#include <cstdint>
+#include <cstddef>
+
+
+namespace MiniDbg {
+
+    // How an instruction moves rip, which decides the fixups after running it elsewhere
+    enum class ControlFlow {
+        none,
+        relative_jump,      // jmp/jcc/loop rel8, rel32
+        relative_call,      // call rel32
+        indirect_call,      // call r/m, return address needs fixing, rip does not
+        absolute_jump       // jmp r/m, ret, iret
+    };
+
+    struct Instruction {
+
+        std::size_t length = 0;
+        int rip_disp_offset = -1;       // offset of the disp32 of a rip-relative operand, -1 if none
+        ControlFlow flow = ControlFlow::none;
+    };
+
+    // Length decoder for 64-bit mode: legacy/REX prefixes, one/two/three byte maps,
+    // VEX and EVEX. Returns false for invalid or truncated encodings and for system
+    // instructions (syscall, int n, ...) that must not be executed out of line.
+    bool decode_instruction( const std::uint8_t* code, std::size_t size, Instruction& insn ) ;
+}
+
+#endif
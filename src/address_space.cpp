@@ -0,0 +1,150 @@
+#include "address_space.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+
+namespace MiniDbg {
+
+
+namespace {
+
+    // "start-end perms offset dev inode path", the path may hold spaces
+    bool parse_maps_line( const std::string& line, MemoryRegion& region ) {
+
+        unsigned long long start, end, offset;
+        char perms[5];
+        int path_at = 0;
+
+        if ( std::sscanf( line.c_str(), "%llx-%llx %4s %llx %*s %*s %n", &start, &end, perms, &offset, &path_at ) < 4 ) {
+            return false;
+        }
+
+        region.start = start;
+        region.end = end;
+        region.offset = offset;
+        region.permissions = ( perms[0] == 'r' ? MemoryRegion::read : 0 ) | ( perms[1] == 'w' ? MemoryRegion::write : 0 ) |
+                             ( perms[2] == 'x' ? MemoryRegion::execute : 0 ) | ( perms[3] == 's' ? MemoryRegion::shared : 0 );
+        region.path = path_at > 0 && static_cast<std::size_t>( path_at ) < line.size() ? line.substr( path_at ) : "";
+
+        return true;
+    }
+}
+
+
+void AddressSpace::clear() {
+
+    m_regions.clear();
+    m_valid = false;
+}
+
+
+void AddressSpace::refresh( pid_t pid, std::uint64_t generation ) {
+
+    if ( m_valid && m_pid == pid && m_generation == generation ) {
+        return;
+    }
+
+    m_regions.clear();
+
+    std::ifstream maps( "/proc/" + std::to_string( pid ) + "/maps" );
+    std::string line;
+    MemoryRegion region;
+
+    // the kernel lists them in address order already
+    while ( std::getline( maps, line ) ) {
+
+        if ( parse_maps_line( line, region ) ) {
+            m_regions.push_back( region );
+        }
+    }
+
+    m_pid = pid;
+    m_generation = generation;
+    m_valid = true;
+}
+
+
+const MemoryRegion* AddressSpace::find( pid_t pid, std::uint64_t generation, std::uint64_t address ) {
+
+    refresh( pid, generation );
+
+    auto it = std::upper_bound( m_regions.begin(), m_regions.end(), address,
+                                []( std::uint64_t value, const MemoryRegion& r ) { return value < r.start; } );
+
+    if ( it == m_regions.begin() || address >= ( --it )->end ) {
+        return nullptr;
+    }
+
+    return &*it;
+}
+
+
+bool AddressSpace::check( pid_t pid, std::uint64_t generation, std::uint64_t address, std::size_t size, std::uint8_t permissions ) {
+
+    std::uint64_t end = address + std::max<std::size_t>( size, 1 );
+
+    // a range may run over several adjacent regions, every one of them has to allow it
+    while ( address < end ) {
+
+        const MemoryRegion* region = find( pid, generation, address );
+
+        if ( region == nullptr || !region->allows( permissions ) ) {
+            return false;
+        }
+
+        address = region->end;
+    }
+
+    return true;
+}
+
+
+const std::vector<MemoryRegion>& AddressSpace::regions( pid_t pid, std::uint64_t generation ) {
+
+    refresh( pid, generation );
+    return m_regions;
+}
+
+
+std::vector<RegionUsage> AddressSpace::usage( pid_t pid ) {
+
+    std::vector<RegionUsage> result;
+    std::ifstream smaps( "/proc/" + std::to_string( pid ) + "/smaps" );
+    std::string line;
+    MemoryRegion region;
+
+    while ( std::getline( smaps, line ) ) {
+
+        // a region header, then "Key:   value kB" lines until the next one
+        if ( parse_maps_line( line, region ) && line.find( ':' ) > line.find( ' ' ) ) {
+
+            result.emplace_back();
+            continue;
+        }
+
+        if ( result.empty() ) {
+            continue;
+        }
+
+        unsigned long long value = 0;
+        char key[32];
+
+        if ( std::sscanf( line.c_str(), "%31[^:]: %llu", key, &value ) != 2 ) {
+            continue;
+        }
+
+        RegionUsage& current = result.back();
+
+        if ( std::strcmp( key, "Rss" ) == 0 ) current.rss = value;
+        else if ( std::strcmp( key, "Pss" ) == 0 ) current.pss = value;
+        else if ( std::strcmp( key, "Private_Dirty" ) == 0 ) current.private_dirty = value;
+        else if ( std::strcmp( key, "Swap" ) == 0 ) current.swap = value;
+    }
+
+    return result;
+}
+
+} // namespace MiniDbg
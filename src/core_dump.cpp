@@ -0,0 +1,370 @@
+#include "core_dump.hpp"
+#include "memory.hpp"
+
+#include <elf.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/procfs.h>
+#include <sys/ptrace.h>
+#include <sys/uio.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <iterator>
+
+
+namespace MiniDbg {
+
+
+namespace {
+
+    constexpr std::uint64_t page_size = 4096;
+    constexpr std::size_t chunk_size = 8 << 20;
+    constexpr std::size_t xstate_size = 16 * 1024;     // above the largest XSAVE area, AMX included
+
+
+    struct Segment {
+
+        const MemoryRegion* region;
+        std::uint64_t offset;       // in the file
+        std::uint64_t size;         // of the data in the file, at most the region
+    };
+
+
+    std::uint64_t align( std::uint64_t value, std::uint64_t to ) {
+
+        return ( value + to - 1 ) & ~( to - 1 );
+    }
+
+
+    std::string read_proc_file( pid_t pid, const char* name ) {
+
+        std::ifstream in( "/proc/" + std::to_string( pid ) + "/" + name, std::ios::binary );
+        return std::string( std::istreambuf_iterator<char>( in ), std::istreambuf_iterator<char>() );
+    }
+
+
+    void add_note( std::vector<std::uint8_t>& notes, const char* name, std::uint32_t type, const void* data, std::size_t size ) {
+
+        Elf64_Nhdr header;
+        header.n_namesz = std::strlen( name ) + 1;
+        header.n_descsz = size;
+        header.n_type = type;
+
+        auto append = [ &notes ]( const void* bytes, std::size_t length ) {
+
+            const std::uint8_t* p = static_cast<const std::uint8_t*>( bytes );
+            notes.insert( notes.end(), p, p + length );
+            notes.resize( align( notes.size(), 4 ) );
+        };
+
+        append( &header, sizeof( header ) );
+        append( name, header.n_namesz );
+        append( data, size );
+    }
+
+
+    // What the file keeps of a region, the rest reads as zero or comes from the mapped file
+    std::uint64_t dumped_size( const MemoryRegion& r ) {
+
+        bool special = r.path == "[vvar]" || r.path == "[vsyscall]" || r.path.starts_with( "/dev/" );
+
+        if ( special || !r.allows( MemoryRegion::read ) ) {
+            return 0;
+        }
+
+        bool file = r.path.starts_with( "/" );
+
+        if ( file && !r.allows( MemoryRegion::write ) && !r.allows( MemoryRegion::shared ) ) {
+
+            return r.offset == 0 ? page_size : 0;
+        }
+
+        return r.end - r.start;
+    }
+
+
+    // Everything that is not a zero page, a zero page is a hole the final size leaves behind
+    bool write_sparse( int fd, const std::uint8_t* data, std::size_t size, std::uint64_t offset, std::uint64_t& written ) {
+
+        static const std::uint8_t zero[ page_size ] = {};
+
+        for ( std::size_t at = 0; at < size; ) {
+
+            if ( std::memcmp( data + at, zero, std::min<std::size_t>( page_size, size - at ) ) == 0 ) {
+
+                at += page_size;
+                continue;
+            }
+
+            std::size_t end = at + page_size;
+
+            while ( end < size && std::memcmp( data + end, zero, std::min<std::size_t>( page_size, size - end ) ) != 0 ) {
+
+                end += page_size;
+            }
+
+            end = std::min( end, size );
+
+            if ( ::pwrite( fd, data + at, end - at, offset + at ) != static_cast<ssize_t>( end - at ) ) {
+                return false;
+            }
+
+            written += end - at;
+            at = end;
+        }
+
+        return true;
+    }
+
+
+    std::vector<std::uint8_t> build_notes( pid_t pid, const std::vector<MemoryRegion>& regions, const std::vector<CoreThread>& threads ) {
+
+        std::vector<std::uint8_t> notes;
+
+        elf_prpsinfo info {};
+        std::string comm = read_proc_file( pid, "comm" );
+        std::string cmdline = read_proc_file( pid, "cmdline" );
+
+        std::replace( cmdline.begin(), cmdline.end(), '\0', ' ' );
+
+        info.pr_sname = 'R';
+        info.pr_pid = pid;
+        info.pr_ppid = ::getpid();
+        std::strncpy( info.pr_fname, comm.substr( 0, comm.find( '\n' ) ).c_str(), sizeof( info.pr_fname ) - 1 );
+        std::strncpy( info.pr_psargs, cmdline.c_str(), sizeof( info.pr_psargs ) - 1 );
+
+        add_note( notes, "CORE", NT_PRPSINFO, &info, sizeof( info ) );
+
+        for ( const CoreThread& thread : threads ) {
+
+            elf_prstatus status {};
+            status.pr_info.si_signo = thread.signal;
+            status.pr_cursig = thread.signal;
+            status.pr_pid = thread.tid;
+            status.pr_ppid = ::getpid();
+            status.pr_pgrp = pid;
+            status.pr_sid = pid;
+            status.pr_fpvalid = 1;
+            static_assert( sizeof( status.pr_reg ) == sizeof( thread.regs ) );
+            std::memcpy( &status.pr_reg, &thread.regs, sizeof( thread.regs ) );
+
+            add_note( notes, "CORE", NT_PRSTATUS, &status, sizeof( status ) );
+            add_note( notes, "CORE", NT_FPREGSET, &thread.fpregs, sizeof( thread.fpregs ) );
+
+            if ( !thread.xstate.empty() ) {
+
+                add_note( notes, "LINUX", NT_X86_XSTATE, thread.xstate.data(), thread.xstate.size() );
+            }
+        }
+
+        std::string auxv = read_proc_file( pid, "auxv" );
+
+        add_note( notes, "CORE", NT_AUXV, auxv.data(), auxv.size() );
+
+        // count, page size, then start, end and page offset per mapped file, then their names
+        std::vector<std::uint64_t> files = { 0, page_size };
+        std::string names;
+
+        for ( const MemoryRegion& r : regions ) {
+
+            if ( r.path.starts_with( "/" ) ) {
+
+                files.insert( files.end(), { r.start, r.end, r.offset / page_size } );
+                names += r.path + '\0';
+                ++files[0];
+            }
+        }
+
+        std::vector<std::uint8_t> file_note( files.size() * sizeof( std::uint64_t ) + names.size() );
+        std::memcpy( file_note.data(), files.data(), files.size() * sizeof( std::uint64_t ) );
+        std::memcpy( file_note.data() + files.size() * sizeof( std::uint64_t ), names.data(), names.size() );
+
+        add_note( notes, "CORE", NT_FILE, file_note.data(), file_note.size() );
+
+        return notes;
+    }
+
+
+    // Reads over pages that fail (a file mapping past the end of its file), they stay zero
+    void read_chunk( pid_t pid, std::uint64_t address, std::uint8_t* buffer, std::size_t size ) {
+
+        std::size_t at = 0;
+
+        while ( at < size ) {
+
+            std::size_t got = read_process_memory( pid, address + at, buffer + at, size - at );
+            at += got;
+
+            if ( at < size ) {
+
+                std::size_t skip = std::min<std::size_t>( page_size - ( ( address + at ) % page_size ), size - at );
+                std::memset( buffer + at, 0, skip );
+                at += skip;
+            }
+        }
+    }
+}
+
+
+CoreThread capture_core_thread( pid_t tid, int signal ) {
+
+    CoreThread thread;
+    thread.tid = tid;
+    thread.signal = signal;
+
+    ::ptrace( PTRACE_GETREGS, tid, nullptr, &thread.regs );
+    ::ptrace( PTRACE_GETFPREGS, tid, nullptr, &thread.fpregs );
+
+    thread.xstate.resize( xstate_size );
+    iovec iov { thread.xstate.data(), thread.xstate.size() };
+
+    if ( ::ptrace( PTRACE_GETREGSET, tid, NT_X86_XSTATE, &iov ) == 0 ) {
+
+        thread.xstate.resize( iov.iov_len );
+    }
+    else {
+
+        thread.xstate.clear();
+    }
+
+    return thread;
+}
+
+
+bool write_core_file( const std::string& path, pid_t pid, const std::vector<MemoryRegion>& regions,
+                      const std::vector<CoreThread>& threads, CoreDumpStats& stats, std::string& error ) {
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::uint8_t> notes = build_notes( pid, regions, threads );
+
+    // PN_XNUM and beyond: the real count goes in sh_info of section header 0
+    std::size_t phnum = regions.size() + 1;
+    bool extended = phnum >= PN_XNUM;
+
+    Elf64_Ehdr ehdr {};
+    std::memcpy( ehdr.e_ident, ELFMAG, SELFMAG );
+    ehdr.e_ident[ EI_CLASS ] = ELFCLASS64;
+    ehdr.e_ident[ EI_DATA ] = ELFDATA2LSB;
+    ehdr.e_ident[ EI_VERSION ] = EV_CURRENT;
+    ehdr.e_ident[ EI_OSABI ] = ELFOSABI_NONE;
+    ehdr.e_type = ET_CORE;
+    ehdr.e_machine = EM_X86_64;
+    ehdr.e_version = EV_CURRENT;
+    ehdr.e_phoff = sizeof( Elf64_Ehdr );
+    ehdr.e_ehsize = sizeof( Elf64_Ehdr );
+    ehdr.e_phentsize = sizeof( Elf64_Phdr );
+    ehdr.e_phnum = extended ? PN_XNUM : phnum;
+
+    std::uint64_t offset = ehdr.e_phoff + phnum * sizeof( Elf64_Phdr );
+
+    Elf64_Shdr shdr {};
+
+    if ( extended ) {
+
+        ehdr.e_shoff = offset;
+        ehdr.e_shentsize = sizeof( Elf64_Shdr );
+        ehdr.e_shnum = 1;
+        shdr.sh_info = phnum;
+        offset += sizeof( Elf64_Shdr );
+    }
+
+    std::vector<Elf64_Phdr> phdrs( phnum );
+
+    phdrs[0].p_type = PT_NOTE;
+    phdrs[0].p_offset = offset;
+    phdrs[0].p_filesz = notes.size();
+    phdrs[0].p_align = 4;
+
+    offset = align( offset + notes.size(), page_size );
+
+    std::vector<Segment> segments;
+
+    for ( std::size_t i = 0; i < regions.size(); ++i ) {
+
+        const MemoryRegion& r = regions[i];
+        Elf64_Phdr& phdr = phdrs[ i + 1 ];
+
+        phdr.p_type = PT_LOAD;
+        phdr.p_flags = ( r.allows( MemoryRegion::read ) ? PF_R : 0 ) | ( r.allows( MemoryRegion::write ) ? PF_W : 0 ) |
+                       ( r.allows( MemoryRegion::execute ) ? PF_X : 0 );
+        phdr.p_vaddr = r.start;
+        phdr.p_memsz = r.end - r.start;
+        phdr.p_filesz = dumped_size( r );
+        phdr.p_offset = offset;
+        phdr.p_align = page_size;
+
+        if ( phdr.p_filesz != 0 ) {
+
+            segments.push_back( Segment { &r, offset, phdr.p_filesz } );
+            offset += phdr.p_filesz;
+        }
+    }
+
+    int fd = ::open( path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600 );
+
+    if ( fd < 0 ) {
+
+        error = "Can't create " + path + ": " + std::strerror( errno );
+        return false;
+    }
+
+    std::vector<std::uint8_t> headers( sizeof( ehdr ) );
+    std::memcpy( headers.data(), &ehdr, sizeof( ehdr ) );
+    headers.insert( headers.end(), reinterpret_cast<const std::uint8_t*>( phdrs.data() ),
+                    reinterpret_cast<const std::uint8_t*>( phdrs.data() + phdrs.size() ) );
+
+    if ( extended ) {
+
+        headers.insert( headers.end(), reinterpret_cast<const std::uint8_t*>( &shdr ), reinterpret_cast<const std::uint8_t*>( &shdr + 1 ) );
+    }
+
+    headers.insert( headers.end(), notes.begin(), notes.end() );
+
+    bool ok = ::pwrite( fd, headers.data(), headers.size(), 0 ) == static_cast<ssize_t>( headers.size() );
+
+    // chunk i is read into one buffer while chunk i - 1 is written from the other
+    std::vector<std::uint8_t> buffers[2] = { std::vector<std::uint8_t>( chunk_size ), std::vector<std::uint8_t>( chunk_size ) };
+    std::future<bool> writing;
+    std::size_t index = 0;
+
+    for ( const Segment& segment : segments ) {
+
+        for ( std::uint64_t at = 0; ok && at < segment.size; at += chunk_size, ++index ) {
+
+            std::size_t size = std::min<std::uint64_t>( chunk_size, segment.size - at );
+            std::uint8_t* buffer = buffers[ index % 2 ].data();
+
+            read_chunk( pid, segment.region->start + at, buffer, size );
+
+            if ( writing.valid() ) {
+                ok = writing.get();
+            }
+
+            writing = std::async( std::launch::async, write_sparse, fd, buffer, size, segment.offset + at, std::ref( stats.written ) );
+            stats.memory += size;
+        }
+    }
+
+    if ( writing.valid() ) {
+        ok = writing.get() && ok;
+    }
+
+    // the holes at the end need the size set explicitly
+    ok = ::ftruncate( fd, offset ) == 0 && ok;
+    ok = ::close( fd ) == 0 && ok;
+
+    if ( !ok ) {
+        error = "Error writing " + path + ": " + std::strerror( errno );
+    }
+
+    stats.segments = regions.size();
+    stats.seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+
+    return ok;
+}
+
+} // namespace MiniDbg
@@ -0,0 +1,505 @@
+#include "coverage.hpp"
+#include "modules.hpp"
+#include "helpers.h"
+
+#include <sys/ptrace.h>
+#include <sys/wait.h>
+#include <sys/user.h>
+#include <sys/auxv.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <map>
+
+
+namespace MiniDbg {
+
+
+namespace {
+
+    constexpr std::uint32_t pf_x = 1;
+    constexpr std::uint64_t span_gap = 4096;     // probes closer than this share one read and write
+    constexpr long ptrace_options = PTRACE_O_EXITKILL | PTRACE_O_TRACECLONE | PTRACE_O_TRACEFORK | PTRACE_O_TRACEVFORK | PTRACE_O_TRACEEXEC;
+
+
+    // Rewrites the byte at every probe of one span, read and written back as a whole
+    template<typename Patch>
+    bool patch_span( int mem_fd, std::uint64_t low, std::uint64_t high, Patch patch ) {
+
+        std::vector<std::uint8_t> bytes( high - low );
+
+        if ( ::pread( mem_fd, bytes.data(), bytes.size(), low ) != static_cast<ssize_t>( bytes.size() ) ) {
+            return false;
+        }
+
+        patch( bytes.data() );
+
+        return ::pwrite( mem_fd, bytes.data(), bytes.size(), low ) == static_cast<ssize_t>( bytes.size() );
+    }
+}
+
+
+CoverageRun::~CoverageRun() {
+
+    close_debug_file( m_debug_file );
+
+    if ( m_mem_fd >= 0 ) {
+        ::close( m_mem_fd );
+    }
+}
+
+
+bool CoverageRun::prepare() {
+
+    const std::string& path = m_argv.front();
+    int fd = ::open( path.c_str(), O_RDONLY );
+
+    if ( fd < 0 ) {
+
+        std::cerr << "[" << "Can't open " << path << "]" << std::endl;
+        return false;
+    }
+
+    try {
+
+        m_elf = elf::elf( elf::create_mmap_loader( fd ) );
+    }
+    catch ( std::exception& e ) {
+
+        std::cerr << "[" << "Can't read " << path << ": " << e.what() << "]" << std::endl;
+        return false;
+    }
+
+    m_dwarf = load_dwarf( m_elf, path, m_debug_file );
+
+    if ( !m_dwarf.valid() ) {
+
+        std::cerr << "[" << "No line tables in " << path << " or a separate debug file" << "]" << std::endl;
+        return false;
+    }
+
+    // functions dropped by --gc-sections keep their rows at address 0, only real text counts
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> text;
+
+    for ( const elf::segment& seg : m_elf.segments() ) {
+
+        if ( seg.get_hdr().type == elf::pt::load && ( static_cast<std::uint32_t>( seg.get_hdr().flags ) & pf_x ) ) {
+
+            text.emplace_back( seg.get_hdr().vaddr, seg.get_hdr().vaddr + seg.get_hdr().memsz );
+        }
+    }
+
+    auto in_text = [ &text ]( std::uint64_t address ) {
+
+        return std::any_of( text.begin(), text.end(), [ address ]( const auto& t ) { return address >= t.first && address < t.second; } );
+    };
+
+    std::map<std::pair<std::string, unsigned>, std::uint32_t> line_index;
+
+    for ( const dwarf::compilation_unit& cu : m_dwarf.compilation_units() ) {
+
+        for ( const dwarf::line_table::entry& entry : cu.get_line_table() ) {
+
+            if ( entry.end_sequence || !entry.is_stmt || entry.line == 0 || !in_text( entry.address ) ) {
+                continue;
+            }
+
+            auto [ it, added ] = line_index.emplace( std::make_pair( entry.file->path, entry.line ), m_lines.size() );
+
+            if ( added ) {
+
+                m_lines.push_back( Line { entry.file->path, entry.line } );
+            }
+
+            m_probes.push_back( Probe { entry.address, { it->second } } );
+        }
+    }
+
+    // rows sharing an address, common once the optimizer merged statements: one probe covers
+    // them all, a line whose every address is shared would otherwise never be seen running
+    std::stable_sort( m_probes.begin(), m_probes.end(), []( const Probe& a, const Probe& b ) { return a.address < b.address; } );
+
+    std::size_t kept = 0;
+
+    for ( std::size_t i = 0; i < m_probes.size(); ++i ) {
+
+        if ( kept != 0 && m_probes[ kept - 1 ].address == m_probes[ i ].address ) {
+
+            std::vector<std::uint32_t>& lines = m_probes[ kept - 1 ].lines;
+            std::uint32_t line = m_probes[ i ].lines.front();
+
+            if ( std::find( lines.begin(), lines.end(), line ) == lines.end() ) {
+
+                lines.push_back( line );
+            }
+            continue;
+        }
+
+        if ( kept != i ) {
+
+            m_probes[ kept ] = std::move( m_probes[ i ] );
+        }
+
+        ++kept;
+    }
+
+    m_probes.resize( kept );
+
+    if ( m_probes.empty() ) {
+
+        std::cerr << "[" << "No statement addresses in " << path << "]" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+
+bool CoverageRun::launch() {
+
+    pid_t pid = ::fork();
+
+    if ( pid == 0 ) {
+
+        std::vector<char*> argv;
+
+        for ( std::string& arg : m_argv ) {
+
+            argv.push_back( arg.data() );
+        }
+
+        argv.push_back( nullptr );
+
+        ::kill( ::getpid(), SIGSTOP );  // wait for the seize
+        ::execv( argv[0], argv.data() );
+
+        std::cerr << "[" << "Error in exec" << "]" << std::endl;
+        ::_exit( EXIT_FAILURE );
+    }
+
+    if ( pid < 0 ) {
+        return false;
+    }
+
+    m_pid = pid;
+
+    int status;
+    ::waitpid( m_pid, &status, WUNTRACED );
+    ::ptrace( PTRACE_SEIZE, m_pid, nullptr, ptrace_options );
+    ::kill( m_pid, SIGCONT );
+
+    while ( ::waitpid( m_pid, &status, __WALL ) == m_pid ) {
+
+        if ( WIFEXITED( status ) || WIFSIGNALED( status ) ) {
+            return false;
+        }
+
+        if ( ( status >> 8 ) == ( SIGTRAP | ( PTRACE_EVENT_EXEC << 8 ) ) ) {
+            break;
+        }
+
+        ::ptrace( PTRACE_CONT, m_pid, nullptr, nullptr );   // the initial group stop and SIGCONT
+    }
+
+    if ( m_elf.get_hdr().type == elf::et::dyn ) {
+
+        std::uint64_t entry = read_auxv_entry( m_pid, AT_ENTRY );
+        m_load_address = entry != 0 ? entry - m_elf.get_hdr().entry : 0;
+    }
+
+    m_mem_fd = ::open( ( "/proc/" + std::to_string( m_pid ) + "/mem" ).c_str(), O_RDWR );
+
+    return m_mem_fd >= 0;
+}
+
+
+bool CoverageRun::arm() {
+
+    auto start = std::chrono::steady_clock::now();
+
+    for ( std::size_t first = 0; first < m_probes.size(); ) {
+
+        std::size_t last = first;
+
+        while ( last + 1 < m_probes.size() && m_probes[ last + 1 ].address - m_probes[ last ].address < span_gap ) {
+
+            ++last;
+        }
+
+        std::uint64_t low = m_probes[ first ].address;
+        std::uint64_t high = m_probes[ last ].address + 1;
+
+        bool written = patch_span( m_mem_fd, m_load_address + low, m_load_address + high, [ & ]( std::uint8_t* bytes ) {
+
+            for ( std::size_t i = first; i <= last; ++i ) {
+
+                m_probes[i].saved = bytes[ m_probes[i].address - low ];
+                m_probes[i].armed = true;
+                bytes[ m_probes[i].address - low ] = 0xcc;
+            }
+        } );
+
+        if ( !written ) {
+
+            std::cerr << "[" << "Can't write breakpoints at 0x" << std::hex << m_load_address + low << "]" << std::endl;
+            return false;
+        }
+
+        ++m_writes;
+        first = last + 1;
+    }
+
+    m_arm_ms = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count();
+
+    return true;
+}
+
+
+bool CoverageRun::disarm_all( pid_t pid ) {
+
+    int mem_fd = ::open( ( "/proc/" + std::to_string( pid ) + "/mem" ).c_str(), O_RDWR );
+
+    if ( mem_fd < 0 ) {
+        return false;
+    }
+
+    bool ok = true;
+
+    for ( std::size_t first = 0; first < m_probes.size(); ) {
+
+        std::size_t last = first;
+
+        while ( last + 1 < m_probes.size() && m_probes[ last + 1 ].address - m_probes[ last ].address < span_gap ) {
+
+            ++last;
+        }
+
+        std::uint64_t low = m_probes[ first ].address;
+
+        ok = patch_span( mem_fd, m_load_address + low, m_load_address + m_probes[ last ].address + 1, [ & ]( std::uint8_t* bytes ) {
+
+            for ( std::size_t i = first; i <= last; ++i ) {
+
+                if ( m_probes[i].armed ) {
+                    bytes[ m_probes[i].address - low ] = m_probes[i].saved;
+                }
+            }
+        } ) && ok;
+
+        first = last + 1;
+    }
+
+    ::close( mem_fd );
+
+    return ok;
+}
+
+
+CoverageRun::Probe* CoverageRun::find_probe( std::uint64_t address ) {
+
+    auto it = std::lower_bound( m_probes.begin(), m_probes.end(), address, []( const Probe& p, std::uint64_t a ) { return p.address < a; } );
+
+    return it != m_probes.end() && it->address == address ? &*it : nullptr;
+}
+
+
+// One-shot: the original byte goes back and the thread runs the instruction for real
+bool CoverageRun::handle_trap( pid_t tid ) {
+
+    user_regs_struct regs;
+
+    if ( ::ptrace( PTRACE_GETREGS, tid, nullptr, &regs ) < 0 ) {
+        return false;
+    }
+
+    Probe* probe = find_probe( regs.rip - 1 - m_load_address );
+
+    if ( probe == nullptr ) {
+        return false;
+    }
+
+    // another thread may have hit it at the same time and restored it already
+    if ( probe->armed ) {
+
+        ::pwrite( m_mem_fd, &probe->saved, 1, regs.rip - 1 );
+        probe->armed = false;
+
+        for ( std::uint32_t line : probe->lines ) {
+
+            m_lines[ line ].hit = true;
+        }
+
+        ++m_writes;
+    }
+
+    regs.rip -= 1;
+    ::ptrace( PTRACE_SETREGS, tid, nullptr, &regs );
+
+    return true;
+}
+
+
+// The first stop of a fork or vfork child, once both it and its parent's event arrived
+void CoverageRun::handle_new_process( pid_t pid, bool vfork ) {
+
+    if ( vfork ) {
+
+        // shares the parent's memory and so its probes, its hits are real coverage
+        ::ptrace( PTRACE_CONT, pid, nullptr, nullptr );
+        return;
+    }
+
+    // a copy of the int3s with nobody to catch them
+    disarm_all( pid );
+    ::ptrace( PTRACE_DETACH, pid, nullptr, nullptr );
+}
+
+
+bool CoverageRun::run( int& status ) {
+
+    if ( !launch() || !arm() ) {
+
+        if ( m_pid > 0 ) {
+            ::kill( m_pid, SIGKILL );
+        }
+
+        return false;
+    }
+
+    ::ptrace( PTRACE_CONT, m_pid, nullptr, nullptr );
+
+    while ( true ) {
+
+        int wait_status;
+        pid_t tid = ::waitpid( -1, &wait_status, __WALL );
+
+        if ( tid < 0 ) {
+            return false;
+        }
+
+        if ( WIFEXITED( wait_status ) || WIFSIGNALED( wait_status ) ) {
+
+            if ( tid == m_pid ) {
+
+                status = wait_status;
+                return true;
+            }
+
+            m_vforked.erase( tid );
+            continue;
+        }
+
+        int event = wait_status >> 16;
+        int signal = 0;
+
+        if ( event == PTRACE_EVENT_FORK || event == PTRACE_EVENT_VFORK ) {
+
+            unsigned long child;
+            ::ptrace( PTRACE_GETEVENTMSG, tid, nullptr, &child );
+
+            bool vfork = event == PTRACE_EVENT_VFORK;
+
+            if ( m_early.erase( child ) ) {
+
+                handle_new_process( child, vfork );
+            }
+            else {
+
+                ( vfork ? m_vforked : m_forked ).insert( child );
+            }
+        }
+        else if ( event == PTRACE_EVENT_EXEC ) {
+
+            if ( read_tgid( tid ) == m_pid ) {
+
+                // a new program, none of the probes exist any more; let it run to the end untraced
+                ::ptrace( PTRACE_DETACH, tid, nullptr, nullptr );
+                ::waitpid( m_pid, &status, 0 );
+                return true;
+            }
+
+            m_vforked.erase( tid );
+            ::ptrace( PTRACE_DETACH, tid, nullptr, nullptr );
+            continue;
+        }
+        else if ( event == PTRACE_EVENT_STOP ) {
+
+            pid_t tgid = read_tgid( tid );
+
+            // the first stop of a new process: wait for the fork event unless it came already
+            if ( tgid != m_pid && !m_vforked.count( tgid ) ) {
+
+                if ( m_forked.erase( tid ) ) {
+                    handle_new_process( tid, false );
+                }
+                else {
+                    m_early.insert( tid );
+                }
+
+                continue;
+            }
+        }
+        else if ( event == 0 ) {
+
+            signal = WSTOPSIG( wait_status );
+
+            if ( signal == SIGTRAP && handle_trap( tid ) ) {
+                signal = 0;
+            }
+        }
+
+        ::ptrace( PTRACE_CONT, tid, nullptr, static_cast<long>( signal ) );
+    }
+}
+
+
+bool CoverageRun::write_lcov( const std::string& path ) const {
+
+    std::map<std::string, std::map<unsigned, bool>> files;
+
+    for ( const Line& line : m_lines ) {
+
+        files[ line.file ][ line.number ] = line.hit;
+    }
+
+    std::ofstream out( path );
+
+    if ( !out ) {
+        return false;
+    }
+
+    for ( const auto& [ file, lines ] : files ) {
+
+        out << "TN:\nSF:" << file << "\n";
+
+        std::size_t hit = 0;
+
+        for ( const auto& [ number, executed ] : lines ) {
+
+            out << "DA:" << number << "," << ( executed ? 1 : 0 ) << "\n";
+            hit += executed;
+        }
+
+        out << "LF:" << lines.size() << "\nLH:" << hit << "\nend_of_record\n";
+    }
+
+    return bool( out );
+}
+
+
+void CoverageRun::print_summary( std::ostream& os ) const {
+
+    std::size_t hit = std::count_if( m_lines.begin(), m_lines.end(), []( const Line& l ) { return l.hit; } );
+
+    os << "[" << "Lines executed: " << std::dec << hit << " of " << m_lines.size() << " ("
+       << std::fixed << std::setprecision( 1 ) << ( m_lines.empty() ? 0.0 : 100.0 * hit / m_lines.size() ) << "%), "
+       << m_probes.size() << " breakpoints armed in " << m_arm_ms << " ms, " << m_writes << " writes to memory" << "]"
+       << std::defaultfloat << std::endl;
+}
+
+} // namespace MiniDbg
@@ -0,0 +1,304 @@
+#include "debug_info.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <array>
+#include <cstring>
+
+
+namespace MiniDbg {
+
+
+namespace {
+
+    constexpr std::uint32_t nt_gnu_build_id = 3;
+    constexpr std::size_t crc_chunk = 1 << 16;
+
+    std::vector<std::string> g_debug_file_directories = { "/usr/lib/debug" };
+
+
+    std::array<std::uint32_t, 256> make_crc_table() {
+
+        std::array<std::uint32_t, 256> table;
+
+        for ( std::uint32_t i = 0; i < 256; ++i ) {
+
+            std::uint32_t c = i;
+
+            for ( int k = 0; k < 8; ++k ) {
+
+                c = c & 1 ? 0xedb88320u ^ ( c >> 1 ) : c >> 1;
+            }
+
+            table[i] = c;
+        }
+
+        return table;
+    }
+
+
+    bool file_exists( const std::string& path ) {
+
+        struct stat st;
+        return ::stat( path.c_str(), &st ) == 0 && S_ISREG( st.st_mode );
+    }
+
+
+    std::string directory_of( const std::string& path ) {
+
+        std::size_t slash = path.rfind( '/' );
+        return slash == std::string::npos ? "." : path.substr( 0, slash );
+    }
+
+
+    bool open_elf( const std::string& path, DebugFile& file ) {
+
+        int fd = ::open( path.c_str(), O_RDONLY );     // the loader closes it once mapped
+
+        if ( fd < 0 ) {
+            return false;
+        }
+
+        try {
+
+            file.elf = elf::elf( elf::create_mmap_loader( fd ) );
+            file.path = path;
+            return true;
+        }
+        catch ( std::exception& e ) {
+
+            close_debug_file( file );
+            return false;
+        }
+    }
+
+
+    bool has_dwarf( const elf::elf& elf ) {
+
+        for ( const elf::section& sec : elf.sections() ) {
+
+            if ( ( sec.get_name() == ".debug_info" || sec.get_name() == ".zdebug_info" ) && sec.get_hdr().type != elf::sht::nobits ) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+
+    // .gnu_debuglink: a NUL terminated file name, padded to 4 bytes, then the CRC
+    bool read_debuglink( const elf::elf& elf, std::string& name, std::uint32_t& crc ) {
+
+        for ( const elf::section& sec : elf.sections() ) {
+
+            if ( sec.get_name() != ".gnu_debuglink" ) {
+                continue;
+            }
+
+            const char* data = static_cast<const char*>( sec.data() );
+            std::size_t length = ::strnlen( data, sec.size() );
+            std::size_t crc_at = ( length + 4 ) & ~std::size_t( 3 );
+
+            if ( length == 0 || crc_at + sizeof( crc ) > sec.size() ) {
+                return false;
+            }
+
+            name.assign( data, length );
+            std::memcpy( &crc, data + crc_at, sizeof( crc ) );
+            return true;
+        }
+
+        return false;
+    }
+}
+
+
+void set_debug_file_directories( const std::vector<std::string>& directories ) {
+
+    g_debug_file_directories = directories;
+}
+
+
+const std::vector<std::string>& debug_file_directories() {
+
+    return g_debug_file_directories;
+}
+
+
+std::uint32_t crc32( std::uint32_t crc, const void* data, std::size_t size ) {
+
+    static const std::array<std::uint32_t, 256> table = make_crc_table();
+
+    const std::uint8_t* bytes = static_cast<const std::uint8_t*>( data );
+    crc = ~crc;
+
+    for ( std::size_t i = 0; i < size; ++i ) {
+
+        crc = table[ ( crc ^ bytes[i] ) & 0xff ] ^ ( crc >> 8 );
+    }
+
+    return ~crc;
+}
+
+
+bool file_crc32( const std::string& path, std::uint32_t& crc ) {
+
+    int fd = ::open( path.c_str(), O_RDONLY );
+
+    if ( fd < 0 ) {
+        return false;
+    }
+
+    std::vector<char> buffer( crc_chunk );
+    ssize_t n;
+    crc = 0;
+
+    while ( ( n = ::read( fd, buffer.data(), buffer.size() ) ) > 0 ) {
+
+        crc = crc32( crc, buffer.data(), n );
+    }
+
+    ::close( fd );
+
+    return n == 0;
+}
+
+
+std::string read_build_id( const elf::elf& elf ) {
+
+    for ( const elf::section& sec : elf.sections() ) {
+
+        if ( sec.get_hdr().type != elf::sht::note ) {
+            continue;
+        }
+
+        // namesz, descsz, type, then the name and the descriptor, each padded to 4 bytes
+        const std::uint8_t* data = static_cast<const std::uint8_t*>( sec.data() );
+        std::size_t size = sec.size();
+        std::size_t at = 0;
+
+        while ( at + 12 <= size ) {
+
+            std::uint32_t header[3];
+            std::memcpy( header, data + at, sizeof( header ) );
+
+            std::size_t name_at = at + 12;
+            std::size_t desc_at = name_at + ( ( header[0] + 3 ) & ~3u );
+            std::size_t next = desc_at + ( ( header[1] + 3 ) & ~3u );
+
+            if ( next > size ) {
+                break;
+            }
+
+            if ( header[2] == nt_gnu_build_id && header[0] == 4 && std::memcmp( data + name_at, "GNU", 4 ) == 0 ) {
+
+                static const char digits[] = "0123456789abcdef";
+                std::string id;
+
+                for ( std::size_t i = 0; i < header[1]; ++i ) {
+
+                    id += digits[ data[ desc_at + i ] >> 4 ];
+                    id += digits[ data[ desc_at + i ] & 0xf ];
+                }
+
+                return id;
+            }
+
+            at = next;
+        }
+    }
+
+    return "";
+}
+
+
+std::string find_debug_file( const elf::elf& elf, const std::string& path ) {
+
+    std::string id = read_build_id( elf );
+
+    if ( id.size() > 2 ) {
+
+        for ( const std::string& directory : g_debug_file_directories ) {
+
+            std::string candidate = directory + "/.build-id/" + id.substr( 0, 2 ) + "/" + id.substr( 2 ) + ".debug";
+
+            // the name already says which build it is for, opening it only to confirm is cheap
+            DebugFile file;
+
+            if ( file_exists( candidate ) && open_elf( candidate, file ) ) {
+
+                bool match = read_build_id( file.elf ) == id;
+                close_debug_file( file );
+
+                if ( match ) {
+                    return candidate;
+                }
+            }
+        }
+    }
+
+    std::string name;
+    std::uint32_t expected;
+
+    if ( !read_debuglink( elf, name, expected ) ) {
+        return "";
+    }
+
+    std::string directory = directory_of( path );
+    std::vector<std::string> candidates = { directory + "/" + name, directory + "/.debug/" + name };
+
+    for ( const std::string& debug_directory : g_debug_file_directories ) {
+
+        candidates.push_back( debug_directory + directory + "/" + name );
+    }
+
+    for ( const std::string& candidate : candidates ) {
+
+        std::uint32_t crc;
+
+        // the link names the binary itself when it was never stripped
+        if ( candidate != path && file_exists( candidate ) && file_crc32( candidate, crc ) && crc == expected ) {
+            return candidate;
+        }
+    }
+
+    return "";
+}
+
+
+dwarf::dwarf load_dwarf( const elf::elf& elf, const std::string& path, DebugFile& separate ) {
+
+    const elf::elf* source = &elf;
+
+    if ( !has_dwarf( elf ) ) {
+
+        std::string file = find_debug_file( elf, path );
+
+        if ( file.empty() || !open_elf( file, separate ) ) {
+            return dwarf::dwarf();
+        }
+
+        source = &separate.elf;
+    }
+
+    try {
+
+        separate.sections = create_section_loader( *source );
+        return dwarf::dwarf( separate.sections );
+    }
+    catch ( std::exception& e ) {
+
+        return dwarf::dwarf();
+    }
+}
+
+
+void close_debug_file( DebugFile& separate ) {
+
+    separate.sections.reset();
+    separate.elf = elf::elf();
+    separate.path.clear();
+}
+
+} // namespace MiniDbg
@@ -8,6 +8,8 @@
 #include <iomanip>
 #include <fstream>
 #include <linux/limits.h>
+#include <thread>
+#include <cerrno>
 
 #include "debugger.hpp"
 #include "registers.hpp"
@@ -17,20 +19,59 @@
 
 
 
-MiniDbg::Debugger::Debugger( const std::string& prog_name ) : m_prog_name( prog_name ), m_state( State::NOT_RUNNING ) {}
+MiniDbg::Debugger::Debugger( const std::string& prog_name ) : m_state( State::NOT_RUNNING ) {
+
+    m_inferior = &m_inferiors[ m_inferior_number ];
+    m_inferior->prog_name = prog_name;
+}
 
 
 int MiniDbg::Debugger::Run() {
 
+    if ( !setup_event_loop() ) {
+
+        std::cerr << "[" << "Can't set up event loop" << "]" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::thread tracer( &Debugger::tracer_loop, this );
+
     char* line = nullptr;
 
-    while( ( line = ::linenoise( "(minidbg) " ) ) != nullptr ) {
-        
-        handle_command( line );
-        ::linenoiseHistoryAdd( line );
-        ::linenoiseFree( line );
+    while ( true ) {
+
+        errno = 0;
+        line = ::linenoise( "(minidbg) " );
+
+        if ( line == nullptr ) {
+
+            if ( errno != EAGAIN ) {
+                break;      // Ctrl+D
+            }
+
+            m_commands.push( "interrupt" );     // Ctrl+C at the prompt
+        }
+        else {
+
+            m_commands.push( line );
+            ::linenoiseHistoryAdd( line );
+            ::linenoiseFree( line );
+        }
+
+        uint64_t one = 1;
+        ::write( m_command_fd, &one, sizeof( one ) );
+
+        uint64_t done;
+        ::read( m_done_fd, &done, sizeof( done ) );
     }
 
+    m_quit = true;
+
+    uint64_t one = 1;
+    ::write( m_command_fd, &one, sizeof( one ) );
+
+    tracer.join();
+
     return EXIT_SUCCESS;
 }
 
@@ -38,11 +79,16 @@ int MiniDbg::Debugger::Run() {
 void MiniDbg::Debugger::handle_command( const std::string& line ) {
 
     std::vector<std::string> args = split( line, ' ' );
+
+    if ( args.empty() ) {
+        return;
+    }
+
     std::string command = args[0];
 
     if ( is_prefix( command, "run" ) ) {
 
-        launch_debuggee( m_prog_name );
+        launch_debuggee( m_inferior->prog_name );
     }
 
     else if ( is_prefix( command, "attach") ) {
@@ -52,14 +98,28 @@ void MiniDbg::Debugger::handle_command( const std::string& line ) {
 
     else if ( is_prefix( command, "detach") ) {
 
-        detach_debuggee();
+        detach_debuggee( args.size() > 1 && args[1] == "force" );
     }
 
     else if ( is_prefix( command, "cont" ) ) {
 
-        continue_execution();
+        if ( !check_thread_stopped() ) {
+            return;
+        }
+
+        if ( args.size() > 1 && args[1] == "&" ) {
+
+            resume_execution();     // stops are reported by the event loop
+        }
+        else {
+
+            continue_execution();
+            show_displays();
+            print_stat();
+        }
     }
 
+
     else if ( is_prefix( command, "break" ) ) {
 
         if ( args[1].starts_with("0x") ) {
@@ -79,21 +139,43 @@ void MiniDbg::Debugger::handle_command( const std::string& line ) {
     }
 
     else if ( is_prefix( command, "step" ) ) {
+
+        if ( !check_thread_stopped() ) {
+            return;
+        }
         
         step_in();
+        show_displays();
+        print_stat();
     }
 
     else if ( is_prefix( command, "next" ) ) {
+
+        if ( !check_thread_stopped() ) {
+            return;
+        }
      
         step_over();
+        show_displays();
+        print_stat();
     }
 
     else if ( is_prefix( command, "finish" ) ) {
+
+        if ( !check_thread_stopped() ) {
+            return;
+        }
         
         step_out();
+        show_displays();
+        print_stat();
     }
     else if ( is_prefix( command, "stepi" ) ) {
 
+        if ( !check_thread_stopped() ) {
+            return;
+        }
+
         single_step_instruction_with_breakpoint_check();
 
         try {
@@ -105,50 +187,246 @@ void MiniDbg::Debugger::handle_command( const std::string& line ) {
 
             std::cerr << "[" << "Error printing source " << e.what() << "]" <<std::endl;
         }
+
+        show_displays();
+        print_stat();
     }
 
     else if ( is_prefix( command, "register" ) ) {
 
+        if ( !check_thread_stopped() ) {
+            return;
+        }
+
         if ( is_prefix( args[1], "dump" ) ) {
             
             dump_registers();
         }
         else if ( is_prefix( args[1], "read" ) ) {
         
-            std::cout << get_register_value( m_pid, get_register_from_name( args[2] ) ) << std::endl;
+            std::cout << get_register_value( m_inferior->tid, get_register_from_name( args[2] ) ) << std::endl;
         }
         else if ( is_prefix( args[1], "write" ) ) {
         
             std::string val( args[3], 2 ); //assume 0xVAL
-            set_register_value( m_pid, get_register_from_name(args[2]), std::stoul( val, 0, 16 ) );
+            set_register_value( m_inferior->tid, get_register_from_name(args[2]), std::stoul( val, 0, 16 ) );
+            current_thread().regs_valid = false;
         }
     }
 
     else if ( is_prefix( command, "memory" ) ) {
+
+        if ( !check_thread_stopped() ) {
+            return;
+        }
         
         std::string addr ( args[2], 2 ); //assume 0xADDRESS
 
         if ( is_prefix( args[1], "read" ) ) {
 
-            std::cout << std::hex << read_memory( std::stoul( addr, 0, 16 ) ) << std::endl;
+            if ( check_memory( std::stoul( addr, 0, 16 ), sizeof( uint64_t ), MemoryRegion::read ) ) {
+
+                std::cout << std::hex << read_memory( std::stoul( addr, 0, 16 ) ) << std::endl;
+            }
         }
         else if ( is_prefix( args[1], "write" ) ) {
         
             std::string val (args[3], 2); //assume 0xVAL
-            write_memory( std::stol( addr, 0, 16 ), std::stoul(val, 0, 16));
+
+            // ptrace pokes through read-only text, only refuse what is not mapped at all
+            if ( check_memory( std::stoul( addr, 0, 16 ), sizeof( uint64_t ), 0 ) ) {
+
+                write_memory( std::stol( addr, 0, 16 ), std::stoul(val, 0, 16));
+            }
         }
     }
     
     else if ( is_prefix( command, "backtrace" ) ) {
 
+        if ( !check_thread_stopped() ) {
+            return;
+        }
+
         print_backtrace();
     }
 
     else if ( is_prefix( command, "variables" ) ) {
 
+        if ( !check_thread_stopped() ) {
+            return;
+        }
+
         read_variables();
     }
 
+    else if ( is_prefix( command, "print" ) ) {
+
+        if ( !check_thread_stopped() ) {
+            return;
+        }
+
+        std::string expression = skip_words( line, 1 );
+
+        if ( expression.empty() ) {
+
+            std::cerr << "[" << "Usage: print <expression>" << "]" << std::endl;
+            return;
+        }
+
+        print_expression( expression );
+    }
+
+    else if ( is_prefix( command, "display" ) ) {
+
+        if ( args.size() < 2 ) {
+
+            show_displays();
+        }
+        else {
+
+            add_display( skip_words( line, 1 ) );
+        }
+    }
+
+    else if ( is_prefix( command, "undisplay" ) ) {
+
+        remove_display( args.size() > 1 ? std::stoi( args[1] ) : 0 );
+    }
+
+    else if ( is_prefix( command, "profile" ) ) {
+
+        if ( args.size() < 3 ) {
+
+            std::cerr << "[" << "Usage: profile <hz> <seconds> [pid]" << "]" << std::endl;
+            return;
+        }
+
+        pid_t pid = args.size() > 3 ? std::stoi( args[3] ) : 0;
+        profile( std::stoul( args[1] ), std::stoul( args[2] ), pid );
+    }
+
+    else if ( is_prefix( command, "monitor" ) ) {
+
+        monitor( args );
+    }
+
+    else if ( is_prefix( command, "stat" ) ) {
+
+        if ( args.size() < 2 ) {
+
+            print_stat();
+        }
+        else {
+
+            set_stat_mode( args[1] == "on" );
+        }
+    }
+
+    else if ( is_prefix( command, "info" ) ) {
+
+        if ( args.size() > 1 && is_prefix( args[1], "threads" ) ) {
+
+            print_threads();
+        }
+        else if ( args.size() > 1 && is_prefix( args[1], "inferiors" ) ) {
+
+            print_inferiors();
+        }
+        else if ( args.size() > 1 && is_prefix( args[1], "sharedlibrary" ) ) {
+
+            print_shared_libraries();
+        }
+        else if ( args.size() > 1 && is_prefix( args[1], "signals" ) ) {
+
+            m_signals.print( std::cout, args.size() > 2 ? signal_number( args[2] ) : 0 );
+        }
+        else if ( args.size() > 1 && is_prefix( args[1], "catchpoints" ) ) {
+
+            print_catchpoints();
+        }
+        else if ( args.size() > 2 && is_prefix( args[1], "proc" ) ) {
+
+            print_mappings( is_prefix( args[2], "smaps" ) );
+        }
+    }
+
+    else if ( command == "find" ) {
+
+        find_memory( args );
+    }
+
+    else if ( is_prefix( command, "snapshot" ) ) {
+
+        snapshot( args );
+    }
+
+    else if ( is_prefix( command, "heaptrack" ) ) {
+
+        heaptrack( args );
+    }
+
+    else if ( command == "gcore" || command == "generate-core-file" ) {
+
+        gcore( args );
+    }
+
+    else if ( is_prefix( command, "inferior" ) && args.size() > 1 ) {
+
+        switch_to_inferior( std::stoi( args[1] ) );
+        std::cout << "[" << "Switching to inferior " << std::dec << m_inferior_number << " (process " << m_inferior->pid << ")" << "]" << std::endl;
+    }
+
+    else if ( is_prefix( command, "interrupt" ) ) {
+
+        interrupt_inferior();
+    }
+
+    else if ( is_prefix( command, "thread" ) ) {
+
+        if ( args.size() < 2 ) {
+
+            print_threads();
+        }
+        else {
+
+            select_thread( std::stoi( args[1] ) );
+        }
+    }
+
+    else if ( is_prefix( command, "catch" ) ) {
+
+        if ( args.size() > 1 && is_prefix( args[1], "syscall" ) ) {
+
+            catch_syscall( args );
+        }
+        else {
+
+            std::cerr << "[" << "Usage: catch syscall <name>[,<name>...] [if <condition>]" << "]" << std::endl;
+        }
+    }
+
+    else if ( is_prefix( command, "handle" ) ) {
+
+        if ( !m_signals.set( args ) ) {
+
+            std::cerr << "[" << "Usage: handle <signal>|all [stop|nostop] [print|noprint] [pass|nopass]" << "]" << std::endl;
+        }
+        else if ( args.size() > 1 && args[1] != "all" ) {
+
+            m_signals.print( std::cout, signal_number( args[1] ) );
+        }
+    }
+
+    else if ( is_prefix( command, "uncatch" ) ) {
+
+        remove_catchpoint( args.size() > 1 ? std::stoi( args[1] ) : 0 );
+    }
+
+    else if ( is_prefix( command, "set" ) ) {
+
+        handle_set_command( args );
+    }
+
     else if ( is_prefix( command, "symbol" ) ) {
 
         std::vector<MiniDbg::Symbol> syms = lookup_symbol( args[1] );
@@ -167,21 +445,94 @@ void MiniDbg::Debugger::handle_command( const std::string& line ) {
 
 void MiniDbg::Debugger::continue_execution() {
 
-    step_over_breakpoint();
-    ::ptrace( PTRACE_CONT, m_pid, nullptr, nullptr );
+    resume_execution();
     wait_for_signal();
 }
 
 
-void MiniDbg::Debugger::wait_for_signal() {
- 
-    int status;
-    int options = 0;
+void MiniDbg::Debugger::resume_execution() {
+
+    step_over_breakpoint();
+    m_perf_counters.Enable();
+
+    if ( m_non_stop ) {
+
+        resume_thread( current_thread(), PTRACE_CONT );
+    }
+    else {
+
+        resume_all_threads();
+    }
+}
+
+
+bool MiniDbg::Debugger::process_wait_event( pid_t tid, int status ) {
+
+    if ( handle_passthrough_event( tid, status ) ) {
+        return false;
+    }
+
+    bool reported = handle_thread_event( tid, status );
+
+    detach_pending_inferiors();
+
+    if ( !reported ) {
+        return false;
+    }
+
+    if ( !m_threads.count( tid ) ) {
+        return true;    // the whole process is gone
+    }
+
+    if ( handle_solib_event( tid ) ) {
+        return false;   // the dynamic loader changed the library list, keep going
+    }
+
+    if ( handle_heap_event( tid ) ) {
+        return false;   // an allocation recorded, keep going
+    }
+
+    if ( m_non_stop && tid != m_inferior->tid ) {
+
+        report_thread_stop( m_threads.at( tid ) );
+        return false;
+    }
+
+    m_perf_counters.Disable();
+
+    if ( !m_non_stop ) {
+
+        stop_all_threads();
+        detach_pending_inferiors();
+    }
+
+    if ( m_threads.at( tid ).pid != m_inferior->pid ) {
+
+        switch_to_inferior( inferior_number( m_threads.at( tid ).pid ) );
+        std::cout << "[" << "Switching to inferior " << std::dec << m_inferior_number << " (process " << m_inferior->pid << ")" << "]" << std::endl;
+    }
+
+    if ( tid != m_inferior->tid ) {
+
+        m_inferior->tid = tid;
+        std::cout << "[" << "Switching to thread " << std::dec << m_threads.at( tid ).number << " (" << tid << ")" << "]" << std::endl;
+    }
 
-    ::waitpid( m_pid, &status, options );
     process_status( status );
 
-    siginfo_t siginfo = get_signal_info();
+    if ( current_thread().reason == StopReason::interrupted ) {
+
+        std::cout << "Thread " << std::dec << current_thread().number << " interrupted" << std::endl;
+        return true;
+    }
+
+    if ( current_thread().reason == StopReason::syscall ) {
+
+        print_syscall_stop( current_thread() );
+        return true;
+    }
+
+    siginfo_t siginfo = get_signal_info( tid );
 
     switch ( siginfo.si_signo ) {
 
@@ -192,15 +543,17 @@ void MiniDbg::Debugger::wait_for_signal() {
             std::cout << "Got segfault. Reason: " << siginfo.si_code << std::endl;
             break;
         default:
-            std::cout << "Got signal " << std::dec << siginfo.si_signo << " " << "\"" << strsignal( siginfo.si_signo ) << "\"" << std::endl;
+            std::cout << "Got signal " << signal_name( siginfo.si_signo ) << " " << "\"" << strsignal( siginfo.si_signo ) << "\"" << std::endl;
     }
+
+    return true;
 }
 
 
-siginfo_t MiniDbg::Debugger::get_signal_info() {
+siginfo_t MiniDbg::Debugger::get_signal_info( pid_t tid ) {
 
     siginfo_t info;
-    ::ptrace( PTRACE_GETSIGINFO, m_pid, nullptr, &info );
+    ::ptrace( PTRACE_GETSIGINFO, tid, nullptr, &info );
     return info;
 }
 
@@ -212,9 +565,14 @@ void MiniDbg::Debugger::handle_sigtrap( siginfo_t info ) {
         case SI_KERNEL:
         case TRAP_BRKPT:
         {
-            set_pc( get_pc() - 1 );
-
             std::cout << "[" << "Hit breakpoint at address 0x" << std::hex << get_pc() << "]" <<std::endl;           
+
+            if ( const Module* module = m_inferior->modules.find( get_pc() ) ) {
+
+                print_module_location( *module, get_pc() );
+                break;
+            }
+
             uint64_t offset_pc = offset_load_address( get_pc() ); 
             dwarf::line_table::iterator line_entry = get_line_entry_from_pc( offset_pc );           
             print_source( line_entry->file->path, line_entry->line );     
@@ -262,50 +620,217 @@ void MiniDbg::Debugger::process_status( int status ) {
 
 void MiniDbg::Debugger::launch_debuggee( const std::string& prog_name ) {
 
-    m_fd = ::open( m_prog_name.c_str(), O_RDONLY );
+    load_debug_info( m_inferior->prog_name );
 
-    m_elf = elf::elf( elf::create_mmap_loader( m_fd ) );
-    m_dwarf = dwarf::dwarf( dwarf::elf::create_loader( m_elf ) );
+    // syscalls caught at launch are trapped by a seccomp filter, the rest run at full speed
+    std::set<long> traced = caught_syscalls();
+    std::vector<sock_filter> filter;
+
+    if ( !traced.empty() ) {
+        filter = build_seccomp_filter( traced );
+    }
 
     pid_t pid = ::fork();
 
     if ( pid == 0 ) {  // child
         
         ::personality( ADDR_NO_RANDOMIZE );
-        execute_debuggee( m_prog_name );
+        execute_debuggee( m_inferior->prog_name, filter );
     }
     else {
 
-        m_pid = pid;
+        m_inferior->pid = pid;
+    }
+
+    // the child stops itself before exec; seize it there so PTRACE_INTERRUPT works on every thread
+    int status;
+    ::waitpid( m_inferior->pid, &status, WUNTRACED );
+    ::ptrace( PTRACE_SEIZE, m_inferior->pid, nullptr, ptrace_options | PTRACE_O_EXITKILL );
+    ::kill( m_inferior->pid, SIGCONT );
+
+    while ( ::waitpid( m_inferior->pid, &status, __WALL ) == m_inferior->pid ) {
+
+        if ( WIFEXITED( status ) || WIFSIGNALED( status ) ) {
+
+            process_status( status );
+            return;
+        }
+
+        if ( ( status >> 8 ) == ( SIGTRAP | ( PTRACE_EVENT_EXEC << 8 ) ) ) {
+            break;
+        }
+
+        ::ptrace( PTRACE_CONT, m_inferior->pid, nullptr, nullptr );   // the initial group stop and SIGCONT
+    }
+
+    m_inferior->tid = m_inferior->pid;
+    add_thread( m_inferior->pid, m_inferior->pid );
+    m_inferior->pid_fd = watch_inferior_exit( m_inferior->pid );
+
+    if ( !filter.empty() ) {
+
+        if ( has_seccomp_filter( m_inferior->pid ) ) {
+
+            m_seccomp_filters[ m_inferior->pid ] = traced;
+        }
+        else {
+
+            std::cerr << "[" << "Could not install the seccomp filter, catching syscalls with PTRACE_SYSCALL" << "]" << std::endl;
+        }
     }
 
-    wait_for_signal();
     initialize_load_address();
+    initialize_modules();
     m_state = State::RUNNING;
+
+    if ( m_stat_enabled ) {
+        m_perf_counters.Open( m_inferior->pid );
+    }
+
     std::cout << "Starting program " << prog_name << " SUCCESS" << std::endl; 
 }
 
 
-void MiniDbg::Debugger::execute_debuggee( const std::string& prog_name ) {
+void MiniDbg::Debugger::execute_debuggee( const std::string& prog_name, const std::vector<sock_filter>& filter ) {
 
-    if ( ::ptrace( PTRACE_TRACEME, 0, 0, 0 ) < 0 ) {
-    
-        std::cerr << "[" << "Error in ptrace" << "]" << std::endl;
-        return;
+    sigset_t empty;
+    ::sigemptyset( &empty );
+    ::sigprocmask( SIG_SETMASK, &empty, nullptr );  // the debugger blocks SIGINT/SIGCHLD for its signalfd
+    ::setpgid( 0, 0 );                              // Ctrl+C reaches the debugger only, it interrupts via ptrace
+
+    ::kill( ::getpid(), SIGSTOP );  // wait for the debugger to seize us
+
+    // after the seize: SECCOMP_RET_TRACE without a tracer fails the syscall with ENOSYS
+    if ( !filter.empty() ) {
+        install_seccomp_filter( filter );
     }
     
     ::execl( prog_name.c_str(), prog_name.c_str(), nullptr );
+
+    std::cerr << "[" << "Error in exec" << "]" << std::endl;
+    ::_exit( EXIT_FAILURE );
 }
 
 
 void MiniDbg::Debugger::clear_debuggee_data() {
 
-    m_prog_name.clear();
-    m_pid = 0;
-    m_load_address = 0;
+    if ( m_perf_counters.is_open() ) {
+
+        print_stat();
+        m_perf_counters.Close();
+    }
+
+    if ( m_heap_pid != 0 && m_heap_pid == m_inferior->pid ) {
+
+        print_heap_report( "Leaked at exit" );
+        stop_heap_tracking( false );
+    }
+
+    m_inferior->prog_name.clear();
+    m_seccomp_filters.erase( m_inferior->pid );
+    std::erase_if( m_threads, [ this ]( const auto& entry ) { return entry.second.pid == m_inferior->pid; } );
+    m_inferior->pid = 0;
+    m_inferior->tid = 0;
+
+    if ( m_threads.empty() ) {
+        m_next_thread_number = 1;
+    }
+
+    m_inferior->load_address = 0;
     m_state = State::NOT_RUNNING;
-    m_breakpoints.clear();
-    ::close( m_fd );
+    m_inferior->breakpoints.clear();
+    m_inferior->displaced = DisplacedStepping();
+    m_inferior->function_index.clear();
+    m_inferior->unwinder.clear();
+    m_inferior->types.clear();
+    m_inferior->locations.clear();
+    m_inferior->modules.clear();
+    m_inferior->pending_breakpoints.clear();
+    m_inferior->address_space.clear();
+    m_inferior->snapshot.clear();
+
+    if ( m_inferior->pid_fd >= 0 ) {
+
+        ::close( m_inferior->pid_fd );
+        m_inferior->pid_fd = -1;
+    }
+
+    m_inferior->dwarf = dwarf::dwarf();
+    m_inferior->dwarf_loaded = false;
+    close_debug_file( m_inferior->debug_file );
+}
+
+
+// profile and monitor load a process they never attached to, nothing of it stays behind
+void MiniDbg::Debugger::forget_untraced_process( const std::string& prog_name ) {
+
+    m_inferior->pid = 0;
+    m_inferior->load_address = 0;
+    m_inferior->prog_name = prog_name;
+    m_inferior->elf = elf::elf();
+    m_inferior->dwarf = dwarf::dwarf();
+    m_inferior->dwarf_loaded = false;
+    close_debug_file( m_inferior->debug_file );
+    m_inferior->function_index.clear();
+    m_inferior->unwinder.clear();
+    m_inferior->types.clear();
+    m_inferior->locations.clear();
+    m_inferior->modules.clear();
+    m_inferior->address_space.clear();
+    ++m_run_generation;     // lookups cached for it are stale
+}
+
+
+void MiniDbg::Debugger::load_debug_info( const std::string& path ) {
+
+    // the loader closes the descriptor once the image is mapped
+    int fd = ::open( path.c_str(), O_RDONLY );
+
+    m_inferior->elf = elf::elf( elf::create_mmap_loader( fd ) );
+
+    // symbols and CFI are in the binary even when stripped, the DWARF waits for its first query
+    m_inferior->dwarf = dwarf::dwarf();
+    m_inferior->dwarf_loaded = false;
+    close_debug_file( m_inferior->debug_file );
+
+    m_inferior->function_index.build( m_inferior->elf, m_inferior->dwarf );
+    m_inferior->unwinder.build( m_inferior->elf );
+    m_inferior->types.clear();
+    m_inferior->locations.clear();
+}
+
+
+const dwarf::dwarf& MiniDbg::Debugger::debug_dwarf() {
+
+    if ( m_inferior->dwarf_loaded ) {
+        return m_inferior->dwarf;
+    }
+
+    m_inferior->dwarf_loaded = true;
+    m_inferior->dwarf = load_dwarf( m_inferior->elf, m_inferior->prog_name, m_inferior->debug_file );
+
+    if ( !m_inferior->dwarf.valid() ) {
+
+        std::cout << "[" << "No debugging symbols found in " << m_inferior->prog_name << "]" << std::endl;
+        return m_inferior->dwarf;
+    }
+
+    if ( !m_inferior->debug_file.path.empty() ) {
+
+        std::cout << "[" << "Reading symbols from " << m_inferior->debug_file.path << "]" << std::endl;
+    }
+
+    m_inferior->function_index.build( m_inferior->elf, m_inferior->dwarf );
+    m_inferior->locations.build( m_inferior->debug_file.sections );
+
+    return m_inferior->dwarf;
+}
+
+
+MiniDbg::FunctionIndex& MiniDbg::Debugger::function_index() {
+
+    debug_dwarf();      // DWARF functions and inlined frames join the symbols
+    return m_inferior->function_index;
 }
 
 
@@ -313,46 +838,62 @@ void MiniDbg::Debugger::attach_to_debuggee( const int pid ) {
 
     //clear_debuggee_data();
 
-    m_pid = pid;
-    m_prog_name = get_executable_path_by_pid( pid );
+    m_inferior->pid = pid;
+    m_inferior->prog_name = get_executable_path_by_pid( pid );
 
-    m_fd = open( m_prog_name.c_str(), O_RDONLY );
+    load_debug_info( m_inferior->prog_name );
 
-    m_elf = elf::elf( elf::create_mmap_loader( m_fd ) );
-    m_dwarf = dwarf::dwarf( dwarf::elf::create_loader( m_elf ) );
-
-    if ( ::ptrace( PTRACE_ATTACH, pid, NULL, NULL ) < 0 ) {
+    if ( !seize_threads( pid ) ) {
     
         std::cerr << "Error in ptrace\n";
+        detach_threads();
         clear_debuggee_data();
         return;
     }
     else {
 
-        std::cout << "Attach to PID " << m_pid << " SUCCESS" << std::endl; 
+        m_inferior->tid = pid;
+        m_inferior->pid_fd = watch_inferior_exit( pid );
+
+        std::cout << "Attach to PID " << m_inferior->pid << " SUCCESS" << std::endl; 
         initialize_load_address();
+        initialize_modules();
         m_state = State::RUNNING;
+
+        if ( m_stat_enabled ) {
+            m_perf_counters.Open( m_inferior->pid );
+        }
     }
 }
 
 
-void MiniDbg::Debugger::detach_debuggee() {
+void MiniDbg::Debugger::detach_debuggee( bool force ) {
 
-    for ( auto& [ _, breakpoint ] : m_breakpoints ) {
+    // the filter outlives us, and without a tracer every syscall it traps fails with ENOSYS
+    if ( m_seccomp_filters.count( m_inferior->pid ) ) {
 
-        if ( breakpoint.is_enabled() ) {
-            breakpoint.Disable();
+        if ( !force ) {
+
+            std::cerr << "[" << "Process " << std::dec << m_inferior->pid << " has a seccomp filter, its caught syscalls would fail with ENOSYS after a detach; use 'detach force'" << "]" << std::endl;
+            return;
         }
+
+        std::cout << "[" << "Process " << std::dec << m_inferior->pid << " keeps the seccomp filter, caught syscalls fail with ENOSYS without a tracer" << "]" << std::endl;
     }
 
-    if ( ::ptrace( PTRACE_DETACH, m_pid, NULL, NULL ) < 0 ) {
-    
-        std::cerr << "Error in ptrace\n";
-        return;
+    stop_all_threads();
+
+    for ( auto& [ _, breakpoint ] : m_inferior->breakpoints ) {
+
+        if ( breakpoint.is_enabled() ) {
+            breakpoint.Disable( m_inferior->tid );
+        }
     }
 
+    detach_threads();
     clear_debuggee_data();
     m_state = State::NOT_RUNNING;
+    select_next_inferior();
 }
 
 
@@ -0,0 +1,221 @@
+#include <vector>
+#include <iostream>
+#include <iomanip>
+#include <sys/auxv.h>
+
+#include "debugger.hpp"
+#include "registers.hpp"
+#include "helpers.h"
+
+
+void MiniDbg::Debugger::initialize_modules() {
+
+    m_inferior->modules.clear();
+
+    uint64_t interp_base = read_auxv_entry( m_inferior->pid, AT_BASE );
+
+    if ( interp_base == 0 ) {
+        return;     // statically linked, there is no loader to follow
+    }
+
+    const MemoryRegion* interp = find_region( interp_base );
+
+    if ( interp == nullptr || !m_inferior->modules.start( m_inferior->pid, interp_base, interp->path ) ) {
+
+        std::cerr << "[" << "Can't find r_debug in the dynamic loader, shared libraries are not tracked" << "]" << std::endl;
+        return;
+    }
+
+    // internal, never reported: handle_solib_event steps over it
+    if ( !m_inferior->breakpoints.count( m_inferior->modules.hook() ) ) {
+
+        Breakpoint bp( m_inferior->modules.hook() );
+        bp.Enable( m_inferior->tid );
+        m_inferior->breakpoints.emplace( m_inferior->modules.hook(), bp );
+    }
+
+    update_modules();   // an attach finds the libraries loaded already
+}
+
+
+bool MiniDbg::Debugger::handle_solib_event( pid_t tid ) {
+
+    ThreadState& thread = m_threads.at( tid );
+
+    if ( thread.reason != StopReason::breakpoint || !is_breakpoint( thread.pid, get_register_value( tid, Register::rip ) ) ) {
+        return false;
+    }
+
+    int previous = m_inferior_number;
+
+    if ( thread.pid != m_inferior->pid ) {
+
+        switch_to_inferior( inferior_number( thread.pid ) );
+    }
+
+    bool hook = m_inferior->modules.hook() != 0 && get_register_value( tid, Register::rip ) == m_inferior->modules.hook();
+
+    if ( hook ) {
+
+        update_modules();
+
+        // only this thread stopped, step it off the hook and let it run on
+        pid_t selected = m_inferior->tid;
+        m_inferior->tid = tid;
+
+        step_over_breakpoint();
+
+        if ( m_threads.count( tid ) && thread.status == ThreadStatus::stopped ) {
+
+            m_perf_counters.Enable();
+            resume_thread( thread, PTRACE_CONT );
+        }
+
+        m_inferior->tid = m_threads.count( selected ) ? selected : m_inferior->pid;
+    }
+
+    switch_to_inferior( previous );
+
+    return hook;
+}
+
+
+void MiniDbg::Debugger::update_modules() {
+
+    ModuleChanges changes = m_inferior->modules.update( m_inferior->pid );
+
+    // the int3s went away with the mapping
+    for ( const std::shared_ptr<Module>& module : changes.removed ) {
+
+        std::erase_if( m_inferior->breakpoints, [ &module ]( const auto& entry ) {
+
+            return static_cast<uint64_t>( entry.first ) >= module->low && static_cast<uint64_t>( entry.first ) < module->high;
+        } );
+
+        auto inside = [ &module ]( uint64_t address ) { return address >= module->low && address < module->high; };
+
+        std::erase_if( m_heap_entries, [ &inside ]( const auto& entry ) { return inside( entry.first ); } );
+        std::erase_if( m_heap_returns, inside );
+        std::erase_if( m_heap_breakpoints, inside );
+    }
+
+    // a malloc in a library loaded after heaptrack on, typically libc after an early start
+    if ( m_heap_pid == m_inferior->pid ) {
+
+        for ( const std::shared_ptr<Module>& module : changes.added ) {
+
+            arm_heap_breakpoints( module->elf, module->load_address, true );
+        }
+    }
+
+    if ( changes.added.empty() || m_inferior->pending_breakpoints.empty() ) {
+        return;
+    }
+
+    for ( auto it = m_inferior->pending_breakpoints.begin(); it != m_inferior->pending_breakpoints.end(); ) {
+
+        bool resolved = false;
+        bool is_line = it->find( ':' ) != std::string::npos;
+
+        for ( const std::shared_ptr<Module>& module : changes.added ) {
+
+            if ( is_line || has_function_symbol( module->elf, *it ) ) {
+
+                resolved = set_module_breakpoint( *module, *it ) || resolved;
+            }
+        }
+
+        it = resolved ? m_inferior->pending_breakpoints.erase( it ) : it + 1;
+    }
+}
+
+
+bool MiniDbg::Debugger::set_module_breakpoint( Module& module, const std::string& location ) {
+
+    module.load();
+
+    std::vector<uint64_t> addresses;
+    std::size_t colon = location.rfind( ':' );
+
+    if ( colon != std::string::npos ) {
+
+        addresses = line_breakpoint_addresses( module.dwarf, location.substr( 0, colon ), std::stoi( location.substr( colon + 1 ) ) );
+    }
+    else {
+
+        addresses = function_breakpoint_addresses( module.elf, module.dwarf, location );
+    }
+
+    for ( uint64_t address : addresses ) {
+
+        if ( !m_inferior->breakpoints.count( module.load_address + address ) ) {
+
+            set_breakpoint_at_address( module.load_address + address );
+        }
+    }
+
+    return !addresses.empty();
+}
+
+
+void MiniDbg::Debugger::print_module_location( const Module& module, uint64_t pc ) {
+
+    uint64_t offset_pc = pc - module.load_address;
+
+    if ( module.dwarf.valid() ) {
+
+        for ( const dwarf::compilation_unit& cu : module.dwarf.compilation_units() ) {
+
+            if ( dwarf::die_pc_range( cu.root() ).contains( offset_pc ) ) {
+
+                const dwarf::line_table& lt = cu.get_line_table();
+                dwarf::line_table::iterator line_entry = lt.find_address( offset_pc );
+
+                if ( line_entry != lt.end() ) {
+
+                    print_source( line_entry->file->path, line_entry->line );
+                    return;
+                }
+            }
+        }
+    }
+
+    const FunctionEntry* func = module.function_index.find( offset_pc );
+
+    std::cout << "0x" << std::hex << pc << " in " << ( func ? func->name : "??" ) << " () from " << module.path << std::endl;
+}
+
+
+void MiniDbg::Debugger::print_shared_libraries() {
+
+    if ( m_inferior->modules.modules().empty() ) {
+
+        std::cout << "No shared libraries loaded at this time." << std::endl;
+        return;
+    }
+
+    std::cout << std::left << std::setw( 20 ) << "From" << std::setw( 20 ) << "To" << std::setw( 12 ) << "Debug info" << "Shared Object Library" << std::endl;
+
+    for ( const std::shared_ptr<Module>& module : m_inferior->modules.modules() ) {
+
+        // lazily loaded, so only say what is known
+        std::string debug_info = !module->loaded ? "(not read)" : ( module->dwarf.valid() ? "Yes" : "No" );
+
+        std::cout << "0x" << std::setw( 18 ) << std::hex << module->low << "0x" << std::setw( 18 ) << module->high
+                  << std::setw( 12 ) << debug_info << module->path << std::endl;
+    }
+
+    std::cout << std::right;
+
+    if ( !m_inferior->pending_breakpoints.empty() ) {
+
+        std::cout << "Pending breakpoints:";
+
+        for ( const std::string& location : m_inferior->pending_breakpoints ) {
+
+            std::cout << ' ' << location;
+        }
+
+        std::cout << std::endl;
+    }
+}
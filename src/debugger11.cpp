@@ -0,0 +1,77 @@
+#include <vector>
+#include <iostream>
+#include <iomanip>
+
+#include "debugger.hpp"
+#include "address_space.hpp"
+
+
+const MiniDbg::MemoryRegion* MiniDbg::Debugger::find_region( uint64_t address ) {
+
+    return m_inferior->address_space.find( m_inferior->pid, m_run_generation, address );
+}
+
+
+bool MiniDbg::Debugger::check_memory( uint64_t address, std::size_t size, std::uint8_t permissions ) {
+
+    if ( m_inferior->address_space.check( m_inferior->pid, m_run_generation, address, size, permissions ) ) {
+        return true;
+    }
+
+    const MemoryRegion* region = find_region( address );
+
+    if ( region == nullptr ) {
+
+        std::cerr << "[" << "Cannot access memory at address 0x" << std::hex << address << ", it is not mapped" << "]" << std::endl;
+    }
+    else {
+
+        std::cerr << "[" << "Cannot access memory at address 0x" << std::hex << address << ", "
+                  << ( permissions & MemoryRegion::execute ? "it is not executable" : "it is not readable" ) << "]" << std::endl;
+    }
+
+    return false;
+}
+
+
+void MiniDbg::Debugger::print_mappings( bool usage ) {
+
+    const std::vector<MemoryRegion>& regions = m_inferior->address_space.regions( m_inferior->pid, m_run_generation );
+    std::vector<RegionUsage> counters;
+
+    if ( usage ) {
+
+        counters = m_inferior->address_space.usage( m_inferior->pid );
+    }
+
+    std::cout << std::left << std::setw( 20 ) << "Start" << std::setw( 20 ) << "End" << std::setw( 6 ) << "Perm" << std::setw( 12 ) << "Offset";
+
+    if ( usage ) {
+
+        std::cout << std::setw( 10 ) << "Rss kB" << std::setw( 10 ) << "Pss kB" << std::setw( 10 ) << "Dirty kB" << std::setw( 10 ) << "Swap kB";
+    }
+
+    std::cout << "Path" << std::endl;
+
+    for ( std::size_t i = 0; i < regions.size(); ++i ) {
+
+        const MemoryRegion& r = regions[i];
+        std::string perms = { r.allows( MemoryRegion::read ) ? 'r' : '-', r.allows( MemoryRegion::write ) ? 'w' : '-',
+                              r.allows( MemoryRegion::execute ) ? 'x' : '-', r.allows( MemoryRegion::shared ) ? 's' : 'p' };
+
+        std::cout << std::hex << "0x" << std::setw( 18 ) << r.start << "0x" << std::setw( 18 ) << r.end << std::setw( 6 ) << perms
+                  << "0x" << std::setw( 10 ) << r.offset;
+
+        // smaps was read after maps, a region that changed in between just shows no counters
+        if ( usage ) {
+
+            RegionUsage u = i < counters.size() && counters.size() == regions.size() ? counters[i] : RegionUsage();
+
+            std::cout << std::dec << std::setw( 10 ) << u.rss << std::setw( 10 ) << u.pss << std::setw( 10 ) << u.private_dirty << std::setw( 10 ) << u.swap;
+        }
+
+        std::cout << r.path << std::endl;
+    }
+
+    std::cout << std::right;
+}
@@ -0,0 +1,301 @@
+#include <vector>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <sys/ptrace.h>
+#include <sys/wait.h>
+
+#include "debugger.hpp"
+#include "syscalls.hpp"
+#include "helpers.h"
+
+
+// catch syscall <name>[,<name>...] [<name>...] [if arg<N> <op> <value> [&& ...]]
+void MiniDbg::Debugger::catch_syscall( const std::vector<std::string>& args ) {
+
+    SyscallCatchpoint catchpoint;
+    std::size_t i = 2;
+
+    for ( ; i < args.size() && args[i] != "if"; ++i ) {
+
+        for ( const std::string& name : split( args[i], ',' ) ) {
+
+            long number = syscall_number( name );
+
+            if ( number < 0 ) {
+
+                std::cerr << "[" << "Unknown syscall " << name << "]" << std::endl;
+                return;
+            }
+
+            catchpoint.syscalls.insert( number );
+        }
+    }
+
+    if ( catchpoint.syscalls.empty() ) {
+
+        std::cerr << "[" << "Usage: catch syscall <name>[,<name>...] [if arg<N> <op> <value> [&& ...]]" << "]" << std::endl;
+        return;
+    }
+
+    if ( i < args.size() ) {
+
+        std::vector<std::string> tokens( args.begin() + i + 1, args.end() );
+
+        if ( tokens.empty() || !parse_syscall_conditions( tokens, catchpoint.conditions ) ) {
+
+            std::cerr << "[" << "Bad condition, expected arg<0-5> ==|!=|<|<=|>|>= <number>|\"string\" [&& ...]" << "]" << std::endl;
+            return;
+        }
+
+        for ( const std::string& token : tokens ) {
+
+            catchpoint.condition += ( catchpoint.condition.empty() ? "" : " " ) + token;
+        }
+    }
+
+    catchpoint.number = m_next_catchpoint_number++;
+    m_catchpoints.push_back( catchpoint );
+
+    std::cout << "Catchpoint " << std::dec << catchpoint.number << " (syscall";
+
+    for ( long number : catchpoint.syscalls ) {
+
+        std::cout << " " << syscall_name( number );
+    }
+
+    std::cout << ")" << std::endl;
+
+    // a filter is only installed at launch, anything it does not cover stops every syscall instead
+    if ( m_state == State::RUNNING && syscall_stops_needed( m_inferior->pid ) ) {
+
+        std::cout << "[" << "Not in the seccomp filter of process " << m_inferior->pid << ", every syscall stops until the next run" << "]" << std::endl;
+    }
+}
+
+
+void MiniDbg::Debugger::remove_catchpoint( int number ) {
+
+    if ( number == 0 ) {
+
+        m_catchpoints.clear();
+        return;
+    }
+
+    if ( std::erase_if( m_catchpoints, [ number ]( const SyscallCatchpoint& c ) { return c.number == number; } ) == 0 ) {
+
+        std::cerr << "[" << "No catchpoint number " << std::dec << number << "]" << std::endl;
+    }
+}
+
+
+void MiniDbg::Debugger::print_catchpoints() {
+
+    for ( const SyscallCatchpoint& catchpoint : m_catchpoints ) {
+
+        std::cout << std::dec << std::setw( 3 ) << catchpoint.number << "  syscall";
+
+        for ( long number : catchpoint.syscalls ) {
+
+            std::cout << " " << syscall_name( number );
+        }
+
+        if ( !catchpoint.condition.empty() ) {
+
+            std::cout << " if " << catchpoint.condition;
+        }
+
+        std::cout << "  (hit " << catchpoint.hits << " times)" << std::endl;
+    }
+}
+
+
+std::set<long> MiniDbg::Debugger::caught_syscalls() {
+
+    std::set<long> syscalls;
+
+    for ( const SyscallCatchpoint& catchpoint : m_catchpoints ) {
+
+        syscalls.insert( catchpoint.syscalls.begin(), catchpoint.syscalls.end() );
+    }
+
+    return syscalls;
+}
+
+
+bool MiniDbg::Debugger::syscall_stops_needed( pid_t pid ) {
+
+    auto filter = m_seccomp_filters.find( pid );
+
+    for ( const SyscallCatchpoint& catchpoint : m_catchpoints ) {
+
+        for ( long number : catchpoint.syscalls ) {
+
+            if ( filter == m_seccomp_filters.end() || !filter->second.count( number ) ) {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+
+// A seccomp stop or a PTRACE_SYSCALL entry stop, true when a catchpoint takes it
+bool MiniDbg::Debugger::handle_syscall_stop( ThreadState& thread, bool seccomp ) {
+
+    __ptrace_syscall_info info;
+
+    if ( ::ptrace( PTRACE_GET_SYSCALL_INFO, thread.tid, sizeof( info ), &info ) <= 0 ) {
+        return false;
+    }
+
+    std::uint64_t number;
+    const std::uint64_t* args;
+
+    if ( seccomp && info.op == PTRACE_SYSCALL_INFO_SECCOMP ) {
+
+        number = info.seccomp.nr;
+        args = info.seccomp.args;
+    }
+    else if ( !seccomp && info.op == PTRACE_SYSCALL_INFO_ENTRY ) {
+
+        number = info.entry.nr;
+        args = info.entry.args;
+
+        // the filter traps it too, the seccomp stop right after this one reports it
+        auto filter = m_seccomp_filters.find( thread.pid );
+
+        if ( filter != m_seccomp_filters.end() && filter->second.count( number ) ) {
+            return false;
+        }
+    }
+    else {
+
+        return false;   // a syscall exit
+    }
+
+    for ( SyscallCatchpoint& catchpoint : m_catchpoints ) {
+
+        if ( !catchpoint.syscalls.count( number ) ) {
+            continue;
+        }
+
+        bool holds = std::all_of( catchpoint.conditions.begin(), catchpoint.conditions.end(),
+                                  [ &thread, args ]( const SyscallCondition& c ) { return syscall_condition_holds( thread.pid, c, args ); } );
+
+        if ( holds ) {
+
+            ++catchpoint.hits;
+            thread.catchpoint = catchpoint.number;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+void MiniDbg::Debugger::print_syscall_stop( const ThreadState& thread ) {
+
+    __ptrace_syscall_info info;
+
+    if ( ::ptrace( PTRACE_GET_SYSCALL_INFO, thread.tid, sizeof( info ), &info ) <= 0 ) {
+        return;
+    }
+
+    bool seccomp = info.op == PTRACE_SYSCALL_INFO_SECCOMP;
+    const std::uint64_t* args = seccomp ? info.seccomp.args : info.entry.args;
+
+    std::cout << "[" << "Catchpoint " << std::dec << thread.catchpoint << " (call to syscall " << syscall_name( seccomp ? info.seccomp.nr : info.entry.nr )
+              << ") at 0x" << std::hex << info.instruction_pointer << "]" << std::endl;
+
+    std::cout << "  args:";
+
+    for ( int i = 0; i < 6; ++i ) {
+
+        std::cout << " 0x" << std::hex << args[i];
+    }
+
+    std::cout << std::endl;
+}
+
+
+// A filtered process cannot be let go: without a tracer every syscall its filter traps fails with ENOSYS.
+// Its threads leave m_threads but stay seized, and handle_passthrough_event resumes them until it exits.
+void MiniDbg::Debugger::pass_through_process( pid_t pid ) {
+
+    for ( auto it = m_threads.begin(); it != m_threads.end(); ) {
+
+        if ( it->second.pid != pid ) {
+
+            ++it;
+            continue;
+        }
+
+        // a thread still running has not reported its initial stop, that stop is resumed on arrival
+        if ( it->second.status == ThreadStatus::stopped ) {
+
+            ::ptrace( PTRACE_CONT, it->first, nullptr, static_cast<long>( it->second.pending_signal ) );
+        }
+
+        it = m_threads.erase( it );
+    }
+
+    m_passthrough.insert( pid );
+}
+
+
+// True when the event belongs to a pass-through process and was dealt with
+bool MiniDbg::Debugger::handle_passthrough_event( pid_t tid, int status ) {
+
+    if ( m_passthrough.empty() || m_threads.count( tid ) ) {
+        return false;
+    }
+
+    if ( WIFEXITED( status ) || WIFSIGNALED( status ) ) {
+
+        if ( m_passthrough.erase( tid ) ) {
+
+            std::cout << "[" << "Process " << std::dec << tid << " exited, its seccomp filter no longer needs the tracer" << "]" << std::endl;
+            return true;
+        }
+
+        return false;   // a thread, unknown to everyone else too
+    }
+
+    if ( !m_passthrough.count( read_tgid( tid ) ) ) {
+        return false;
+    }
+
+    int event = status >> 16;
+    long signal = 0;
+
+    if ( event == PTRACE_EVENT_FORK || event == PTRACE_EVENT_VFORK ) {
+
+        unsigned long child_pid;
+        ::ptrace( PTRACE_GETEVENTMSG, tid, nullptr, &child_pid );
+
+        m_passthrough.insert( child_pid );     // the filter is inherited, and so is the tracer
+
+        // its initial stop beat this event and was parked as a fork child waiting for a decision
+        if ( m_threads.erase( child_pid ) ) {
+
+            ::ptrace( PTRACE_CONT, child_pid, nullptr, nullptr );
+        }
+    }
+    else if ( event == PTRACE_EVENT_STOP && WSTOPSIG( status ) != SIGTRAP ) {
+
+        ::ptrace( PTRACE_LISTEN, tid, nullptr, nullptr );  // a job control stop, it lasts until SIGCONT
+        return true;
+    }
+    else if ( event == 0 && WSTOPSIG( status ) != ( SIGTRAP | 0x80 ) ) {
+
+        signal = WSTOPSIG( status );
+    }
+
+    // seccomp stops included: resuming lets the trapped syscall run as if nothing caught it
+    ::ptrace( PTRACE_CONT, tid, nullptr, signal );
+
+    return true;
+}
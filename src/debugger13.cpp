@@ -0,0 +1,152 @@
+#include <vector>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sys/signalfd.h>
+#include <unistd.h>
+
+#include "debugger.hpp"
+#include "monitor.hpp"
+
+
+// monitor <expr>... every <ms> [for <seconds>] [pid <PID>] [csv <file>]
+void MiniDbg::Debugger::monitor( const std::vector<std::string>& args ) {
+
+    std::vector<std::string> expressions;
+    std::size_t i = 1;
+
+    for ( ; i < args.size() && args[i] != "every"; ++i ) {
+
+        expressions.push_back( args[i] );
+    }
+
+    double period_ms = 0;
+    unsigned seconds = 0;
+    pid_t pid = 0;
+    std::string csv_path;
+
+    for ( ; i + 1 < args.size(); i += 2 ) {
+
+        if ( args[i] == "every" ) {
+            period_ms = std::stod( args[ i + 1 ] );
+        }
+        else if ( args[i] == "for" ) {
+            seconds = std::stoul( args[ i + 1 ] );
+        }
+        else if ( args[i] == "pid" ) {
+            pid = std::stoi( args[ i + 1 ] );
+        }
+        else if ( args[i] == "csv" ) {
+            csv_path = args[ i + 1 ];
+        }
+        else {
+            break;
+        }
+    }
+
+    if ( expressions.empty() || period_ms <= 0 || i != args.size() ) {
+
+        std::cerr << "[" << "Usage: monitor <global>... every <ms> [for <seconds>] [pid <PID>] [csv <file>]" << "]" << std::endl;
+        return;
+    }
+
+    bool was_traced = m_state == State::RUNNING;
+    std::string prog_name = m_inferior->prog_name;
+
+    if ( was_traced && pid != 0 && pid != m_inferior->pid ) {
+
+        std::cerr << "[" << "Already debugging PID " << std::dec << m_inferior->pid << ", detach first" << "]" << std::endl;
+        return;
+    }
+
+    if ( !was_traced ) {
+
+        if ( pid == 0 ) {
+
+            std::cerr << "[" << "No process to monitor" << "]" << std::endl;
+            return;
+        }
+
+        // nothing is attached: the DWARF of the running binary is all that is needed
+        load_debug_info( get_executable_path_by_pid( pid ) );
+        m_inferior->pid = pid;
+        initialize_load_address();
+    }
+
+    // addresses and types are worked out once, the sampling loop only copies bytes
+    std::vector<ValueRef> refs;
+    std::vector<MonitoredValue> values;
+
+    for ( const std::string& expression : expressions ) {
+
+        ValueRef value;
+
+        if ( !evaluate_expression( expression, value, true ) ) {
+            break;
+        }
+
+        if ( !value.in_memory ) {
+
+            std::cerr << "[" << expression << " is not in memory" << "]" << std::endl;
+            break;
+        }
+
+        values.push_back( MonitoredValue { expression, value.address, value.size() } );
+        refs.push_back( value );
+    }
+
+    if ( values.size() == expressions.size() ) {
+
+        std::ofstream file;
+
+        if ( !csv_path.empty() ) {
+
+            file.open( csv_path );
+
+            if ( !file ) {
+
+                std::cerr << "[" << "Can't write " << csv_path << "]" << std::endl;
+            }
+        }
+
+        if ( csv_path.empty() || file ) {
+
+            Monitor monitor( m_inferior->pid, values, [ this, &refs ]( std::size_t index, const std::uint8_t* data ) {
+
+                return format_contents( refs[ index ], data );
+            } );
+
+            std::cout << "Monitoring " << values.size() << " values of PID " << std::dec << m_inferior->pid << " every " << period_ms << " ms"
+                      << ( seconds ? "" : ", Ctrl+C to stop" ) << std::endl;
+
+            monitor.Run( period_ms, seconds, m_signal_fd, csv_path.empty() ? std::cout : file, !csv_path.empty() );
+            monitor.print_summary( std::cout );
+
+            if ( !csv_path.empty() ) {
+
+                std::cout << "Samples written to " << csv_path << std::endl;
+            }
+        }
+    }
+
+    // Ctrl+C ends the monitor and is not passed on; a stop of a traced thread is handled as usual
+    signalfd_siginfo infos[16];
+    ssize_t bytes = ::read( m_signal_fd, infos, sizeof( infos ) );
+    bool child_event = false;
+
+    for ( ssize_t k = 0; k < bytes / static_cast<ssize_t>( sizeof( signalfd_siginfo ) ); ++k ) {
+
+        child_event = child_event || infos[k].ssi_signo == SIGCHLD;
+    }
+
+    if ( was_traced ) {
+
+        if ( child_event && drain_wait_events() ) {
+            show_displays();
+        }
+    }
+    else {
+
+        forget_untraced_process( prog_name );
+    }
+}
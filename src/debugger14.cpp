@@ -0,0 +1,200 @@
+#include <vector>
+#include <iostream>
+#include <iomanip>
+#include <cstring>
+
+#include "debugger.hpp"
+#include "address_space.hpp"
+#include "memory_search.hpp"
+
+
+namespace {
+
+    constexpr std::size_t printed_matches = 1000;
+
+
+    bool parse_number( const std::string& text, std::uint64_t& value ) {
+
+        try {
+
+            std::size_t used;
+            value = std::stoull( text, &used, 0 );
+            return used == text.size();
+        }
+        catch ( std::exception& e ) {
+
+            return false;
+        }
+    }
+}
+
+
+// find [/b|/h|/w|/g|/s] <start> <end>|+<length>|heap|stack|all|<path> <pattern>
+void MiniDbg::Debugger::find_memory( const std::vector<std::string>& args ) {
+
+    const char* usage = "Usage: find [/b|/h|/w|/g|/s] <start> <end>|+<length>|heap|stack|all|<path> <pattern>";
+    std::size_t i = 1;
+    char format = 0;
+
+    if ( i < args.size() && args[i].size() == 2 && args[i][0] == '/' ) {
+
+        format = args[ i++ ][1];
+    }
+
+    if ( i + 1 >= args.size() || ( format != 0 && std::string( "bhwgs" ).find( format ) == std::string::npos ) ) {
+
+        std::cerr << "[" << usage << "]" << std::endl;
+        return;
+    }
+
+    if ( m_state != State::RUNNING ) {
+
+        std::cerr << "[" << "The program is not being run" << "]" << std::endl;
+        return;
+    }
+
+    const std::vector<MemoryRegion>& regions = m_inferior->address_space.regions( m_inferior->pid, m_run_generation );
+    std::vector<SearchRange> ranges;
+    std::uint64_t start, end;
+
+    if ( parse_number( args[i], start ) ) {
+
+        const std::string& limit = args[ i + 1 ];
+        bool relative = limit.starts_with( "+" );
+
+        if ( i + 2 >= args.size() || !parse_number( relative ? limit.substr( 1 ) : limit, end ) ) {
+
+            std::cerr << "[" << usage << "]" << std::endl;
+            return;
+        }
+
+        end = relative ? start + end : end;
+        i += 2;
+
+        // only the readable parts, a hole or a guard page would end every read short
+        for ( const MemoryRegion& r : regions ) {
+
+            if ( r.start < end && start < r.end && r.allows( MemoryRegion::read ) ) {
+
+                ranges.push_back( SearchRange { std::max( start, r.start ), std::min( end, r.end ) } );
+            }
+        }
+    }
+    else {
+
+        const std::string& name = args[ i++ ];
+
+        for ( const MemoryRegion& r : regions ) {
+
+            // [vvar] and friends fault on read, device mappings are not memory
+            bool special = r.path.starts_with( "[v" ) || r.path.starts_with( "/dev/" );
+            bool wanted;
+
+            if ( name == "heap" ) {
+
+                // large allocations and the arenas of other threads are anonymous mappings
+                wanted = r.path == "[heap]" || ( r.path.empty() && r.allows( MemoryRegion::write ) && !r.allows( MemoryRegion::shared ) );
+            }
+            else if ( name == "stack" ) {
+
+                wanted = r.path.starts_with( "[stack" );
+            }
+            else {
+
+                wanted = name == "all" || ( !r.path.empty() && r.path.find( name ) != std::string::npos );
+            }
+
+            if ( wanted && !special && r.allows( MemoryRegion::read ) ) {
+
+                ranges.push_back( SearchRange { r.start, r.end } );
+            }
+        }
+    }
+
+    if ( i >= args.size() ) {
+
+        std::cerr << "[" << usage << "]" << std::endl;
+        return;
+    }
+
+    std::string text = args[i];
+
+    for ( ++i; i < args.size(); ++i ) {
+
+        text += " " + args[i];
+    }
+
+    std::uint64_t value;
+    bool numeric = format != 's' && parse_number( text, value );
+
+    if ( format != 0 && format != 's' && !numeric ) {
+
+        std::cerr << "[" << "Bad number " << text << "]" << std::endl;
+        return;
+    }
+
+    std::vector<std::uint8_t> pattern;
+
+    if ( numeric ) {
+
+        // without a size the value decides: a word when it fits, a giant otherwise
+        std::size_t size = format == 'b' ? 1 : format == 'h' ? 2 : format == 'g' ? 8 : format == 'w' ? 4 : value > 0xffffffff ? 8 : 4;
+
+        if ( size < 8 && value >> ( size * 8 ) != 0 ) {
+
+            std::cerr << "[" << "Value 0x" << std::hex << value << " does not fit in " << std::dec << size << " bytes" << "]" << std::endl;
+            return;
+        }
+
+        pattern.resize( size );
+        std::memcpy( pattern.data(), &value, size );
+    }
+    else {
+
+        if ( text.size() >= 2 && text.front() == '"' && text.back() == '"' ) {
+
+            text = text.substr( 1, text.size() - 2 );
+        }
+
+        pattern.assign( text.begin(), text.end() );
+    }
+
+    if ( pattern.empty() || ranges.empty() ) {
+
+        std::cerr << "[" << ( pattern.empty() ? "Empty pattern" : "No readable memory in that range" ) << "]" << std::endl;
+        return;
+    }
+
+    std::size_t region = 0;
+    std::size_t shown = 0;
+
+    SearchStats stats = search_memory( m_inferior->pid, ranges, pattern, [ & ]( std::uint64_t address ) {
+
+        if ( shown++ >= printed_matches ) {
+            return true;    // still counted
+        }
+
+        while ( region + 1 < regions.size() && regions[ region ].end <= address ) {
+
+            ++region;
+        }
+
+        std::cout << "0x" << std::hex << std::setw( 16 ) << std::setfill( '0' ) << address << std::setfill( ' ' );
+
+        if ( region < regions.size() && regions[ region ].start <= address && !regions[ region ].path.empty() ) {
+
+            std::cout << "  " << regions[ region ].path << "+0x" << address - regions[ region ].start;
+        }
+
+        std::cout << std::endl;
+        return true;
+    } );
+
+    if ( stats.matches > printed_matches ) {
+
+        std::cout << "..." << std::endl;
+    }
+
+    std::cout << std::dec << stats.matches << ( stats.matches == 1 ? " pattern" : " patterns" ) << " found in " << ( stats.bytes >> 10 ) << " KiB, "
+              << std::fixed << std::setprecision( 1 ) << stats.seconds * 1000 << " ms (" << scan_kernel_name() << ")" << std::defaultfloat << std::endl;
+}
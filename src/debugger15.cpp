@@ -0,0 +1,117 @@
+#include <vector>
+#include <iostream>
+#include <iomanip>
+
+#include "debugger.hpp"
+#include "snapshot.hpp"
+
+
+namespace {
+
+    constexpr std::size_t printed_changes = 200;
+    constexpr std::size_t printed_bytes = 16;
+
+
+    void print_bytes( const std::vector<std::uint8_t>& bytes ) {
+
+        for ( std::size_t i = 0; i < bytes.size() && i < printed_bytes; ++i ) {
+
+            std::cout << ( i ? " " : "" ) << std::hex << std::setw( 2 ) << std::setfill( '0' ) << unsigned( bytes[i] );
+        }
+
+        std::cout << std::setfill( ' ' ) << ( bytes.size() > printed_bytes ? " ..." : "" );
+    }
+}
+
+
+// snapshot mark|diff
+void MiniDbg::Debugger::snapshot( const std::vector<std::string>& args ) {
+
+    if ( args.size() != 2 || ( args[1] != "mark" && args[1] != "diff" ) ) {
+
+        std::cerr << "[" << "Usage: snapshot mark|diff" << "]" << std::endl;
+        return;
+    }
+
+    if ( !check_thread_stopped() ) {
+        return;
+    }
+
+    std::string error;
+
+    if ( args[1] == "mark" ) {
+
+        if ( !m_inferior->snapshot.mark( m_inferior->pid, m_inferior->address_space.regions( m_inferior->pid, m_run_generation ), error ) ) {
+
+            std::cerr << "[" << error << "]" << std::endl;
+            return;
+        }
+
+        std::cout << "[" << "Saved " << std::dec << ( m_inferior->snapshot.bytes() >> 10 ) << " KiB of writable memory"
+                  << ( m_inferior->snapshot.soft_dirty() ? "" : ", no soft-dirty bits on this kernel: diff compares every page" ) << "]" << std::endl;
+        return;
+    }
+
+    if ( !m_inferior->snapshot.valid() ) {
+
+        std::cerr << "[" << "No snapshot, use snapshot mark first" << "]" << std::endl;
+        return;
+    }
+
+    SnapshotDiff diff;
+
+    if ( !m_inferior->snapshot.diff( m_inferior->pid, diff, error ) ) {
+
+        std::cerr << "[" << error << "]" << std::endl;
+        return;
+    }
+
+    // globals of the program and of every library, by relocated address
+    std::vector<DataSymbol> symbols;
+    add_data_symbols( m_inferior->elf, m_inferior->load_address, symbols );
+
+    for ( const std::shared_ptr<Module>& module : m_inferior->modules.modules() ) {
+
+        if ( module->elf.valid() ) {
+
+            add_data_symbols( module->elf, module->load_address, symbols );
+        }
+    }
+
+    for ( std::size_t i = 0; i < diff.changes.size() && i < printed_changes; ++i ) {
+
+        const MemoryChange& change = diff.changes[i];
+        const DataSymbol* symbol = find_data_symbol( symbols, change.address );
+
+        std::cout << "0x" << std::hex << std::setw( 16 ) << std::setfill( '0' ) << change.address << std::setfill( ' ' )
+                  << std::dec << std::setw( 6 ) << change.before.size() << "  ";
+
+        if ( symbol != nullptr ) {
+
+            std::cout << symbol->name;
+
+            if ( change.address != symbol->address ) {
+
+                std::cout << "+0x" << std::hex << change.address - symbol->address;
+            }
+        }
+        else if ( const MemoryRegion* region = find_region( change.address ) ) {
+
+            std::cout << ( region->path.empty() ? "[anon]" : region->path ) << "+0x" << std::hex << change.address - region->start;
+        }
+
+        std::cout << std::endl << "    ";
+        print_bytes( change.before );
+        std::cout << std::endl << " -> ";
+        print_bytes( change.after );
+        std::cout << std::endl;
+    }
+
+    if ( diff.changes.size() > printed_changes ) {
+
+        std::cout << "..." << std::endl;
+    }
+
+    std::cout << std::dec << diff.changes.size() << " changes in " << diff.dirty_pages << " of " << diff.pages
+              << ( m_inferior->snapshot.soft_dirty() ? " pages written since the mark" : " pages compared" ) << std::endl;
+}
@@ -0,0 +1,273 @@
+#include <vector>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <sys/ptrace.h>
+
+#include "debugger.hpp"
+#include "heap_tracker.hpp"
+
+
+namespace {
+
+    constexpr std::size_t reported_sites = 20;
+
+    const std::pair<const char*, MiniDbg::HeapFunction> heap_functions[] = {
+
+        { "malloc", MiniDbg::HeapFunction::malloc },
+        { "calloc", MiniDbg::HeapFunction::calloc },
+        { "realloc", MiniDbg::HeapFunction::realloc },
+        { "free", MiniDbg::HeapFunction::free },
+    };
+
+
+    // The entry point itself, argument registers and the return address are only where
+    // the ABI puts them before the prologue
+    uint64_t function_entry( const elf::elf& elf, const std::string& name, bool dynamic_only ) {
+
+        for ( const elf::section& sec : elf.sections() ) {
+
+            if ( sec.get_hdr().type != elf::sht::dynsym && ( dynamic_only || sec.get_hdr().type != elf::sht::symtab ) ) {
+                continue;
+            }
+
+            for ( const elf::sym& sym : sec.as_symtab() ) {
+
+                const elf::Sym<>& d = sym.get_data();
+
+                if ( d.type() == elf::stt::func && d.value != 0 && sym.get_name() == name ) {
+                    return d.value;
+                }
+            }
+        }
+
+        return 0;
+    }
+}
+
+
+// heaptrack on|off|report
+void MiniDbg::Debugger::heaptrack( const std::vector<std::string>& args ) {
+
+    if ( args.size() != 2 || ( args[1] != "on" && args[1] != "off" && args[1] != "report" ) ) {
+
+        std::cerr << "[" << "Usage: heaptrack on|off|report" << "]" << std::endl;
+        return;
+    }
+
+    if ( args[1] == "report" ) {
+
+        if ( m_heap_pid == 0 ) {
+
+            std::cerr << "[" << "Heap tracking is off" << "]" << std::endl;
+            return;
+        }
+
+        print_heap_report( "Live heap" );
+        return;
+    }
+
+    if ( !check_thread_stopped() ) {
+        return;
+    }
+
+    if ( args[1] == "off" ) {
+
+        if ( m_heap_pid == m_inferior->pid ) {
+
+            print_heap_report( "Live heap" );
+            stop_heap_tracking( true );
+        }
+
+        return;
+    }
+
+    if ( m_heap_pid != 0 ) {
+
+        std::cerr << "[" << "Heap tracking is already on for process " << std::dec << m_heap_pid << "]" << std::endl;
+        return;
+    }
+
+    m_heap_pid = m_inferior->pid;
+
+    // a static program has its own allocator, otherwise it comes from a library, usually libc
+    if ( m_inferior->modules.hook() == 0 ) {
+
+        arm_heap_breakpoints( m_inferior->elf, m_inferior->load_address, false );
+    }
+
+    for ( const std::shared_ptr<Module>& module : m_inferior->modules.modules() ) {
+
+        arm_heap_breakpoints( module->elf, module->load_address, true );
+    }
+
+    if ( m_heap_entries.empty() ) {
+
+        std::cout << "[" << "No malloc loaded yet, heap tracking starts when a library providing it loads" << "]" << std::endl;
+        return;
+    }
+
+    std::cout << "[" << "Tracking malloc, calloc, realloc and free in process " << std::dec << m_inferior->pid << "]" << std::endl;
+}
+
+
+void MiniDbg::Debugger::arm_heap_breakpoints( const elf::elf& elf, uint64_t load_address, bool dynamic_only ) {
+
+    if ( !elf.valid() ) {
+        return;
+    }
+
+    for ( const auto& [ name, function ] : heap_functions ) {
+
+        uint64_t entry = function_entry( elf, name, dynamic_only );
+
+        if ( entry == 0 || m_heap_entries.count( load_address + entry ) ) {
+            continue;
+        }
+
+        entry += load_address;
+
+        // a user breakpoint already there stays the user's, the tracker still sees the hits
+        if ( !m_inferior->breakpoints.count( entry ) ) {
+
+            Breakpoint bp( entry );
+            bp.Enable( m_inferior->tid );
+            m_inferior->breakpoints.emplace( entry, bp );
+            m_heap_breakpoints.insert( entry );
+        }
+
+        m_heap_entries.emplace( entry, function );
+    }
+}
+
+
+// disarm is false once the int3s went away with the address space: exit, exec
+void MiniDbg::Debugger::stop_heap_tracking( bool disarm ) {
+
+    for ( uint64_t address : m_heap_breakpoints ) {
+
+        auto it = m_inferior->breakpoints.find( address );
+
+        if ( disarm && it != m_inferior->breakpoints.end() ) {
+
+            it->second.Disable( m_inferior->tid );
+            m_inferior->breakpoints.erase( it );
+        }
+    }
+
+    m_heap_entries.clear();
+    m_heap_returns.clear();
+    m_heap_breakpoints.clear();
+    m_heap_tracker.clear();
+    m_heap_pid = 0;
+}
+
+
+// An allocator entry or the return to its caller: recorded and stepped over without
+// a report, so a program allocating in a loop only pays for the two traps per call
+bool MiniDbg::Debugger::handle_heap_event( pid_t tid ) {
+
+    ThreadState& thread = m_threads.at( tid );
+
+    if ( m_heap_pid == 0 || thread.pid != m_heap_pid || thread.reason != StopReason::breakpoint ) {
+        return false;
+    }
+
+    user_regs_struct regs;
+    ::ptrace( PTRACE_GETREGS, tid, nullptr, &regs );
+
+    auto entry = m_heap_entries.find( regs.rip );
+    bool is_return = m_heap_returns.count( regs.rip ) != 0;
+
+    if ( entry == m_heap_entries.end() && !is_return ) {
+        return false;
+    }
+
+    int previous = m_inferior_number;
+
+    if ( thread.pid != m_inferior->pid ) {
+
+        switch_to_inferior( inferior_number( thread.pid ) );
+    }
+
+    if ( is_return ) {
+
+        m_heap_tracker.leave( tid, regs.rip, regs.rax );
+    }
+    else {
+
+        HeapStack stack = capture_heap_stack( tid, regs );
+
+        // left armed, the same call site returns again on the next allocation
+        if ( m_heap_tracker.enter( tid, entry->second, regs, stack ) && m_heap_returns.insert( stack[0] ).second &&
+             !m_inferior->breakpoints.count( stack[0] ) ) {
+
+            Breakpoint bp( stack[0] );
+            bp.Enable( tid );
+            m_inferior->breakpoints.emplace( stack[0], bp );
+            m_heap_breakpoints.insert( stack[0] );
+        }
+    }
+
+    // a breakpoint the user set on the same address still stops
+    bool user = !m_heap_breakpoints.count( regs.rip );
+
+    if ( !user ) {
+
+        pid_t selected = m_inferior->tid;
+        m_inferior->tid = tid;
+
+        step_over_breakpoint();
+
+        if ( m_threads.count( tid ) && thread.status == ThreadStatus::stopped ) {
+
+            m_perf_counters.Enable();
+            resume_thread( thread, PTRACE_CONT );
+        }
+
+        m_inferior->tid = m_threads.count( selected ) ? selected : m_inferior->pid;
+    }
+
+    switch_to_inferior( previous );
+
+    return !user;
+}
+
+
+std::string MiniDbg::Debugger::describe_return_address( uint64_t pc ) {
+
+    std::ostringstream ss;
+    const FunctionEntry* func = nullptr;
+    uint64_t offset = 0;
+
+    // return addresses point past the call, look the caller up by the call itself
+    if ( Module* module = m_inferior->modules.find( pc ) ) {
+
+        func = module->function_index.find( pc - module->load_address - 1 );
+        offset = func ? pc - module->load_address - func->low : 0;
+    }
+    else {
+
+        func = function_index().find( offset_load_address( pc ) - 1 );
+        offset = func ? offset_load_address( pc ) - func->low : 0;
+    }
+
+    if ( func == nullptr ) {
+
+        ss << "0x" << std::hex << pc;
+    }
+    else {
+
+        ss << func->name << "+0x" << std::hex << offset;
+    }
+
+    return ss.str();
+}
+
+
+void MiniDbg::Debugger::print_heap_report( const std::string& title ) {
+
+    std::cout << "[" << title << " of process " << std::dec << m_heap_pid << "]" << std::endl;
+
+    m_heap_tracker.print_report( std::cout, [ this ]( uint64_t pc ) { return describe_return_address( pc ); }, reported_sites );
+}
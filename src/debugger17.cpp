@@ -0,0 +1,86 @@
+#include <vector>
+#include <set>
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+
+#include "debugger.hpp"
+#include "core_dump.hpp"
+
+
+// gcore [<file>], core.<pid> by default
+void MiniDbg::Debugger::gcore( const std::vector<std::string>& args ) {
+
+    if ( !check_thread_stopped() ) {
+        return;
+    }
+
+    std::string path = args.size() > 1 ? args[1] : "core." + std::to_string( m_inferior->pid );
+    auto start = std::chrono::steady_clock::now();
+
+    // every thread has to hold still for its registers and the memory, in non-stop too;
+    // other inferiors are left alone and only the threads stopped here are resumed after,
+    // including ones a clone reported while stopping
+    std::set<pid_t> held;
+
+    for ( const auto& [ tid, thread ] : m_threads ) {
+
+        if ( thread.pid == m_inferior->pid && thread.status == ThreadStatus::stopped ) {
+            held.insert( tid );
+        }
+    }
+
+    stop_all_threads( m_inferior->pid );
+
+    // the selected thread first, that is the one a debugger opening the core starts in
+    std::vector<CoreThread> threads = { capture_core_thread( m_inferior->tid, current_thread().pending_signal ) };
+
+    for ( const auto& [ tid, thread ] : m_threads ) {
+
+        if ( thread.pid == m_inferior->pid && tid != m_inferior->tid && thread.status == ThreadStatus::stopped ) {
+
+            threads.push_back( capture_core_thread( tid, thread.pending_signal ) );
+        }
+    }
+
+    // our int3s are in the memory, the core shows the original bytes
+    std::vector<Breakpoint*> lifted;
+
+    for ( auto& [ address, bp ] : m_inferior->breakpoints ) {
+
+        if ( bp.is_enabled() ) {
+
+            bp.Disable( m_inferior->tid );
+            lifted.push_back( &bp );
+        }
+    }
+
+    CoreDumpStats stats;
+    std::string error;
+    bool ok = write_core_file( path, m_inferior->pid, m_inferior->address_space.regions( m_inferior->pid, m_run_generation ), threads, stats, error );
+
+    for ( Breakpoint* bp : lifted ) {
+
+        bp->Enable( m_inferior->tid );
+    }
+
+    double paused_ms = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count();
+
+    for ( auto& [ tid, thread ] : m_threads ) {
+
+        if ( thread.pid == m_inferior->pid && thread.status == ThreadStatus::stopped && !held.count( tid ) ) {
+
+            resume_thread( thread, PTRACE_CONT );
+        }
+    }
+
+    if ( !ok ) {
+
+        std::cerr << "[" << error << "]" << std::endl;
+        return;
+    }
+
+    std::cout << "[" << "Saved corefile " << path << ": " << std::dec << threads.size() << " threads, " << stats.segments << " segments, "
+              << ( stats.memory >> 20 ) << " MiB of memory, " << ( stats.written >> 20 ) << " MiB not zero, "
+              << std::fixed << std::setprecision( 1 ) << paused_ms << " ms" << std::defaultfloat << "]" << std::endl;
+}
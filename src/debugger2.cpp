@@ -8,6 +8,7 @@
 #include <iomanip>
 #include <fstream>
 #include <cassert>
+#include <sys/auxv.h>
 
 #include "debugger.hpp"
 #include "registers.hpp"
@@ -19,37 +20,54 @@
 
 uint64_t MiniDbg::Debugger::get_pc() {
 
-    return get_register_value( m_pid, MiniDbg::Register::rip );
+    ThreadState& thread = current_thread();
+
+    if ( !thread.regs_valid ) {
+
+        ::ptrace( PTRACE_GETREGS, thread.tid, nullptr, &thread.regs );
+        thread.regs_valid = true;
+    }
+
+    return thread.regs.rip;
 }
 
 
 void MiniDbg::Debugger::set_pc( uint64_t pc )  {
 
-    set_register_value( m_pid, MiniDbg::Register::rip, pc );
+    set_register_value( m_inferior->tid, MiniDbg::Register::rip, pc );
+    current_thread().regs_valid = false;
 }
 
 
 void MiniDbg::Debugger::initialize_load_address() {
 
-    if ( m_elf.get_hdr().type == elf::et::dyn ) {
-      
-        std::ifstream map( "/proc/" + std::to_string( m_pid ) + "/maps" );
-        std::string addr;
-        std::getline( map, addr, '-' );
-        m_load_address = std::stoul( addr, 0, 16 );
-        std::cout << "Load address is 0x" << std::hex << m_load_address << std::endl;
+    if ( m_inferior->elf.get_hdr().type == elf::et::dyn ) {
+
+        // the kernel tells where it put the entry point, the first mapping may belong to something else
+        uint64_t entry = read_auxv_entry( m_inferior->pid, AT_ENTRY );
+
+        if ( entry != 0 ) {
+
+            m_inferior->load_address = entry - m_inferior->elf.get_hdr().entry;
+        }
+        else if ( !m_inferior->address_space.regions( m_inferior->pid, m_run_generation ).empty() ) {
+
+            m_inferior->load_address = m_inferior->address_space.regions( m_inferior->pid, m_run_generation ).front().start;
+        }
+
+        std::cout << "Load address is 0x" << std::hex << m_inferior->load_address << std::endl;
     }
 }
 
 
 uint64_t MiniDbg::Debugger::offset_load_address( uint64_t addr ) {
 
-   return addr - m_load_address;
+   return addr - m_inferior->load_address;
 }
 
 uint64_t MiniDbg::Debugger::offset_dwarf_address( uint64_t addr ) {
 
-   return addr + m_load_address;
+   return addr + m_inferior->load_address;
 }
 
 
@@ -69,27 +87,29 @@ std::string MiniDbg::Debugger::get_executable_path_by_pid( const int pid ) {
 
 void MiniDbg::Debugger::set_breakpoint_at_address( std::intptr_t addr ) {
 
+    if ( !check_memory( addr, 1, MemoryRegion::execute ) ) {
+        return;
+    }
+
     std::cout << "Setting breakpoint at address 0x" << std::hex << addr << std::endl;
 
-    Breakpoint bp( m_pid, addr );
-    bp.Enable();
+    Breakpoint bp( addr );
+    bp.Enable( m_inferior->tid );
 
-    m_breakpoints.emplace( addr, bp ) ;
+    m_inferior->breakpoints.emplace( addr, bp ) ;
 }
 
 
 void MiniDbg::Debugger::step_over_breakpoint() {
 
-    if ( m_breakpoints.count( get_pc() ) ) {
+    if ( m_inferior->breakpoints.count( get_pc() ) ) {
 
-        MiniDbg::Breakpoint& bp = m_breakpoints.at( get_pc() );
+        MiniDbg::Breakpoint& bp = m_inferior->breakpoints.at( get_pc() );
         
-        if ( bp.is_enabled() ) {
+        // run a relocated copy so the int3 stays armed for the other threads
+        if ( bp.is_enabled() && !displaced_step( bp ) ) {
         
-            bp.Disable();
-            ::ptrace( PTRACE_SINGLESTEP, m_pid, nullptr, nullptr );
-            wait_for_signal();
-            bp.Enable();
+            step_over_in_place( bp );
         }
     }
 }
@@ -104,30 +124,25 @@ void MiniDbg::Debugger::step_over_breakpoint() {
 
 dwarf::die MiniDbg::Debugger::get_function_from_pc( uint64_t pc ) {
 
-    for  ( const dwarf::compilation_unit& cu : m_dwarf.compilation_units() ) {
-    
-        if ( dwarf::die_pc_range( cu.root() ).contains( pc ) ) {
-    
-            for ( const dwarf::die& die : cu.root() ) {
-    
-                if ( die.tag == dwarf::DW_TAG::subprogram ) {
-    
-                    if ( dwarf::die_pc_range( die ).contains( pc ) ) {
+    const FunctionEntry* func = function_index().find( pc );
 
-                        return die;
-                    }
-                }
-            }
-        }
+    if ( func == nullptr || !func->die.valid() ) {
+
+        throw std::out_of_range( "Cannot find function" );
     }
 
-    throw std::out_of_range( "Cannot find function" );
+    return func->die;
 }
 
 
 dwarf::line_table::iterator MiniDbg::Debugger::get_line_entry_from_pc( uint64_t pc ) {
 
-    for ( const dwarf::compilation_unit& cu : m_dwarf.compilation_units() ) {
+    if ( !debug_dwarf().valid() ) {
+
+        throw std::out_of_range( "No debugging symbols" );
+    }
+
+    for ( const dwarf::compilation_unit& cu : m_inferior->dwarf.compilation_units() ) {
 
         if ( dwarf::die_pc_range( cu.root() ).contains( pc ) ) {
         
@@ -189,14 +204,15 @@ void MiniDbg::Debugger::print_source( const std::string& file_name, unsigned lin
 
 void MiniDbg::Debugger::single_step_instruction() {
 
-    ::ptrace( PTRACE_SINGLESTEP, m_pid, nullptr, nullptr );
+    m_perf_counters.Enable();
+    resume_thread( current_thread(), PTRACE_SINGLESTEP );
     wait_for_signal();
 }
 
 
 void MiniDbg::Debugger::single_step_instruction_with_breakpoint_check() {
     
-    if ( m_breakpoints.count( get_pc() ) ) {
+    if ( m_inferior->breakpoints.count( get_pc() ) ) {
     
         step_over_breakpoint();
     }
@@ -209,34 +225,89 @@ void MiniDbg::Debugger::single_step_instruction_with_breakpoint_check() {
 
 void MiniDbg::Debugger::remove_breakpoint( std::intptr_t addr ) {
 
-    if ( m_breakpoints.at( addr ).is_enabled() ) {
+    if ( m_inferior->breakpoints.at( addr ).is_enabled() ) {
         
-        m_breakpoints.at( addr ).Disable();
+        m_inferior->breakpoints.at( addr ).Disable( m_inferior->tid );
     }
 
-    m_breakpoints.erase( addr );
+    m_inferior->breakpoints.erase( addr );
 }
 
 
 void MiniDbg::Debugger::step_out() {
 
-    uint64_t frame_pointer = get_register_value( m_pid, Register::rbp );
-    uint64_t return_address = read_memory( frame_pointer + 8 );
+    std::vector<InlinedFrame> chain = function_index().inline_chain( get_offset_pc() );
+
+    if ( chain.size() > 1 ) {
+
+        finish_inlined_frame( chain.front() );
+        return;
+    }
+
+    uint64_t return_address;
+
+    if ( !get_return_address( return_address ) ) {
+        return;
+    }
+
+    run_until( return_address );
+}
+
+
+void MiniDbg::Debugger::run_until( uint64_t address ) {
 
     bool should_remove_breakpoint = false;
 
-    if ( !m_breakpoints.count( return_address ) ) {
+    if ( !m_inferior->breakpoints.count( address ) ) {
         
-        set_breakpoint_at_address( return_address );
+        set_breakpoint_at_address( address );
         should_remove_breakpoint = true;
     }
 
     continue_execution();
 
-    if ( should_remove_breakpoint ) {
+    if ( should_remove_breakpoint && m_state == State::RUNNING ) {
+
+        remove_breakpoint( address );
+    }
+}
+
+
+void MiniDbg::Debugger::finish_inlined_frame( const InlinedFrame& frame ) {
 
-        remove_breakpoint( return_address );
+    // an inlined body has no return to break on: step until pc leaves its ranges,
+    // running over the calls it makes, which show up as a frame with a lower CFA
+    dwarf::rangelist ranges = dwarf::die_pc_range( frame.die );
+    std::vector<UnwoundFrame> start = unwind_stack( 1 );
+
+    if ( start.empty() ) {
+        return;
     }
+
+    while ( ranges.contains( get_offset_pc() ) ) {
+
+        single_step_instruction_with_breakpoint_check();
+
+        if ( m_state != State::RUNNING ) {
+            return;
+        }
+
+        std::vector<UnwoundFrame> frames = unwind_stack( 2 );
+
+        if ( frames.size() > 1 && frames[0].cfa < start[0].cfa ) {
+
+            run_until( frames[1].pc );
+
+            if ( m_state != State::RUNNING ) {
+                return;
+            }
+        }
+    }
+
+    std::cout << "Run till exit from " << frame.name << " [inlined]" << std::endl;
+
+    dwarf::line_table::iterator line_entry = get_line_entry_from_pc( get_offset_pc() );
+    print_source( line_entry->file->path, line_entry->line );
 }
 
 
@@ -248,12 +319,21 @@ uint64_t MiniDbg::Debugger::get_offset_pc() {
 void MiniDbg::Debugger::step_in() {
 
    unsigned int line = get_line_entry_from_pc( get_offset_pc() )->line;
+   std::size_t depth = function_index().inline_chain( get_offset_pc() ).size();
 
    while ( get_line_entry_from_pc( get_offset_pc() )->line == line ) {
       
       single_step_instruction_with_breakpoint_check();
    }
 
+   // stepping into or out of inlined code does not change the physical function, name the one we are in now
+   std::vector<InlinedFrame> chain = function_index().inline_chain( get_offset_pc() );
+
+   if ( !chain.empty() && chain.size() != depth ) {
+
+      std::cout << chain.front().name << ( chain.size() > 1 ? " [inlined]" : "" ) << std::endl;
+   }
+
    dwarf::line_table::iterator line_entry = get_line_entry_from_pc( get_offset_pc() );
 
    print_source( line_entry->file->path, line_entry->line );
@@ -268,6 +348,7 @@ void MiniDbg::Debugger::step_over() {
 
     dwarf::line_table::iterator line = get_line_entry_from_pc( func_entry ) ;
     dwarf::line_table::iterator start_line = get_line_entry_from_pc( get_offset_pc() );
+    std::size_t depth = function_index().inline_chain( get_offset_pc() ).size();
 
     std::vector<std::intptr_t> to_delete;
 
@@ -275,7 +356,10 @@ void MiniDbg::Debugger::step_over() {
 
         uint64_t load_address = offset_dwarf_address( line->address );
 
-        if ( line->address != start_line->address && !m_breakpoints.count( load_address ) ) {
+        // lines of code inlined deeper than where we are belong to a call being stepped over
+        bool nested = function_index().inline_chain( line->address ).size() > depth;
+
+        if ( line->address != start_line->address && !nested && !m_inferior->breakpoints.count( load_address ) ) {
             
             set_breakpoint_at_address( load_address );
             to_delete.push_back( load_address );
@@ -284,10 +368,9 @@ void MiniDbg::Debugger::step_over() {
         ++line;
     }
 
-    uint64_t frame_pointer = get_register_value( m_pid, Register::rbp );
-    uint64_t return_address = read_memory( frame_pointer + 8 );
+    uint64_t return_address;
 
-    if ( !m_breakpoints.count( return_address ) ) {
+    if ( get_return_address( return_address ) && !m_inferior->breakpoints.count( return_address ) ) {
 
         set_breakpoint_at_address( return_address );
         to_delete.push_back( return_address );
@@ -303,44 +386,52 @@ void MiniDbg::Debugger::step_over() {
 
 void MiniDbg::Debugger::set_breakpoint_at_function( const std::string& name ) {
 
-    for ( const dwarf::compilation_unit& cu : m_dwarf.compilation_units() ) {
-        
-        for ( const dwarf::die& die : cu.root() ) {
+    bool found = false;
 
-            if ( die.has( dwarf::DW_AT::name ) && dwarf::at_name( die ) == name ) {
+    for ( uint64_t address : function_breakpoint_addresses( m_inferior->elf, debug_dwarf(), name ) ) {
 
-                dwarf::taddr low_pc = dwarf::at_low_pc( die );
-                dwarf::line_table::iterator entry = get_line_entry_from_pc( low_pc );
-                ++entry; //skip prologue
-                set_breakpoint_at_address( offset_dwarf_address( entry->address ) );
-            }
+        set_breakpoint_at_address( offset_dwarf_address( address ) );
+        found = true;
+    }
+
+    for ( const std::shared_ptr<Module>& module : m_inferior->modules.modules() ) {
+
+        if ( has_function_symbol( module->elf, name ) ) {
+
+            found = set_module_breakpoint( *module, name ) || found;
         }
     }
 
-    std::cerr << "[" << "Can't find address of function " << name << "]" << std::endl;
+    if ( !found ) {
+
+        std::cout << "[" << "Can't find function " << name << ", breakpoint pending on a future shared library load" << "]" << std::endl;
+        m_inferior->pending_breakpoints.push_back( name );
+    }
 }
 
 
 void MiniDbg::Debugger::set_breakpoint_at_source_line( const std::string& file, unsigned line ) {
 
-    for ( const dwarf::compilation_unit& cu : m_dwarf.compilation_units() )  {
+    std::vector<uint64_t> addresses = line_breakpoint_addresses( debug_dwarf(), file, line );
 
-        if ( is_suffix( file, dwarf::at_name( cu.root() ) ) ) {
-            
-            const dwarf::line_table& lt = cu.get_line_table();
+    if ( !addresses.empty() ) {
 
-            for ( const dwarf::line_table::entry& entry : lt ) {
-            
-                if ( entry.is_stmt && entry.line == line ) {
-                    
-                    set_breakpoint_at_address( offset_dwarf_address( entry.address ) );
-                    return;
-                }
-            }
+        set_breakpoint_at_address( offset_dwarf_address( addresses.front() ) );
+        return;
+    }
+
+    std::string location = file + ":" + std::to_string( line );
+
+    // a source line needs the line tables, so this one loads every library
+    for ( const std::shared_ptr<Module>& module : m_inferior->modules.modules() ) {
+
+        if ( set_module_breakpoint( *module, location ) ) {
+            return;
         }
     }
 
-    std::cerr << "[" << "Can't find address for file \"" << file << "\" line \"" << line << "\"]" << std::endl;
+    std::cout << "[" << "Can't find address for file \"" << file << "\" line \"" << line << "\", breakpoint pending on a future shared library load" << "]" << std::endl;
+    m_inferior->pending_breakpoints.push_back( location );
 }
 
 
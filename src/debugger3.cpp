@@ -2,6 +2,7 @@
 #include <sys/ptrace.h>
 #include <sys/wait.h>
 #include <sys/personality.h>
+#include <sys/auxv.h>
 #include <unistd.h>
 #include <sstream>
 #include <iostream>
@@ -13,17 +14,18 @@
 #include "dwarf_helpers.hpp"
 #include "linenoise.h"
 #include "helpers.h"
+#include "profiler.hpp"
 
 
 uint64_t MiniDbg::Debugger::read_memory( uint64_t address ) {
 
-    return ::ptrace( PTRACE_PEEKDATA, m_pid, address, nullptr );
+    return ::ptrace( PTRACE_PEEKDATA, m_inferior->tid, address, nullptr );
 }
 
 
 void MiniDbg::Debugger::write_memory( uint64_t address, uint64_t value ) {
 
-    ::ptrace( PTRACE_POKEDATA, m_pid, address, value );
+    ::ptrace( PTRACE_POKEDATA, m_inferior->tid, address, value );
 }
 
 
@@ -31,7 +33,7 @@ void MiniDbg::Debugger::dump_registers() {
  
     for ( const MiniDbg::RegDescriptor& rd : g_register_descriptors ) {
 
-        std::cout << rd.name << " " << std::showbase << std::hex << get_register_value( m_pid, rd.r ) << std::endl;
+        std::cout << rd.name << " " << std::showbase << std::hex << get_register_value( m_inferior->tid, rd.r ) << std::endl;
     }
 }
 
@@ -40,7 +42,7 @@ std::vector<MiniDbg::Symbol> MiniDbg::Debugger::lookup_symbol( const std::string
 
    std::vector<MiniDbg::Symbol> syms;
 
-   for ( const elf::section& sec : m_elf.sections() ) {
+   for ( const elf::section& sec : m_inferior->elf.sections() ) {
 
         if ( sec.get_hdr().type != elf::sht::symtab && sec.get_hdr().type != elf::sht::dynsym ) {
             
@@ -63,68 +65,286 @@ std::vector<MiniDbg::Symbol> MiniDbg::Debugger::lookup_symbol( const std::string
 
 void MiniDbg::Debugger::print_backtrace() {
 
-    auto output_frame = [frame_number = 0] (auto&& func) mutable {
+    int frame_number = 0;
+    bool innermost = true;
 
-        std::cout << "frame #" << frame_number++ << ": " << std::hex << dwarf::at_low_pc( func )
-                  << ' ' << dwarf::at_name( func ) << std::endl;
+    for ( const UnwoundFrame& frame : unwind_stack( max_backtrace_frames ) ) {
+
+        // return addresses point past the call, look the caller up by the call itself
+        uint64_t adjust = innermost ? 0 : 1;
+        uint64_t lookup = offset_load_address( frame.pc ) - adjust;
+        innermost = false;
+
+        if ( Module* module = m_inferior->modules.find( frame.pc ) ) {
+
+            const FunctionEntry* func = module->function_index.find( frame.pc - module->load_address - adjust );
+
+            std::cout << "frame #" << std::dec << frame_number++ << ": " << std::hex << frame.pc
+                      << ' ' << ( func ? func->name : "??" ) << " from " << module->path << std::endl;
+            continue;
+        }
+
+        std::vector<InlinedFrame> chain = function_index().inline_chain( lookup );
+
+        if ( chain.empty() ) {
+
+            const FunctionEntry* func = function_index().find( lookup );
+            const MemoryRegion* region = func ? nullptr : find_region( frame.pc );
+
+            std::cout << "frame #" << std::dec << frame_number++ << ": " << std::hex << frame.pc
+                      << ' ' << ( func ? func->name : "??" );
+
+            // no symbol for it, at least say what the pc points into: [vdso], a JIT buffer, ...
+            if ( region != nullptr ) {
+
+                std::cout << " in " << ( region->path.empty() ? "anonymous memory" : region->path );
+            }
+
+            std::cout << std::endl;
+            continue;
+        }
+
+        // one line per inlined frame, all sharing the pc of the physical frame
+        for ( const InlinedFrame& inlined : chain ) {
+
+            std::cout << "frame #" << std::dec << frame_number++ << ": " << std::hex << frame.pc << ' ' << inlined.name;
+
+            if ( !inlined.call_file.empty() ) {
+
+                std::cout << " [inlined] called from " << inlined.call_file << ':' << std::dec << inlined.call_line;
+            }
+
+            std::cout << std::endl;
+        }
+    }
+}
+
+
+std::vector<MiniDbg::UnwoundFrame> MiniDbg::Debugger::unwind_stack( std::size_t max_frames ) {
+
+    get_pc();   // fills the register cache of the current thread
+
+    // library frames unwind with the CFI of their own module
+    auto resolve = [ this ]( uint64_t pc, uint64_t& load_address ) -> CfiUnwinder* {
+
+        Module* module = m_inferior->modules.find( pc );
+
+        if ( module == nullptr ) {
+            return nullptr;
+        }
+
+        load_address = module->load_address;
+        return &module->unwinder;
     };
 
-    dwarf::die current_func = get_function_from_pc( offset_load_address( get_pc() ) );
-    output_frame( current_func );
+    return m_inferior->unwinder.unwind( m_inferior->tid, current_thread().regs, m_inferior->load_address, max_frames, resolve );
+}
+
+
+bool MiniDbg::Debugger::get_return_address( uint64_t& return_address ) {
 
-    uint64_t frame_pointer = get_register_value( m_pid, Register::rbp ) ;
-    uint64_t return_address = read_memory( frame_pointer + 8 ) ;
+    std::vector<UnwoundFrame> frames = unwind_stack( 2 );
 
-    while ( dwarf::at_name( current_func ) != "main") {
+    if ( frames.size() < 2 ) {
 
-        current_func = get_function_from_pc( offset_load_address( return_address ) );
-        output_frame( current_func );
-        frame_pointer = read_memory( frame_pointer );
-        return_address = read_memory( frame_pointer + 8 );
+        std::cerr << "[" << "Cannot find the caller of this frame" << "]" << std::endl;
+        return false;
     }
+
+    return_address = frames[1].pc;
+    return true;
 }
 
 
 void MiniDbg::Debugger::read_variables() {
 
-    dwarf::die func = get_function_from_pc( get_offset_pc() );
+    uint64_t pc = get_offset_pc();
+    std::vector<InlinedFrame> chain = function_index().inline_chain( pc );
 
-    for ( const dwarf::die& die : func ) {
+    if ( chain.empty() ) {
 
-        if ( die.tag == dwarf::DW_TAG::variable ) {
-            
-            dwarf::value loc_val = die[ dwarf::DW_AT::location ];
+        throw std::out_of_range( "Cannot find function" );
+    }
+
+    // innermost inlined frame first, then the frames it was inlined into
+    for ( const InlinedFrame& frame : chain ) {
 
-            if ( loc_val.get_type() == dwarf::value::type::exprloc ) {   //only supports exprlocs for now
+        if ( chain.size() > 1 ) {
 
-                ptrace_expr_context context( m_pid, m_load_address );
-                dwarf::expr_result result = loc_val.as_exprloc().evaluate( &context );
+            std::cout << "[" << frame.name << ( frame.call_file.empty() ? "" : " [inlined]" ) << "]" << std::endl;
+        }
+
+        read_scope_variables( frame.die, pc );
+    }
+}
 
-                switch ( result.location_type ) {
 
-                    case dwarf::expr_result::type::address:
-                    {
-                        dwarf::taddr offset_addr = result.value;
-                        uint64_t value = read_memory( offset_addr );
-                        std::cout << dwarf::at_name( die ) << " (" << std::hex << offset_addr << ") = " << value << std::endl;
-                        break;
-                    }
+void MiniDbg::Debugger::read_scope_variables( const dwarf::die& scope, uint64_t pc ) {
 
-                    case dwarf::expr_result::type::reg:
-                    {
-                        uint64_t value = get_register_value_from_dwarf_register( m_pid, result.value );
-                        std::cout << dwarf::at_name( die ) << " (reg " << std::hex << result.value << ") = " << value << std::endl;
-                        break;
-                    }
+    for ( const dwarf::die& die : scope ) {
 
-                    default:
-                        throw std::runtime_error( "Unhandled variable location" );
-                }
+        if ( die.tag == dwarf::DW_TAG::lexical_block ) {
+
+            if ( ( die.has( dwarf::DW_AT::low_pc ) || die.has( dwarf::DW_AT::ranges ) ) && dwarf::die_pc_range( die ).contains( pc ) ) {
+
+                read_scope_variables( die, pc );
             }
-            else {
-                
-                throw std::runtime_error( "Unhandled variable location" );
+            continue;
+        }
+
+        if ( die.tag != dwarf::DW_TAG::variable && die.tag != dwarf::DW_TAG::formal_parameter ) {
+            continue;
+        }
+
+        // concrete inlined instances carry their name on the abstract origin
+        std::string name = get_function_name( die );
+
+        // no location at all, or a location list without an entry for pc
+        if ( m_inferior->locations.find( die, dwarf::DW_AT::location, pc ) == nullptr ) {
+
+            std::cout << name << " = <optimized out>" << std::endl;
+            continue;
+        }
+
+        ValueRef value;
+        std::string formatted;
+
+        if ( !locate_variable( die, value ) || !format_variable( value, formatted ) ) {
+            continue;
+        }
+
+        std::cout << name;
+
+        if ( value.in_memory ) {
+
+            std::cout << " (0x" << std::hex << value.address << ")";
+        }
+
+        std::cout << " = " << formatted << std::endl;
+    }
+}
+
+
+void MiniDbg::Debugger::profile( unsigned hz, unsigned seconds, pid_t pid ) {
+
+    bool was_traced = m_state == State::RUNNING;
+    std::vector<std::intptr_t> disabled;
+    std::string prog_name = m_inferior->prog_name;
+
+    if ( was_traced ) {
+
+        if ( pid != 0 && pid != m_inferior->pid ) {
+
+            std::cerr << "[" << "Already debugging PID " << std::dec << m_inferior->pid << ", detach first" << "]" << std::endl;
+            return;
+        }
+
+        // the filter stays while the profiler has the threads, and its trapped syscalls would fail with ENOSYS meanwhile
+        if ( m_seccomp_filters.count( m_inferior->pid ) ) {
+
+            std::cerr << "[" << "Process " << std::dec << m_inferior->pid << " has a seccomp filter, can't hand it to the profiler" << "]" << std::endl;
+            return;
+        }
+
+        // the profiler seizes the threads itself, so step aside for the duration of the run
+        stop_all_threads();
+
+        for ( auto& [ _, breakpoint ] : m_inferior->breakpoints ) {
+
+            if ( breakpoint.is_enabled() ) {
+                breakpoint.Disable( m_inferior->tid );
+                disabled.push_back( breakpoint.get_address() );
             }
         }
+
+        detach_threads();
+        pid = m_inferior->pid;
+    }
+    else if ( pid == 0 ) {
+
+        std::cerr << "[" << "No process to profile" << "]" << std::endl;
+        return;
+    }
+    else {
+
+        m_inferior->prog_name = get_executable_path_by_pid( pid );
+        load_debug_info( m_inferior->prog_name );
+        m_inferior->pid = pid;
+        initialize_load_address();
+
+        // the library list without the loader hook, nothing is traced here
+        uint64_t interp_base = read_auxv_entry( pid, AT_BASE );
+        const MemoryRegion* interp = interp_base != 0 ? find_region( interp_base ) : nullptr;
+
+        if ( interp != nullptr && m_inferior->modules.start( pid, interp_base, interp->path ) ) {
+
+            m_inferior->modules.update( pid );
+        }
     }
-}
\ No newline at end of file
+
+    std::cout << "Profiling PID " << std::dec << pid << " at " << hz << " Hz for " << seconds << " s" << std::endl;
+
+    Profiler profiler( pid, function_index(), m_inferior->unwinder, m_inferior->modules, m_inferior->load_address );
+
+    if ( profiler.Run( hz, seconds ) ) {
+
+        profiler.print_report( std::cout, 20 );
+
+        const std::string folded_path = "minidbg-" + std::to_string( pid ) + ".folded";
+
+        if ( profiler.write_folded_stacks( folded_path ) ) {
+
+            std::cout << "Folded stacks written to " << folded_path << std::endl;
+        }
+    }
+
+    if ( was_traced ) {
+
+        if ( !seize_threads( pid ) ) {
+
+            std::cerr << "[" << "Can't re-attach to PID " << std::dec << pid << "]" << std::endl;
+            detach_threads();
+            clear_debuggee_data();
+            return;
+        }
+
+        m_inferior->tid = pid;
+
+        for ( std::intptr_t addr : disabled ) {
+
+            m_inferior->breakpoints.at( addr ).Enable( m_inferior->tid );
+        }
+    }
+    else {
+
+        forget_untraced_process( prog_name );
+    }
+}
+
+
+void MiniDbg::Debugger::set_stat_mode( bool enabled ) {
+
+    m_stat_enabled = enabled;
+
+    if ( !enabled ) {
+
+        m_perf_counters.Close();
+        return;
+    }
+
+    if ( m_state == State::RUNNING && !m_perf_counters.is_open() && !m_perf_counters.Open( m_inferior->pid ) ) {
+
+        std::cerr << "[" << "Can't open perf counters: " << std::strerror( errno ) << "]" << std::endl;
+    }
+}
+
+
+void MiniDbg::Debugger::print_stat() {
+
+    if ( !m_stat_enabled || !m_perf_counters.is_open() ) {
+        return;
+    }
+
+    std::cout << "Counters since last stop:" << std::endl;
+    m_perf_counters.print_deltas( std::cout );
+}
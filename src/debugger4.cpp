@@ -0,0 +1,591 @@
+#include <vector>
+#include <sys/ptrace.h>
+#include <sys/wait.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+
+#include "debugger.hpp"
+#include "registers.hpp"
+#include "helpers.h"
+
+
+MiniDbg::ThreadState& MiniDbg::Debugger::add_thread( pid_t tid, pid_t pid ) {
+
+    auto it = m_threads.find( tid );
+
+    if ( it != m_threads.end() ) {
+
+        return it->second;
+    }
+
+    ThreadState thread;
+    thread.tid = tid;
+    thread.pid = pid;
+    thread.number = m_next_thread_number++;
+
+    return m_threads.emplace( tid, thread ).first->second;
+}
+
+
+MiniDbg::ThreadState& MiniDbg::Debugger::current_thread() {
+
+    return m_threads.at( m_inferior->tid );
+}
+
+
+bool MiniDbg::Debugger::check_thread_stopped() {
+
+    if ( !m_threads.count( m_inferior->tid ) ) {
+
+        std::cerr << "[" << "No thread selected" << "]" << std::endl;
+        return false;
+    }
+
+    if ( current_thread().status != ThreadStatus::stopped ) {
+
+        std::cerr << "[" << "Thread " << std::dec << current_thread().number << " is running" << "]" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+
+bool MiniDbg::Debugger::seize_threads( pid_t pid ) {
+
+    std::set<pid_t> seized;
+
+    for ( const auto& [ tid, _ ] : m_threads ) {
+        seized.insert( tid );
+    }
+
+    // clones of a seized thread are attached with PTRACE_O_TRACECLONE and reported while stopping them
+    for ( pid_t tid : seize_all_threads( pid, ptrace_options, seized, false ) ) {
+
+        ThreadState& thread = add_thread( tid, pid );
+        thread.status = ThreadStatus::running;
+    }
+
+    stop_all_threads();
+
+    return m_threads.count( pid ) != 0;
+}
+
+
+void MiniDbg::Debugger::detach_threads() {
+
+    for ( auto it = m_threads.begin(); it != m_threads.end(); ) {
+
+        if ( it->second.pid != m_inferior->pid ) {
+
+            ++it;
+            continue;
+        }
+
+        ::ptrace( PTRACE_DETACH, it->first, nullptr, static_cast<long>( it->second.pending_signal ) );
+        it = m_threads.erase( it );
+    }
+}
+
+
+void MiniDbg::Debugger::resume_thread( ThreadState& thread, __ptrace_request request ) {
+
+    // catchpoints the seccomp filter does not cover need a stop at every syscall
+    __ptrace_request sent = request == PTRACE_CONT && syscall_stops_needed( thread.pid ) ? PTRACE_SYSCALL : request;
+
+    // any other request would end a job control stop somebody else asked for, SIGCONT does that;
+    // LISTEN delivers no signal, a pending one waits for the resume after the SIGCONT
+    if ( !thread.group_stop || ::ptrace( PTRACE_LISTEN, thread.tid, nullptr, nullptr ) < 0 ) {
+
+        thread.group_stop = false;
+        ::ptrace( sent, thread.tid, nullptr, static_cast<long>( thread.pending_signal ) );
+        thread.pending_signal = 0;
+    }
+
+    thread.status = ThreadStatus::running;
+    thread.reason = StopReason::none;
+    thread.catchpoint = 0;
+    thread.regs_valid = false;
+    thread.last_request = request;
+
+    ++m_run_generation;
+}
+
+
+void MiniDbg::Debugger::resume_all_threads() {
+
+    for ( auto& [ _, thread ] : m_threads ) {
+
+        if ( thread.status == ThreadStatus::stopped ) {
+
+            resume_thread( thread, PTRACE_CONT );
+        }
+    }
+}
+
+
+void MiniDbg::Debugger::interrupt_thread( ThreadState& thread ) {
+
+    ::ptrace( PTRACE_INTERRUPT, thread.tid, nullptr, nullptr );
+
+    while ( true ) {
+
+        int status;
+
+        if ( ::waitpid( thread.tid, &status, __WALL ) < 0 || WIFEXITED( status ) || WIFSIGNALED( status ) ) {
+
+            thread.status = ThreadStatus::stopped;
+            thread.reason = StopReason::none;
+            thread.tid = 0;     // gone, the caller drops it
+            return;
+        }
+
+        int event = status >> 16;
+        long deliver = 0;
+
+        if ( event == PTRACE_EVENT_STOP ) {
+
+            thread.status = ThreadStatus::stopped;
+            thread.reason = StopReason::interrupted;
+            thread.group_stop = WSTOPSIG( status ) != SIGTRAP;     // interrupted inside a job control stop
+            thread.interrupt_pending = false;
+            return;
+        }
+
+        if ( event == PTRACE_EVENT_SECCOMP || ( event == 0 && WSTOPSIG( status ) == ( SIGTRAP | 0x80 ) ) ) {
+
+            // a syscall raced with the interrupt, a catchpoint on it is reported instead of the interrupt
+            if ( handle_syscall_stop( thread, event == PTRACE_EVENT_SECCOMP ) ) {
+
+                thread.status = ThreadStatus::stopped;
+                thread.reason = StopReason::syscall;
+                thread.interrupt_pending = true;
+                report_thread_stop( thread );
+                print_syscall_stop( thread );
+                return;
+            }
+
+            ::ptrace( PTRACE_CONT, thread.tid, nullptr, nullptr );
+            continue;
+        }
+
+        if ( event == PTRACE_EVENT_CLONE ) {
+
+            unsigned long new_tid;
+            ::ptrace( PTRACE_GETEVENTMSG, thread.tid, nullptr, &new_tid );
+
+            ThreadState& child = add_thread( new_tid, thread.pid );
+            child.status = ThreadStatus::running;
+            child.reason = StopReason::starting;
+        }
+        else if ( event == PTRACE_EVENT_FORK || event == PTRACE_EVENT_VFORK ) {
+
+            handle_fork_event( thread, event == PTRACE_EVENT_VFORK );
+        }
+        else if ( event == PTRACE_EVENT_VFORK_DONE ) {
+
+            handle_vfork_done( thread );
+        }
+        else if ( event == PTRACE_EVENT_EXEC ) {
+
+            handle_exec_event( thread );
+        }
+        else if ( event == 0 ) {
+
+            // an event raced with the interrupt, keep it for later instead of reporting it now
+            siginfo_t info = get_signal_info( thread.tid );
+
+            if ( info.si_signo == SIGTRAP ) {
+
+                if ( info.si_code == SI_KERNEL || info.si_code == TRAP_BRKPT ) {
+
+                    uint64_t pc = get_register_value( thread.tid, Register::rip ) - 1;
+
+                    if ( is_breakpoint( thread.pid, pc ) ) {
+
+                        set_register_value( thread.tid, Register::rip, pc );  // hit it again on resume
+                    }
+                }
+            }
+            else {
+
+                const SignalAction& action = m_signals.get( info.si_signo );
+
+                if ( action.stop ) {
+
+                    // reported when it comes back after the resume: a fault repeats by itself, anything else is sent again
+                    if ( !is_fault_signal( info ) ) {
+
+                        ::syscall( SYS_tgkill, thread.pid, thread.tid, info.si_signo );
+                    }
+                }
+                else {
+
+                    if ( action.print ) {
+
+                        std::cout << "[" << "Thread " << std::dec << thread.number << " (" << thread.tid << ") received signal " << signal_name( info.si_signo ) << "]" << std::endl;
+                    }
+
+                    // injected here, at its own stop: the resume after the interrupt stop would drop it
+                    if ( action.pass ) {
+
+                        deliver = info.si_signo;
+                    }
+                }
+            }
+        }
+
+        ::ptrace( PTRACE_CONT, thread.tid, nullptr, deliver );   // the interrupt trap is still pending
+    }
+}
+
+
+void MiniDbg::Debugger::stop_all_threads( pid_t pid ) {
+
+    auto selected = [ pid ]( const ThreadState& thread ) {
+
+        return thread.status == ThreadStatus::running && ( pid == 0 || thread.pid == pid );
+    };
+
+    for ( auto& [ tid, thread ] : m_threads ) {
+
+        if ( selected( thread ) ) {
+
+            ::ptrace( PTRACE_INTERRUPT, tid, nullptr, nullptr );
+        }
+    }
+
+    while ( true ) {
+
+        auto it = std::find_if( m_threads.begin(), m_threads.end(), 
+                                [ &selected ]( const auto& entry ) { return selected( entry.second ); } );
+
+        if ( it == m_threads.end() ) {
+            break;
+        }
+
+        interrupt_thread( it->second );
+
+        if ( it->second.tid == 0 ) {
+
+            m_threads.erase( it );
+        }
+    }
+}
+
+
+bool MiniDbg::Debugger::handle_thread_event( pid_t tid, int status ) {
+
+    if ( WIFEXITED( status ) || WIFSIGNALED( status ) ) {
+
+        if ( tid == m_inferior->pid ) {
+
+            process_status( status );
+            select_next_inferior();
+            return true;
+        }
+
+        if ( is_inferior( tid ) ) {
+
+            handle_inferior_exit( tid, status );
+            return false;
+        }
+
+        if ( m_threads.count( tid ) ) {
+
+            std::cout << "[" << "Thread " << std::dec << m_threads.at( tid ).number << " (" << tid << ") exited" << "]" << std::endl;
+            m_threads.erase( tid );
+            m_heap_tracker.forget_thread( tid );
+        }
+
+        if ( tid == m_inferior->tid ) {
+
+            m_inferior->tid = m_inferior->pid;
+        }
+
+        return false;
+    }
+
+    bool known = m_threads.count( tid ) != 0;
+    pid_t tgid = known ? m_threads.at( tid ).pid : read_tgid( tid );
+
+    ThreadState& thread = add_thread( tid, tgid );
+    thread.status = ThreadStatus::stopped;
+    thread.regs_valid = false;
+
+    if ( !known ) {
+
+        // the initial stop of a new clone or fork child beat its parent's event
+        thread.reason = StopReason::starting;
+
+        if ( tgid == tid && !is_inferior( tid ) ) {
+            return false;   // a fork child: wait for the parent's event to decide what to do with it
+        }
+    }
+
+    int event = status >> 16;
+
+    switch ( event ) {
+
+        case PTRACE_EVENT_CLONE:
+        {
+            unsigned long new_tid;
+            ::ptrace( PTRACE_GETEVENTMSG, tid, nullptr, &new_tid );
+
+            if ( !m_threads.count( new_tid ) ) {
+
+                ThreadState& child = add_thread( new_tid, thread.pid );
+                child.status = ThreadStatus::running;
+                child.reason = StopReason::starting;
+            }
+
+            std::cout << "[" << "New thread " << std::dec << m_threads.at( new_tid ).number << " (" << new_tid << ")" << "]" << std::endl;
+
+            resume_thread( thread, thread.last_request );
+            return false;
+        }
+
+        case PTRACE_EVENT_FORK:
+        case PTRACE_EVENT_VFORK:
+
+            if ( handle_fork_event( thread, event == PTRACE_EVENT_VFORK ) ) {
+
+                resume_thread( thread, thread.last_request );
+            }
+            return false;
+
+        case PTRACE_EVENT_VFORK_DONE:
+
+            handle_vfork_done( thread );
+            resume_thread( thread, thread.last_request );
+            return false;
+
+        case PTRACE_EVENT_EXEC:
+
+            handle_exec_event( thread );
+            resume_thread( thread, PTRACE_CONT );
+            return false;
+
+        case PTRACE_EVENT_STOP:
+
+            // a job control stop (kill -STOP, SIGTSTP), reported already as its signal: PTRACE_CONT would cancel it
+            if ( WSTOPSIG( status ) != SIGTRAP ) {
+
+                thread.group_stop = true;
+                resume_thread( thread, thread.last_request );
+                return false;
+            }
+
+            // SIGCONT ended it, the signal itself is reported next
+            if ( thread.group_stop ) {
+
+                thread.group_stop = false;
+                resume_thread( thread, thread.last_request );
+                return false;
+            }
+
+            // the trap of an interrupt that lost the race to a catchpoint stop, already reported
+            if ( thread.interrupt_pending ) {
+
+                thread.interrupt_pending = false;
+                resume_thread( thread, thread.last_request );
+                return false;
+            }
+
+            if ( thread.reason == StopReason::starting ) {
+
+                resume_thread( thread, PTRACE_CONT );
+                return false;
+            }
+
+            thread.reason = StopReason::interrupted;
+            return true;
+
+        case PTRACE_EVENT_SECCOMP:
+
+            if ( handle_syscall_stop( thread, true ) ) {
+
+                thread.reason = StopReason::syscall;
+                return true;
+            }
+
+            resume_thread( thread, thread.last_request );
+            return false;
+
+        default:
+            break;
+    }
+
+    if ( WSTOPSIG( status ) == ( SIGTRAP | 0x80 ) ) {
+
+        if ( handle_syscall_stop( thread, false ) ) {
+
+            thread.reason = StopReason::syscall;
+            return true;
+        }
+
+        resume_thread( thread, thread.last_request );
+        return false;
+    }
+
+    siginfo_t info = get_signal_info( tid );
+
+    if ( info.si_signo != SIGTRAP ) {
+
+        const SignalAction& action = m_signals.get( info.si_signo );
+
+        if ( action.pass ) {
+
+            thread.pending_signal = info.si_signo;     // the data argument of the next resume delivers it
+        }
+
+        if ( !action.stop ) {
+
+            if ( action.print ) {
+
+                std::cout << "[" << "Thread " << std::dec << thread.number << " (" << tid << ") received signal " << signal_name( info.si_signo ) << "]" << std::endl;
+            }
+
+            resume_thread( thread, thread.last_request );
+            return false;
+        }
+
+        thread.reason = StopReason::signal;
+        return true;
+    }
+
+    if ( info.si_code == TRAP_TRACE ) {
+
+        thread.reason = StopReason::single_step;
+        return true;
+    }
+
+    thread.reason = StopReason::breakpoint;
+
+    if ( info.si_code == SI_KERNEL || info.si_code == TRAP_BRKPT ) {
+
+        uint64_t pc = get_register_value( tid, Register::rip ) - 1;
+
+        if ( is_breakpoint( thread.pid, pc ) ) {
+
+            set_register_value( tid, Register::rip, pc );   // back onto the int3 we planted
+        }
+    }
+
+    return true;
+}
+
+
+void MiniDbg::Debugger::report_thread_stop( const ThreadState& thread ) {
+
+    std::cout << "[" << "Thread " << std::dec << thread.number << " (" << thread.tid << ") stopped: " 
+              << to_string( thread.reason ) << " at 0x" << std::hex << get_register_value( thread.tid, Register::rip ) 
+              << "]" << std::endl;
+}
+
+
+void MiniDbg::Debugger::print_threads() {
+
+    for ( auto& [ tid, thread ] : m_threads ) {
+
+        std::cout << ( tid == m_inferior->tid ? "* " : "  " ) << std::dec << std::setw( 3 ) << std::left << thread.number 
+                  << " Thread " << std::setw( 8 ) << tid << std::right;
+
+        if ( thread.status == ThreadStatus::running ) {
+
+            std::cout << ( thread.group_stop ? "(job control stop)" : "(running)" ) << std::endl;
+            continue;
+        }
+
+        uint64_t pc = get_register_value( tid, Register::rip );
+        const FunctionEntry* func = m_inferior->function_index.find( offset_load_address( pc ) );
+
+        std::cout << "(" << to_string( thread.reason ) << ") 0x" << std::hex << pc 
+                  << " in " << ( func ? func->name : "??" ) << std::endl;
+    }
+}
+
+
+void MiniDbg::Debugger::select_thread( int number ) {
+
+    auto it = std::find_if( m_threads.begin(), m_threads.end(), 
+                            [ number ]( const auto& entry ) { return entry.second.number == number; } );
+
+    if ( it == m_threads.end() ) {
+
+        std::cerr << "[" << "Unknown thread " << std::dec << number << "]" << std::endl;
+        return;
+    }
+
+    if ( it->second.pid != m_inferior->pid ) {
+
+        switch_to_inferior( inferior_number( it->second.pid ) );
+    }
+
+    m_inferior->tid = it->first;
+
+    std::cout << "[" << "Switching to thread " << std::dec << number << " (" << m_inferior->tid << ")" << "]" << std::endl;
+
+    if ( it->second.status == ThreadStatus::running ) {
+        return;
+    }
+
+    try {
+
+        dwarf::line_table::iterator line_entry = get_line_entry_from_pc( get_offset_pc() );
+        print_source( line_entry->file->path, line_entry->line );
+    }
+    catch ( std::exception& e ) {
+
+        std::cout << "0x" << std::hex << get_pc() << std::endl;
+    }
+}
+
+
+void MiniDbg::Debugger::handle_set_command( const std::vector<std::string>& args ) {
+
+    if ( args.size() < 3 ) {
+
+        std::cerr << "[" << "Usage: set <setting> <value>" << "]" << std::endl;
+        return;
+    }
+
+    if ( args[1] == "non-stop" ) {
+
+        m_non_stop = args[2] == "on";
+
+        if ( !m_non_stop && m_state == State::RUNNING ) {
+
+            stop_all_threads();
+        }
+    }
+    else if ( args[1] == "follow-fork-mode" ) {
+
+        m_follow_fork_child = args[2] == "child";
+    }
+    else if ( args[1] == "detach-on-fork" ) {
+
+        m_detach_on_fork = args[2] == "on";
+    }
+    else if ( args[1] == "debug-file-directory" ) {
+
+        set_debug_file_directories( split( args[2], ':' ) );
+    }
+    else if ( args[1] == "print-elements" ) {
+
+        // 0 or "unlimited" prints every element
+        std::size_t limit = args[2] == "unlimited" ? 0 : std::stoul( args[2] );
+
+        for ( auto& inferior : m_inferiors ) {
+
+            inferior.second.types.set_element_limit( limit );
+        }
+    }
+    else {
+
+        std::cerr << "[" << "Unknown setting " << args[1] << "]" << std::endl;
+    }
+}
@@ -0,0 +1,192 @@
+#include <sys/ptrace.h>
+#include <sys/wait.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <signal.h>
+#include <iostream>
+
+#include "debugger.hpp"
+
+
+bool MiniDbg::Debugger::setup_event_loop() {
+
+    // block in every thread (the tracer inherits the mask) so they are only seen through the signalfd
+    sigset_t mask;
+    ::sigemptyset( &mask );
+    ::sigaddset( &mask, SIGCHLD );
+    ::sigaddset( &mask, SIGINT );
+    ::pthread_sigmask( SIG_BLOCK, &mask, nullptr );
+
+    m_signal_fd = ::signalfd( -1, &mask, SFD_CLOEXEC | SFD_NONBLOCK );
+    m_command_fd = ::eventfd( 0, EFD_CLOEXEC | EFD_NONBLOCK );
+    m_done_fd = ::eventfd( 0, EFD_CLOEXEC );
+    m_inferior_epoll_fd = ::epoll_create1( EPOLL_CLOEXEC );
+    m_epoll_fd = ::epoll_create1( EPOLL_CLOEXEC );
+
+    if ( m_signal_fd < 0 || m_command_fd < 0 || m_done_fd < 0 || m_inferior_epoll_fd < 0 || m_epoll_fd < 0 ) {
+        return false;
+    }
+
+    epoll_event ev {};
+    ev.events = EPOLLIN;
+
+    ev.data.fd = m_signal_fd;
+    ::epoll_ctl( m_inferior_epoll_fd, EPOLL_CTL_ADD, m_signal_fd, &ev );
+
+    ev.data.fd = m_inferior_epoll_fd;
+    ::epoll_ctl( m_epoll_fd, EPOLL_CTL_ADD, m_inferior_epoll_fd, &ev );
+
+    ev.data.fd = m_command_fd;
+    ::epoll_ctl( m_epoll_fd, EPOLL_CTL_ADD, m_command_fd, &ev );
+
+    return true;
+}
+
+
+int MiniDbg::Debugger::watch_inferior_exit( pid_t pid ) {
+
+    int pid_fd = static_cast<int>( ::syscall( SYS_pidfd_open, pid, 0 ) );
+
+    if ( pid_fd < 0 ) {
+        return -1;     // pre 5.3 kernel, SIGCHLD alone still works
+    }
+
+    epoll_event ev {};
+    ev.events = EPOLLIN;
+    ev.data.fd = pid_fd;
+    ::epoll_ctl( m_inferior_epoll_fd, EPOLL_CTL_ADD, pid_fd, &ev );
+
+    return pid_fd;
+}
+
+
+void MiniDbg::Debugger::notify_command_done() {
+
+    uint64_t one = 1;
+    ::write( m_done_fd, &one, sizeof( one ) );
+}
+
+
+void MiniDbg::Debugger::tracer_loop() {
+
+    epoll_event events[8];
+
+    while ( !m_quit ) {
+
+        int n = ::epoll_wait( m_epoll_fd, events, 8, -1 );
+
+        for ( int i = 0; i < n; ++i ) {
+
+            if ( events[i].data.fd == m_inferior_epoll_fd ) {
+
+                // a stop of a background 'cont &'
+                if ( poll_inferior_events( 0 ) ) {
+                    show_displays();
+                }
+                continue;
+            }
+
+            uint64_t count;
+            ::read( m_command_fd, &count, sizeof( count ) );
+
+            std::string line;
+
+            while ( m_commands.pop( line ) ) {
+
+                try {
+
+                    handle_command( line );
+                }
+                catch ( std::exception& e ) {
+
+                    std::cerr << "[" << "Error: " << e.what() << "]" << std::endl;
+                }
+
+                notify_command_done();
+            }
+        }
+    }
+}
+
+
+bool MiniDbg::Debugger::poll_inferior_events( int timeout_ms ) {
+
+    epoll_event events[8];
+    int n = ::epoll_wait( m_inferior_epoll_fd, events, 8, timeout_ms );
+
+    bool reported = false;
+
+    for ( int i = 0; i < n; ++i ) {
+
+        if ( events[i].data.fd == m_signal_fd ) {
+
+            signalfd_siginfo infos[16];
+            ssize_t bytes = ::read( m_signal_fd, infos, sizeof( infos ) );
+
+            for ( ssize_t k = 0; k < bytes / static_cast<ssize_t>( sizeof( signalfd_siginfo ) ); ++k ) {
+
+                if ( infos[k].ssi_signo == SIGINT ) {
+
+                    interrupt_inferior();
+                }
+            }
+        }
+    }
+
+    // SIGCHLD coalesces and a pidfd only says the process is gone, so always drain every pending status
+    if ( n > 0 ) {
+
+        reported = drain_wait_events();
+    }
+
+    return reported;
+}
+
+
+bool MiniDbg::Debugger::drain_wait_events() {
+
+    bool reported = false;
+
+    while ( !m_threads.empty() || !m_passthrough.empty() ) {
+
+        int status;
+        pid_t tid = ::waitpid( -1, &status, WNOHANG | __WALL );
+
+        if ( tid <= 0 ) {
+            break;
+        }
+
+        if ( process_wait_event( tid, status ) ) {
+
+            reported = true;
+
+            if ( !m_non_stop ) {
+                break;      // everything else was stopped and its events were absorbed
+            }
+        }
+    }
+
+    return reported;
+}
+
+
+void MiniDbg::Debugger::wait_for_signal() {
+
+    while ( !m_threads.empty() && !poll_inferior_events( -1 ) ) {
+    }
+}
+
+
+void MiniDbg::Debugger::interrupt_inferior() {
+
+    for ( auto& [ tid, thread ] : m_threads ) {
+
+        if ( thread.status == ThreadStatus::running && ( !m_non_stop || tid == m_inferior->tid ) ) {
+
+            ::ptrace( PTRACE_INTERRUPT, tid, nullptr, nullptr );
+        }
+    }
+}
@@ -0,0 +1,358 @@
+#include <vector>
+#include <sys/ptrace.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+
+#include "debugger.hpp"
+#include "helpers.h"
+
+
+int MiniDbg::Debugger::inferior_number( pid_t pid ) {
+
+    for ( auto& [ number, inferior ] : m_inferiors ) {
+
+        if ( inferior.pid == pid ) {
+            return number;
+        }
+    }
+
+    return 0;
+}
+
+
+bool MiniDbg::Debugger::is_inferior( pid_t pid ) {
+
+    return pid != 0 && inferior_number( pid ) != 0;
+}
+
+
+bool MiniDbg::Debugger::is_breakpoint( pid_t pid, uint64_t addr ) {
+
+    int number = inferior_number( pid );
+
+    return number != 0 && m_inferiors.at( number ).breakpoints.count( addr ) != 0;
+}
+
+
+int MiniDbg::Debugger::add_inferior( pid_t parent_pid, pid_t child_pid ) {
+
+    // the child starts with a copy of the parent's address space, int3s included
+    Inferior inferior = m_inferiors.at( inferior_number( parent_pid ) );
+
+    inferior.pid = child_pid;
+    inferior.tid = child_pid;
+    inferior.pid_fd = watch_inferior_exit( child_pid );
+    inferior.snapshot = MemorySnapshot();   // marked in the parent, the child's pages were never cleared
+
+    int number = m_next_inferior_number++;
+    m_inferiors.emplace( number, std::move( inferior ) );
+
+    return number;
+}
+
+
+void MiniDbg::Debugger::switch_to_inferior( int number ) {
+
+    if ( number == m_inferior_number ) {
+        return;
+    }
+
+    auto it = m_inferiors.find( number );
+
+    if ( it == m_inferiors.end() ) {
+
+        std::cerr << "[" << "Unknown inferior " << std::dec << number << "]" << std::endl;
+        return;
+    }
+
+    // one without a process is only kept while it is the selected one
+    if ( m_inferior->pid == 0 ) {
+
+        m_inferiors.erase( m_inferior_number );
+    }
+
+    m_inferior = &it->second;
+    m_inferior_number = number;
+    m_state = State::RUNNING;
+}
+
+
+void MiniDbg::Debugger::select_next_inferior() {
+
+    if ( m_state == State::RUNNING ) {
+        return;
+    }
+
+    auto next = std::find_if( m_inferiors.begin(), m_inferiors.end(), []( const auto& entry ) { return entry.second.pid != 0; } );
+
+    if ( next == m_inferiors.end() ) {
+        return;
+    }
+
+    switch_to_inferior( next->first );
+
+    std::cout << "[" << "Switching to inferior " << std::dec << m_inferior_number << " (process " << m_inferior->pid << ")" << "]" << std::endl;
+}
+
+
+void MiniDbg::Debugger::print_inferiors() {
+
+    for ( auto& [ number, inferior ] : m_inferiors ) {
+
+        if ( inferior.pid == 0 ) {
+            continue;
+        }
+
+        std::cout << ( number == m_inferior_number ? "* " : "  " ) << std::dec << std::setw( 3 ) << std::left << number
+                  << " process " << std::setw( 8 ) << inferior.pid << std::right << inferior.prog_name << std::endl;
+    }
+}
+
+
+bool MiniDbg::Debugger::handle_fork_event( ThreadState& parent, bool vfork ) {
+
+    unsigned long child_pid;
+    ::ptrace( PTRACE_GETEVENTMSG, parent.tid, nullptr, &child_pid );
+
+    // the child comes up seized and reports an initial stop that may not have been reaped yet
+    if ( !m_threads.count( child_pid ) ) {
+
+        int status;
+
+        if ( ::waitpid( child_pid, &status, __WALL ) < 0 || !WIFSTOPPED( status ) ) {
+            return true;
+        }
+    }
+
+    ThreadState& child = add_thread( child_pid, child_pid );
+    child.status = ThreadStatus::stopped;
+    child.reason = StopReason::starting;
+
+    pid_t parent_pid = parent.pid;
+    auto& breakpoints = m_inferiors.at( inferior_number( parent_pid ) ).breakpoints;
+
+    bool filtered = m_seccomp_filters.count( parent_pid ) != 0;     // inherited by the child
+
+    if ( m_detach_on_fork && !m_follow_fork_child ) {
+
+        // put the original bytes back in the child's copy of memory before letting it go
+        for ( auto& [ _, bp ] : breakpoints ) {
+
+            if ( bp.is_enabled() ) {
+
+                Breakpoint copy = bp;
+                copy.Disable( child_pid );
+            }
+        }
+
+        if ( vfork ) {
+
+            m_vfork_parents.insert( parent_pid );     // memory is shared until vfork-done, so the parent lost them too
+        }
+
+        if ( filtered ) {
+
+            pass_through_process( child_pid );
+
+            std::cout << "[" << "Keeping child process " << std::dec << child_pid << " seized after " << ( vfork ? "vfork" : "fork" ) << ", its seccomp filter needs a tracer" << "]" << std::endl;
+            return true;
+        }
+
+        ::ptrace( PTRACE_DETACH, child_pid, nullptr, nullptr );
+        m_threads.erase( child_pid );
+
+        std::cout << "[" << "Detaching after " << ( vfork ? "vfork" : "fork" ) << " from child process " << std::dec << child_pid << "]" << std::endl;
+        return true;
+    }
+
+    if ( filtered ) {
+
+        std::set<long> syscalls = m_seccomp_filters.at( parent_pid );
+        m_seccomp_filters[ child_pid ] = syscalls;
+    }
+
+    int number = add_inferior( parent_pid, child_pid );
+
+    std::cout << "[" << "New inferior " << std::dec << number << " (process " << child_pid << ")" << "]" << std::endl;
+
+    resume_thread( child, PTRACE_CONT );
+
+    if ( !m_follow_fork_child ) {
+        return true;
+    }
+
+    switch_to_inferior( number );
+
+    // a vfork parent cannot run until the child is done with its memory anyway, so it stays attached
+    if ( m_detach_on_fork && !vfork ) {
+
+        m_pending_detach.push_back( parent_pid );  // keep it stopped, it is detached once the event is handled
+        return false;
+    }
+
+    return true;
+}
+
+
+void MiniDbg::Debugger::handle_vfork_done( ThreadState& thread ) {
+
+    if ( !m_vfork_parents.erase( thread.pid ) ) {
+        return;
+    }
+
+    auto& breakpoints = m_inferiors.at( inferior_number( thread.pid ) ).breakpoints;
+
+    for ( auto& [ _, bp ] : breakpoints ) {
+
+        if ( bp.is_enabled() ) {
+
+            bp.Enable( thread.tid );
+        }
+    }
+}
+
+
+void MiniDbg::Debugger::handle_exec_event( ThreadState& thread ) {
+
+    pid_t pid = thread.pid;
+
+    // exec kills every other thread and reports from the leader, the old tids never report an exit
+    for ( auto it = m_threads.begin(); it != m_threads.end(); ) {
+
+        if ( it->second.pid == pid && it->first != thread.tid ) {
+
+            it = m_threads.erase( it );
+            continue;
+        }
+
+        ++it;
+    }
+
+    int previous = m_inferior_number;
+
+    if ( pid != m_inferior->pid ) {
+
+        switch_to_inferior( inferior_number( pid ) );
+    }
+
+    if ( m_heap_pid == pid ) {
+
+        print_heap_report( "Live heap at exec" );
+        stop_heap_tracking( false );
+    }
+
+    m_inferior->breakpoints.clear();      // the old address space went away together with our int3s
+    m_inferior->address_space.clear();
+    m_inferior->displaced = DisplacedStepping();
+    m_vfork_parents.erase( pid );
+    m_inferior->tid = thread.tid;
+    m_inferior->prog_name = get_executable_path_by_pid( pid );
+
+    load_debug_info( m_inferior->prog_name );
+
+    m_inferior->load_address = 0;
+    initialize_load_address();
+    initialize_modules();
+
+    std::cout << "[" << "process " << std::dec << pid << " is executing new program: " << m_inferior->prog_name << "]" << std::endl;
+
+    switch_to_inferior( previous );
+}
+
+
+void MiniDbg::Debugger::handle_inferior_exit( pid_t pid, int status ) {
+
+    int number = inferior_number( pid );
+    Inferior& inferior = m_inferiors.at( number );
+
+    if ( WIFEXITED( status ) ) {
+
+        std::cout << "[" << "Inferior " << std::dec << number << " (process " << pid << ") exited with code " << WEXITSTATUS( status ) << "]" << std::endl;
+    }
+    else {
+
+        std::cout << "[" << "Inferior " << std::dec << number << " (process " << pid << ") killed by signal " << WTERMSIG( status ) << "]" << std::endl;
+    }
+
+    std::erase_if( m_threads, [ pid ]( const auto& entry ) { return entry.second.pid == pid; } );
+    m_seccomp_filters.erase( pid );
+
+    if ( inferior.pid_fd >= 0 ) {
+
+        ::close( inferior.pid_fd );
+    }
+
+    close_debug_file( inferior.debug_file );
+
+    m_inferiors.erase( number );
+}
+
+
+void MiniDbg::Debugger::detach_pending_inferiors() {
+
+    while ( !m_pending_detach.empty() ) {
+
+        std::vector<pid_t> pending;
+        pending.swap( m_pending_detach );
+
+        for ( pid_t pid : pending ) {
+
+            if ( !is_inferior( pid ) ) {
+                continue;
+            }
+
+            int previous = m_inferior_number;
+            int number = inferior_number( pid );
+
+            switch_to_inferior( number );
+
+            for ( auto& [ tid, thread ] : m_threads ) {
+
+                if ( thread.pid == pid && thread.status == ThreadStatus::running ) {
+
+                    interrupt_thread( thread );
+                }
+            }
+
+            std::erase_if( m_threads, []( const auto& entry ) { return entry.second.tid == 0; } );
+
+            if ( m_threads.count( pid ) ) {
+
+                for ( auto& [ _, bp ] : m_inferior->breakpoints ) {
+
+                    if ( bp.is_enabled() ) {
+
+                        bp.Disable( pid );
+                    }
+                }
+            }
+
+            if ( m_seccomp_filters.count( pid ) ) {
+
+                pass_through_process( pid );
+
+                std::cout << "[" << "Keeping parent process " << std::dec << pid << " seized after fork, its seccomp filter needs a tracer" << "]" << std::endl;
+            }
+            else {
+
+                detach_threads();
+
+                std::cout << "[" << "Detaching after fork from parent process " << std::dec << pid << "]" << std::endl;
+            }
+
+            clear_debuggee_data();
+
+            if ( previous != number ) {
+
+                switch_to_inferior( previous );
+            }
+            else {
+
+                select_next_inferior();
+            }
+        }
+    }
+}
@@ -0,0 +1,358 @@
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <sys/ptrace.h>
+#include <sys/wait.h>
+#include <sys/user.h>
+
+#include "debugger.hpp"
+#include "memory.hpp"
+
+
+namespace {
+
+    constexpr std::uint64_t page_size = 4096;
+    constexpr std::uint32_t pf_x = 1;
+
+    // The part of the last page of an executable segment past its end: mapped with it but
+    // never run. 0 when no segment leaves room for a copy.
+    std::uint64_t segment_slack( const elf::elf& elf, std::uint64_t load_address ) {
+
+        for ( const elf::segment& seg : elf.segments() ) {
+
+            if ( seg.get_hdr().type != elf::pt::load || !( static_cast<std::uint32_t>( seg.get_hdr().flags ) & pf_x ) ) {
+                continue;
+            }
+
+            std::uint64_t end = seg.get_hdr().vaddr + seg.get_hdr().memsz;
+            std::uint64_t page_end = ( end + page_size - 1 ) & ~( page_size - 1 );
+
+            if ( page_end - end >= 16 ) {
+
+                return load_address + ( ( end + 7 ) & ~7ull );     // poked a word at a time
+            }
+        }
+
+        return 0;
+    }
+}
+
+
+uint64_t MiniDbg::Debugger::displaced_scratch_area( uint64_t pc ) {
+
+    Module* module = m_inferior->modules.find( pc );
+
+    if ( module == nullptr ) {
+
+        return m_inferior->elf.get_hdr().entry + m_inferior->load_address;
+    }
+
+    uint64_t scratch = segment_slack( module->elf, module->load_address );
+
+    if ( scratch == 0 && module->elf.get_hdr().entry != 0 ) {
+
+        scratch = module->elf.get_hdr().entry + module->load_address;
+    }
+
+    // the mapping decides, the program headers only say where the slack should be
+    const MemoryRegion* region = scratch != 0 ? find_region( scratch ) : nullptr;
+
+    if ( region == nullptr || !region->allows( MemoryRegion::execute ) || scratch + 16 > region->end ) {
+
+        return m_inferior->elf.get_hdr().entry + m_inferior->load_address;     // fine unless the instruction is rip-relative
+    }
+
+    return scratch;
+}
+
+
+const MiniDbg::DisplacedInstruction& MiniDbg::Debugger::prepare_displaced_instruction( uint64_t pc ) {
+
+    auto it = m_inferior->displaced.cache.find( pc );
+
+    if ( it != m_inferior->displaced.cache.end() ) {
+
+        return it->second;
+    }
+
+    DisplacedInstruction& displaced = m_inferior->displaced.cache[ pc ];
+    std::array<std::uint8_t, 16>& bytes = displaced.bytes;
+    uint64_t scratch = displaced_scratch_area( pc );
+
+    displaced.scratch = scratch;
+
+    std::size_t size = read_process_memory( m_inferior->pid, pc, bytes.data(), bytes.size() );
+
+    // memory holds our int3s, the copy needs what they replaced
+    for ( std::size_t i = 0; i < size; ++i ) {
+
+        auto bp = m_inferior->breakpoints.find( pc + i );
+
+        if ( bp != m_inferior->breakpoints.end() && bp->second.is_enabled() ) {
+
+            bytes[ i ] = bp->second.get_saved_data();
+        }
+    }
+
+    if ( !decode_instruction( bytes.data(), size, displaced.insn ) ) {
+
+        return displaced;
+    }
+
+    if ( displaced.insn.rip_disp_offset >= 0 ) {
+
+        // keep the operand pointing at the same place when run from the scratch area
+        int32_t disp;
+        std::memcpy( &disp, bytes.data() + displaced.insn.rip_disp_offset, sizeof( disp ) );
+
+        int64_t moved = static_cast<int64_t>( disp ) + static_cast<int64_t>( pc - scratch );
+
+        if ( moved < INT32_MIN || moved > INT32_MAX ) {
+
+            return displaced;
+        }
+
+        disp = static_cast<int32_t>( moved );
+        std::memcpy( bytes.data() + displaced.insn.rip_disp_offset, &disp, sizeof( disp ) );
+    }
+
+    displaced.usable = true;
+    return displaced;
+}
+
+
+bool MiniDbg::Debugger::displaced_step( const Breakpoint& bp ) {
+
+    uint64_t pc = bp.get_address();
+    const DisplacedInstruction& displaced = prepare_displaced_instruction( pc );
+    uint64_t scratch = displaced.scratch;
+
+    if ( !displaced.usable || ( pc + 16 > scratch && pc < scratch + 16 ) ) {
+        return false;
+    }
+
+    for ( uint64_t addr = scratch; addr < scratch + 16; ++addr ) {
+
+        if ( m_inferior->breakpoints.count( addr ) ) {
+            return false;   // the copy would overwrite it
+        }
+    }
+
+    ThreadState& thread = current_thread();
+
+    if ( m_inferior->displaced.loaded[ scratch ] != pc ) {
+
+        // text is read-only, process_vm_writev would fail where ptrace pokes through
+        long words[ 2 ];
+        std::memcpy( words, displaced.bytes.data(), sizeof( words ) );
+
+        ::ptrace( PTRACE_POKEDATA, thread.tid, scratch, words[ 0 ] );
+        ::ptrace( PTRACE_POKEDATA, thread.tid, scratch + 8, words[ 1 ] );
+        m_inferior->displaced.loaded[ scratch ] = pc;
+    }
+
+    user_regs_struct regs;
+    ::ptrace( PTRACE_GETREGS, thread.tid, nullptr, &regs );
+    regs.rip = scratch;
+    ::ptrace( PTRACE_SETREGS, thread.tid, nullptr, &regs );
+
+    m_perf_counters.Enable();
+
+    int signal;
+
+    if ( !single_step_thread( thread, signal ) ) {
+        return true;
+    }
+
+    if ( signal != 0 ) {
+
+        // the signal arrived before the instruction ran, deliver it from the original pc
+        if ( m_signals.get( signal ).pass ) {
+            thread.pending_signal = signal;
+        }
+        regs.rip = pc;
+        ::ptrace( PTRACE_SETREGS, thread.tid, nullptr, &regs );
+        thread.regs_valid = false;
+        m_perf_counters.Disable();
+        return true;
+    }
+
+    m_perf_counters.Disable();
+
+    ::ptrace( PTRACE_GETREGS, thread.tid, nullptr, &regs );
+
+    switch ( displaced.insn.flow ) {
+
+        case ControlFlow::relative_call:
+        case ControlFlow::indirect_call:
+        {
+            uint64_t fixed = pc + displaced.insn.length;    // the call pushed the address after the copy
+            write_process_memory( m_inferior->pid, regs.rsp, &fixed, sizeof( fixed ) );
+
+            if ( displaced.insn.flow == ControlFlow::relative_call ) {
+
+                regs.rip += pc - scratch;
+            }
+            break;
+        }
+        case ControlFlow::absolute_jump:
+            break;
+
+        default:
+            regs.rip += pc - scratch;   // fall through or a target relative to the copy
+            break;
+    }
+
+    ::ptrace( PTRACE_SETREGS, thread.tid, nullptr, &regs );
+
+    thread.regs = regs;
+    thread.regs_valid = true;
+    thread.reason = StopReason::single_step;
+
+    return true;
+}
+
+
+// Single steps one thread and waits for it alone, the events of the others stay queued in the kernel.
+// False when it is gone or an exec replaced its program, signal is set when one stopped it before the instruction ran.
+bool MiniDbg::Debugger::single_step_thread( ThreadState& thread, int& signal ) {
+
+    signal = 0;
+    ::ptrace( PTRACE_SINGLESTEP, thread.tid, nullptr, nullptr );
+
+    while ( true ) {
+
+        int status;
+
+        if ( ::waitpid( thread.tid, &status, __WALL ) < 0 ) {
+            return false;
+        }
+
+        if ( WIFEXITED( status ) || WIFSIGNALED( status ) ) {
+
+            process_wait_event( thread.tid, status );
+            return false;
+        }
+
+        int event = status >> 16;
+
+        // a caught syscall under the step is let through, the step is what was asked for
+        if ( event == PTRACE_EVENT_STOP || event == PTRACE_EVENT_SECCOMP ) {
+
+            if ( event == PTRACE_EVENT_STOP ) {
+
+                thread.interrupt_pending = false;
+            }
+
+            ::ptrace( PTRACE_SINGLESTEP, thread.tid, nullptr, nullptr );
+            continue;
+        }
+
+        // the stepped syscall created a thread or a process: handled as in process_wait_event, then the step goes on
+        if ( event == PTRACE_EVENT_CLONE ) {
+
+            unsigned long new_tid;
+            ::ptrace( PTRACE_GETEVENTMSG, thread.tid, nullptr, &new_tid );
+
+            if ( !m_threads.count( new_tid ) ) {
+
+                ThreadState& child = add_thread( new_tid, thread.pid );
+                child.status = ThreadStatus::running;
+                child.reason = StopReason::starting;
+            }
+
+            std::cout << "[" << "New thread " << std::dec << m_threads.at( new_tid ).number << " (" << new_tid << ")" << "]" << std::endl;
+        }
+        else if ( event == PTRACE_EVENT_FORK || event == PTRACE_EVENT_VFORK ) {
+
+            if ( !handle_fork_event( thread, event == PTRACE_EVENT_VFORK ) ) {
+                return true;    // left stopped for the detach after the follow, the syscall is done by then
+            }
+        }
+        else if ( event == PTRACE_EVENT_VFORK_DONE ) {
+
+            handle_vfork_done( thread );
+        }
+        else if ( event == PTRACE_EVENT_EXEC ) {
+
+            handle_exec_event( thread );
+            return false;       // the instruction and its breakpoint went away with the old program
+        }
+
+        if ( event != 0 ) {
+
+            ::ptrace( PTRACE_SINGLESTEP, thread.tid, nullptr, nullptr );
+            continue;
+        }
+
+        if ( WSTOPSIG( status ) != SIGTRAP ) {
+
+            signal = WSTOPSIG( status );
+        }
+
+        return true;
+    }
+}
+
+
+// The int3 is lifted for every thread while it is out, so no other thread may run meanwhile:
+// the running ones are stopped first and resumed after the step.
+void MiniDbg::Debugger::step_over_in_place( Breakpoint& bp ) {
+
+    std::vector<pid_t> running;
+
+    for ( auto& [ tid, thread ] : m_threads ) {
+
+        if ( thread.status == ThreadStatus::running ) {
+
+            running.push_back( tid );
+        }
+    }
+
+    stop_all_threads();
+
+    ThreadState& thread = current_thread();
+    pid_t pid = thread.pid;
+    std::intptr_t address = bp.get_address();
+
+    bp.Disable( thread.tid );
+    m_perf_counters.Enable();
+
+    int signal;
+    bool alive = single_step_thread( thread, signal );
+
+    m_perf_counters.Disable();
+
+    if ( alive ) {
+
+        if ( signal != 0 && m_signals.get( signal ).pass ) {
+
+            thread.pending_signal = signal;
+        }
+
+        thread.regs_valid = false;
+        thread.reason = StopReason::single_step;
+        bp.Enable( thread.tid );
+    }
+    else {
+
+        // the memory is shared by the whole process, any thread left can take the int3 back; after an exec it is gone
+        auto other = std::find_if( m_threads.begin(), m_threads.end(), [ pid ]( const auto& entry ) { return entry.second.pid == pid; } );
+
+        if ( other != m_threads.end() && is_breakpoint( pid, address ) ) {
+
+            bp.Enable( other->first );
+        }
+    }
+
+    for ( pid_t tid : running ) {
+
+        auto it = m_threads.find( tid );
+
+        if ( it != m_threads.end() && it->second.status == ThreadStatus::stopped ) {
+
+            resume_thread( it->second, it->second.last_request );
+        }
+    }
+}
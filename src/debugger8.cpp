@@ -0,0 +1,398 @@
+#include <vector>
+#include <sys/ptrace.h>
+#include <iostream>
+#include <iomanip>
+#include <cctype>
+#include <cstring>
+#include <algorithm>
+
+#include "debugger.hpp"
+#include "memory.hpp"
+
+
+namespace {
+
+    // objects larger than this are not worth a single read to print
+    constexpr std::size_t max_print_size = 1 << 24;
+
+
+    std::string parse_identifier( const std::string& text, std::size_t& pos ) {
+
+        std::size_t begin = pos;
+
+        while ( pos < text.size() && ( std::isalnum( static_cast<unsigned char>( text[ pos ] ) ) || text[ pos ] == '_' ) ) {
+            ++pos;
+        }
+
+        return text.substr( begin, pos - begin );
+    }
+}
+
+
+dwarf::die MiniDbg::Debugger::find_variable( const std::string& name, uint64_t pc ) {
+
+    auto search_scope = [ &name, pc ]( const dwarf::die& scope, auto& self ) -> dwarf::die {
+
+        for ( const dwarf::die& die : scope ) {
+
+            if ( die.tag == dwarf::DW_TAG::lexical_block ) {
+
+                if ( ( die.has( dwarf::DW_AT::low_pc ) || die.has( dwarf::DW_AT::ranges ) ) && dwarf::die_pc_range( die ).contains( pc ) ) {
+
+                    dwarf::die found = self( die, self );
+
+                    if ( found.valid() ) {
+                        return found;
+                    }
+                }
+                continue;
+            }
+
+            if ( ( die.tag == dwarf::DW_TAG::variable || die.tag == dwarf::DW_TAG::formal_parameter ) && get_function_name( die ) == name ) {
+                return die;
+            }
+        }
+
+        return dwarf::die();
+    };
+
+    // innermost scope wins, as in the source
+    for ( const InlinedFrame& frame : function_index().inline_chain( pc ) ) {
+
+        dwarf::die found = search_scope( frame.die, search_scope );
+
+        if ( found.valid() ) {
+            return found;
+        }
+    }
+
+    return find_global_variable( name );
+}
+
+
+dwarf::die MiniDbg::Debugger::find_global_variable( const std::string& name ) {
+
+    if ( !debug_dwarf().valid() ) {
+        return dwarf::die();
+    }
+
+    for ( const dwarf::compilation_unit& cu : m_inferior->dwarf.compilation_units() ) {
+
+        for ( const dwarf::die& die : cu.root() ) {
+
+            if ( die.tag == dwarf::DW_TAG::variable && die.has( dwarf::DW_AT::name ) && dwarf::at_name( die ) == name &&
+                 die.has( dwarf::DW_AT::location ) ) {
+
+                return die;
+            }
+        }
+    }
+
+    return dwarf::die();
+}
+
+
+// globals_only: no thread is stopped, only locations that need no registers work
+bool MiniDbg::Debugger::locate_variable( const dwarf::die& variable, ValueRef& value, bool globals_only ) {
+
+    dwarf::value type = variable.resolve( dwarf::DW_AT::type );
+    value.type = type.valid() ? m_inferior->types.resolve( type.as_reference() ) : m_inferior->types.void_type();
+
+    uint64_t pc = globals_only ? 0 : get_offset_pc();
+    const CompiledLocation* location = m_inferior->locations.find( variable, dwarf::DW_AT::location, pc );
+
+    if ( location == nullptr ) {
+
+        std::cerr << "[" << "<optimized out>" << "]" << std::endl;
+        return false;
+    }
+
+    // the frame base comes from the physical function, inlined or not
+    std::vector<InlinedFrame> chain = globals_only ? std::vector<InlinedFrame>() : function_index().inline_chain( pc );
+    user_regs_struct no_registers {};
+    FrameLocationContext context( globals_only ? m_inferior->pid : m_inferior->tid, globals_only ? no_registers : current_thread().regs, m_inferior->load_address,
+                                  m_inferior->unwinder, m_inferior->locations, chain.empty() ? dwarf::die() : chain.back().die );
+
+    std::vector<LocationPiece> pieces;
+
+    if ( !location->evaluate( context, pieces ) ) {
+
+        std::cerr << "[" << "Cannot evaluate the location of " << get_function_name( variable ) << "]" << std::endl;
+        return false;
+    }
+
+    if ( pieces.size() == 1 && pieces[0].kind == LocationPiece::Kind::memory ) {
+
+        value.address = pieces[0].value;
+        return true;
+    }
+
+    // registers, computed values and pieces are gathered into a buffer of their own
+    value.in_memory = false;
+    value.address = 0;
+    value.contents.clear();
+
+    for ( const LocationPiece& piece : pieces ) {
+
+        std::size_t size = piece.size ? piece.size : value.type->size;
+        std::size_t offset = value.contents.size();
+        value.contents.resize( offset + size );
+
+        std::uint8_t* out = value.contents.data() + offset;
+        uint64_t word = piece.value;
+
+        switch ( piece.kind ) {
+
+            case LocationPiece::Kind::memory:
+
+                if ( read_process_memory( m_inferior->pid, piece.value, out, size ) != size ) {
+
+                    std::cerr << "[" << "Cannot access memory at address 0x" << std::hex << piece.value << "]" << std::endl;
+                    return false;
+                }
+                break;
+
+            case LocationPiece::Kind::reg:
+
+                if ( !context.reg( static_cast<unsigned>( piece.value ), word ) ) {
+
+                    std::cerr << "[" << "Cannot read DWARF register " << std::dec << piece.value << "]" << std::endl;
+                    return false;
+                }
+
+                [[fallthrough]];
+
+            case LocationPiece::Kind::value:
+
+                std::memcpy( out, &word, std::min( size, sizeof( word ) ) );
+                break;
+
+            case LocationPiece::Kind::implicit:
+
+                std::memcpy( out, piece.data.data(), std::min( size, piece.data.size() ) );
+                break;
+
+            case LocationPiece::Kind::optimized_out:
+
+                if ( pieces.size() == 1 ) {
+
+                    std::cerr << "[" << "<optimized out>" << "]" << std::endl;
+                    return false;
+                }
+                break;  // left as zeroes
+        }
+    }
+
+    return true;
+}
+
+
+std::string MiniDbg::Debugger::format_contents( const ValueRef& value, const std::uint8_t* data ) {
+
+    MemoryReader reader = [ this ]( uint64_t address, void* buffer, std::size_t size ) {
+
+        return read_process_memory( m_inferior->pid, address, buffer, size );
+    };
+
+    return value.bitfield ? m_inferior->types.format( *value.bitfield, data, reader ) : m_inferior->types.format( *value.type, data, reader );
+}
+
+
+bool MiniDbg::Debugger::format_variable( const ValueRef& value, std::string& out ) {
+
+    std::size_t size = value.size();
+
+    if ( size == 0 || size > max_print_size ) {
+
+        out = "<cannot print object of " + std::to_string( size ) + " bytes>";
+        return true;
+    }
+
+    // one read for the whole object, the formatter only walks the buffer
+    std::vector<std::uint8_t> data( size );
+
+    if ( !value.in_memory ) {
+
+        if ( value.address + size > value.contents.size() ) {
+
+            out = "<incomplete value>";
+            return true;
+        }
+
+        std::memcpy( data.data(), value.contents.data() + value.address, size );
+    }
+    else if ( read_process_memory( m_inferior->pid, value.address, data.data(), size ) != size ) {
+
+        std::cerr << "[" << "Cannot access memory at address 0x" << std::hex << value.address << "]" << std::endl;
+        return false;
+    }
+
+    out = format_contents( value, data.data() );
+    return true;
+}
+
+
+bool MiniDbg::Debugger::dereference( ValueRef& value ) {
+
+    if ( value.type->kind != TypeKind::pointer || value.bitfield ) {
+
+        std::cerr << "[" << "Attempt to dereference a non-pointer" << "]" << std::endl;
+        return false;
+    }
+
+    uint64_t pointer = 0;
+
+    if ( !value.in_memory ) {
+
+        if ( value.address + sizeof( pointer ) > value.contents.size() ) {
+            return false;
+        }
+
+        std::memcpy( &pointer, value.contents.data() + value.address, sizeof( pointer ) );
+    }
+    else if ( read_process_memory( m_inferior->pid, value.address, &pointer, sizeof( pointer ) ) != sizeof( pointer ) ) {
+
+        std::cerr << "[" << "Cannot access memory at address 0x" << std::hex << value.address << "]" << std::endl;
+        return false;
+    }
+
+    value.type = value.type->target;
+    value.address = pointer;
+    value.in_memory = true;
+    value.contents.clear();
+    return true;
+}
+
+
+bool MiniDbg::Debugger::evaluate_expression( const std::string& expression, ValueRef& value, bool globals_only ) {
+
+    // [*]... identifier followed by .field, ->field and [index] in any order
+    std::size_t pos = 0;
+    unsigned derefs = 0;
+
+    while ( pos < expression.size() && ( expression[ pos ] == '*' || expression[ pos ] == ' ' ) ) {
+        derefs += expression[ pos++ ] == '*';
+    }
+
+    std::string name = parse_identifier( expression, pos );
+
+    if ( name.empty() ) {
+
+        std::cerr << "[" << "Usage: print [*]<variable>[.field|->field|[index]]..." << "]" << std::endl;
+        return false;
+    }
+
+    dwarf::die variable = globals_only ? find_global_variable( name ) : find_variable( name, get_offset_pc() );
+
+    if ( !variable.valid() ) {
+
+        std::cerr << "[" << "No symbol \"" << name << "\" in current context" << "]" << std::endl;
+        return false;
+    }
+
+    if ( !locate_variable( variable, value, globals_only ) ) {
+        return false;
+    }
+
+    while ( pos < expression.size() ) {
+
+        bool arrow = expression.compare( pos, 2, "->" ) == 0;
+
+        if ( expression[ pos ] == '.' || arrow ) {
+
+            pos += arrow ? 2 : 1;
+
+            if ( arrow && !dereference( value ) ) {
+                return false;
+            }
+
+            std::string field_name = parse_identifier( expression, pos );
+            const TypeLayout::Field* field = value.type->kind == TypeKind::structure ? value.type->find_field( field_name ) : nullptr;
+
+            if ( field_name.empty() || field == nullptr ) {
+
+                std::cerr << "[" << "There is no member named " << field_name << " in " << value.type->name << "]" << std::endl;
+                return false;
+            }
+
+            // members of anonymous structs and unions come back as the enclosing field
+            while ( field->name != field_name ) {
+
+                value.address += field->offset;
+                field = field->type->find_field( field_name );
+            }
+
+            value.address += field->offset;
+            value.type = field->type;
+            value.bitfield = field->bit_size ? field : nullptr;
+        }
+        else if ( expression[ pos ] == '[' ) {
+
+            std::size_t close = expression.find( ']', pos );
+
+            if ( close == std::string::npos ) {
+
+                std::cerr << "[" << "Missing ]" << "]" << std::endl;
+                return false;
+            }
+
+            uint64_t index = std::stoull( expression.substr( pos + 1, close - pos - 1 ), nullptr, 0 );
+            pos = close + 1;
+
+            if ( value.type->kind == TypeKind::pointer ) {
+
+                if ( !dereference( value ) ) {
+                    return false;
+                }
+            }
+            else if ( value.type->kind == TypeKind::array ) {
+
+                if ( value.type->count != 0 && index >= value.type->count ) {
+
+                    std::cerr << "[" << "Index " << std::dec << index << " out of bounds of " << value.type->name << "]" << std::endl;
+                    return false;
+                }
+
+                value.type = value.type->target;
+            }
+            else {
+
+                std::cerr << "[" << "Cannot subscript " << value.type->name << "]" << std::endl;
+                return false;
+            }
+
+            value.address += index * value.type->size;
+        }
+        else if ( expression[ pos ] == ' ' ) {
+
+            ++pos;
+        }
+        else {
+
+            std::cerr << "[" << "Unexpected '" << expression[ pos ] << "' in expression" << "]" << std::endl;
+            return false;
+        }
+    }
+
+    // postfix binds tighter, so the stars apply to the result
+    for ( unsigned i = 0; i < derefs; ++i ) {
+
+        if ( !dereference( value ) ) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+void MiniDbg::Debugger::print_expression( const std::string& expression ) {
+
+    ValueRef value;
+    std::string formatted;
+
+    if ( evaluate_expression( expression, value ) && format_variable( value, formatted ) ) {
+
+        std::cout << expression << " = " << formatted << std::endl;
+    }
+}
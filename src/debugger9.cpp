@@ -0,0 +1,188 @@
+#include <vector>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <cstring>
+
+#include "debugger.hpp"
+#include "memory.hpp"
+#include "colormod.h"
+
+
+namespace {
+
+    constexpr std::size_t max_display_size = 1 << 20;
+
+
+    // Formatted values cut into fields and the braces and commas between them, alternately,
+    // so two values of the same shape can be compared member by member and element by element
+    std::vector<std::string> split_fields( const std::string& text ) {
+
+        std::vector<std::string> pieces( 1 );
+        char quote = 0;
+
+        for ( std::size_t i = 0; i < text.size(); ++i ) {
+
+            char c = text[i];
+            bool punct = quote == 0 && ( c == '{' || c == '}' || c == ',' || ( c == ' ' && pieces.size() % 2 == 0 ) );
+
+            // odd indices hold punctuation
+            if ( punct != ( pieces.size() % 2 == 0 ) ) {
+                pieces.emplace_back();
+            }
+
+            pieces.back() += c;
+
+            if ( quote != 0 && c == '\\' && i + 1 < text.size() ) {
+                pieces.back() += text[ ++i ];
+            }
+            else if ( c == '"' || c == '\'' ) {
+                quote = quote == 0 ? c : ( quote == c ? 0 : quote );
+            }
+        }
+
+        return pieces;
+    }
+}
+
+
+void MiniDbg::Debugger::add_display( const std::string& expression ) {
+
+    Display display;
+    display.number = m_next_display_number++;
+    display.expression = expression;
+
+    m_displays.push_back( display );
+
+    show_displays( m_displays.back().number );
+}
+
+
+void MiniDbg::Debugger::remove_display( int number ) {
+
+    if ( number == 0 ) {
+
+        m_displays.clear();
+        return;
+    }
+
+    auto it = std::find_if( m_displays.begin(), m_displays.end(), [ number ]( const Display& d ) { return d.number == number; } );
+
+    if ( it == m_displays.end() ) {
+
+        std::cerr << "[" << "Unknown display " << std::dec << number << "]" << std::endl;
+        return;
+    }
+
+    m_displays.erase( it );
+}
+
+
+void MiniDbg::Debugger::show_displays( int number ) {
+
+    if ( m_displays.empty() || m_state != State::RUNNING || !m_threads.count( m_inferior->tid ) || current_thread().status != ThreadStatus::stopped ) {
+        return;
+    }
+
+    struct Pending {
+
+        ValueRef value;
+        std::vector<std::uint8_t> data;
+        bool valid = false;
+    };
+
+    std::vector<Pending> pending( m_displays.size() );
+    std::vector<MemoryRange> ranges;
+    std::vector<std::size_t> owners;
+
+    // resolve every expression first so the objects themselves come in one batched read
+    for ( std::size_t i = 0; i < m_displays.size(); ++i ) {
+
+        if ( number != 0 && m_displays[i].number != number ) {
+            continue;
+        }
+
+        Pending& p = pending[i];
+
+        if ( !evaluate_expression( m_displays[i].expression, p.value ) ) {
+            continue;
+        }
+
+        std::size_t size = p.value.size();
+
+        if ( size == 0 || size > max_display_size ) {
+            continue;
+        }
+
+        p.data.resize( size );
+
+        if ( p.value.in_memory ) {
+
+            ranges.push_back( MemoryRange { p.value.address, p.data.data(), size } );
+            owners.push_back( i );
+            p.valid = true;
+        }
+        else if ( p.value.address + size <= p.value.contents.size() ) {
+
+            std::memcpy( p.data.data(), p.value.contents.data() + p.value.address, size );
+            p.valid = true;
+        }
+    }
+
+    read_process_memory_ranges( m_inferior->pid, ranges.data(), ranges.size() );
+
+    for ( std::size_t k = 0; k < ranges.size(); ++k ) {
+
+        pending[ owners[k] ].valid = ranges[k].ok;
+    }
+
+    for ( std::size_t i = 0; i < m_displays.size(); ++i ) {
+
+        if ( number != 0 && m_displays[i].number != number ) {
+            continue;
+        }
+
+        Display& display = m_displays[i];
+        Pending& p = pending[i];
+
+        std::cout << std::dec << display.number << ": " << display.expression << " = ";
+
+        if ( !p.valid ) {
+
+            std::cout << "<unavailable>" << std::endl;
+            display.shown = false;
+            continue;
+        }
+
+        std::string formatted = format_contents( p.value, p.data.data() );
+
+        // highlight what changed since the last stop: only the members and elements that did while
+        // the value keeps its shape, all of it when the shape changed too (a container grew or shrank)
+        std::vector<std::string> fields = split_fields( formatted );
+        std::vector<std::string> last_fields = split_fields( display.last );
+        bool same_shape = fields.size() == last_fields.size();
+
+        for ( std::size_t k = 1; same_shape && k < fields.size(); k += 2 ) {
+
+            same_shape = fields[k] == last_fields[k];
+        }
+
+        for ( std::size_t k = 0; k < fields.size(); ++k ) {
+
+            if ( display.shown && ( !same_shape || fields[k] != last_fields[k] ) ) {
+
+                std::cout << Color::Modifier( Color::BOLDBRIGHT ) << Color::Modifier( Color::FG_LIGHT_YELLOW )
+                          << fields[k] << Color::Modifier( Color::RESET );
+            }
+            else {
+
+                std::cout << fields[k];
+            }
+        }
+
+        std::cout << std::endl;
+
+        display.last = std::move( formatted );
+        display.shown = true;
+    }
+}
@@ -0,0 +1,258 @@
+#include "function_index.hpp"
+
+#include <algorithm>
+#include <functional>
+
+
+namespace MiniDbg {
+
+
+std::string get_function_name( const dwarf::die& die ) {
+
+    if ( die.has( dwarf::DW_AT::name ) ) {
+
+        return dwarf::at_name( die );
+    }
+
+    if ( die.has( dwarf::DW_AT::specification ) ) {
+
+        return get_function_name( die[ dwarf::DW_AT::specification ].as_reference() );
+    }
+
+    if ( die.has( dwarf::DW_AT::abstract_origin ) ) {
+
+        return get_function_name( die[ dwarf::DW_AT::abstract_origin ].as_reference() );
+    }
+
+    return "??";
+}
+
+
+void FunctionIndex::clear() {
+
+    m_entries.clear();
+    m_inline_ranges.clear();
+}
+
+
+void FunctionIndex::add_dwarf_functions( const dwarf::die& parent ) {
+
+    for ( const dwarf::die& die : parent ) {
+
+        switch ( die.tag ) {
+
+            case dwarf::DW_TAG::subprogram:
+            {
+                if ( !die.has( dwarf::DW_AT::low_pc ) && !die.has( dwarf::DW_AT::ranges ) ) {
+                    break;
+                }
+
+                std::string name = get_function_name( die );
+
+                for ( const dwarf::rangelist::entry& range : dwarf::die_pc_range( die ) ) {
+
+                    m_entries.push_back( FunctionEntry{ range.low, range.high, name, die } );
+                }
+                break;
+            }
+
+            case dwarf::DW_TAG::namespace_:
+            case dwarf::DW_TAG::structure_type:
+            case dwarf::DW_TAG::class_type:
+
+                add_dwarf_functions( die );
+                break;
+
+            default:
+                break;
+        }
+    }
+}
+
+
+void FunctionIndex::build( const elf::elf& elf, const dwarf::dwarf& dwarf ) {
+
+    clear();
+
+    if ( dwarf.valid() ) {
+
+        for ( const dwarf::compilation_unit& cu : dwarf.compilation_units() ) {
+
+            add_dwarf_functions( cu.root() );
+        }
+    }
+
+    for ( const elf::section& sec : elf.sections() ) {
+
+        if ( sec.get_hdr().type != elf::sht::symtab && sec.get_hdr().type != elf::sht::dynsym ) {
+
+            continue;
+        }
+
+        for ( const elf::sym& sym : sec.as_symtab() ) {
+
+            const elf::Sym<>& d = sym.get_data();
+
+            if ( d.type() == elf::stt::func && d.value != 0 && d.size != 0 ) {
+
+                m_entries.push_back( FunctionEntry{ d.value, d.value + d.size, sym.get_name(), dwarf::die() } );
+            }
+        }
+    }
+
+    // DWARF entries were added first, so after a stable sort they win over symbols at the same address
+    std::stable_sort( m_entries.begin(), m_entries.end(),
+                      []( const FunctionEntry& a, const FunctionEntry& b ) { return a.low < b.low; } );
+
+    m_entries.erase( std::unique( m_entries.begin(), m_entries.end(),
+                                  []( const FunctionEntry& a, const FunctionEntry& b ) { return a.low == b.low; } ),
+                     m_entries.end() );
+}
+
+
+const FunctionEntry* FunctionIndex::find( std::uint64_t pc ) const {
+
+    auto it = std::upper_bound( m_entries.begin(), m_entries.end(), pc,
+                                []( std::uint64_t value, const FunctionEntry& e ) { return value < e.low; } );
+
+    if ( it == m_entries.begin() ) {
+
+        return nullptr;
+    }
+
+    --it;
+
+    return pc < it->high ? &*it : nullptr;
+}
+
+
+const std::vector<FunctionIndex::InlineRange>& FunctionIndex::inline_ranges( const FunctionEntry& func ) {
+
+    auto it = m_inline_ranges.find( func.low );
+
+    if ( it != m_inline_ranges.end() ) {
+
+        return it->second;
+    }
+
+    std::vector<InlineRange> ranges;
+
+    // inlined subroutines can sit inside lexical blocks and inside each other
+    std::function<void( const dwarf::die&, unsigned )> collect = [ & ]( const dwarf::die& parent, unsigned depth ) {
+
+        for ( const dwarf::die& die : parent ) {
+
+            if ( die.tag == dwarf::DW_TAG::inlined_subroutine &&
+                 ( die.has( dwarf::DW_AT::low_pc ) || die.has( dwarf::DW_AT::ranges ) ) ) {
+
+                for ( const dwarf::rangelist::entry& range : dwarf::die_pc_range( die ) ) {
+
+                    ranges.push_back( InlineRange{ range.low, range.high, depth, die, 0 } );
+                }
+
+                collect( die, depth + 1 );
+            }
+            else if ( die.tag == dwarf::DW_TAG::lexical_block ) {
+
+                collect( die, depth );
+            }
+        }
+    };
+
+    if ( func.die.valid() ) {
+
+        collect( func.die, 0 );
+    }
+
+    std::sort( ranges.begin(), ranges.end(), []( const InlineRange& a, const InlineRange& b ) {
+
+        if ( a.low != b.low ) return a.low < b.low;
+        if ( a.high != b.high ) return a.high > b.high;
+        return a.depth < b.depth;
+    } );
+
+    // close every open range that does not enclose the next one
+    std::vector<std::size_t> open;
+
+    for ( std::size_t i = 0; i <= ranges.size(); ++i ) {
+
+        while ( !open.empty() && ( i == ranges.size() || ranges[ i ].high > ranges[ open.back() ].high ||
+                                   ranges[ i ].low >= ranges[ open.back() ].high ) ) {
+
+            ranges[ open.back() ].end = i;
+            open.pop_back();
+        }
+
+        if ( i < ranges.size() ) {
+
+            open.push_back( i );
+        }
+    }
+
+    return m_inline_ranges.emplace( func.low, std::move( ranges ) ).first->second;
+}
+
+
+std::vector<InlinedFrame> FunctionIndex::inline_chain( std::uint64_t pc ) {
+
+    std::vector<InlinedFrame> chain;
+    const FunctionEntry* func = find( pc );
+
+    if ( func == nullptr || !func->die.valid() ) {
+
+        return chain;
+    }
+
+    const std::vector<InlineRange>& ranges = inline_ranges( *func );
+    std::vector<dwarf::die> outer_to_inner;
+
+    // descend through the nesting, skipping sibling subtrees that do not contain pc
+    std::size_t i = 0;
+    std::size_t limit = ranges.size();
+
+    while ( i < limit ) {
+
+        if ( ranges[ i ].low <= pc && pc < ranges[ i ].high ) {
+
+            outer_to_inner.push_back( ranges[ i ].die );
+            limit = ranges[ i ].end;
+            ++i;
+        }
+        else {
+
+            i = ranges[ i ].end;
+        }
+    }
+
+    for ( auto it = outer_to_inner.rbegin(); it != outer_to_inner.rend(); ++it ) {
+
+        InlinedFrame frame;
+        frame.die = *it;
+        frame.name = get_function_name( *it );
+
+        try {
+
+            if ( it->has( dwarf::DW_AT::call_file ) ) {
+
+                const auto& cu = static_cast<const dwarf::compilation_unit&>( it->get_unit() );
+                frame.call_file = cu.get_line_table().get_file( ( *it )[ dwarf::DW_AT::call_file ].as_uconstant() )->path;
+            }
+
+            if ( it->has( dwarf::DW_AT::call_line ) ) {
+
+                frame.call_line = ( *it )[ dwarf::DW_AT::call_line ].as_uconstant();
+            }
+        }
+        catch ( const std::exception& ) {
+            // a bad file index only costs us the call site
+        }
+
+        chain.push_back( std::move( frame ) );
+    }
+
+    chain.push_back( InlinedFrame{ func->die, func->name, "", 0 } );
+
+    return chain;
+}
+
+} // namespace MiniDbg
@@ -0,0 +1,255 @@
+#include "heap_tracker.hpp"
+#include "memory.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+
+
+namespace MiniDbg {
+
+
+namespace {
+
+    constexpr std::size_t stack_window = 8 * 1024;
+}
+
+
+const char* to_string( HeapFunction function ) {
+
+    switch ( function ) {
+
+        case HeapFunction::malloc: return "malloc";
+        case HeapFunction::calloc: return "calloc";
+        case HeapFunction::realloc: return "realloc";
+        case HeapFunction::free: return "free";
+    }
+
+    return "?";
+}
+
+
+HeapStack capture_heap_stack( pid_t tid, const user_regs_struct& regs ) {
+
+    HeapStack stack {};
+    std::uint8_t window[ stack_window ];
+
+    // one read for the whole walk, the frames of a short stack sit close together
+    const std::uint64_t low = regs.rsp;
+    const std::uint64_t high = low + read_process_memory( tid, low, window, sizeof( window ) );
+
+    auto load = [ & ]( std::uint64_t address ) {
+
+        std::uint64_t value;
+        std::memcpy( &value, window + ( address - low ), sizeof( value ) );
+        return value;
+    };
+
+    if ( high < low + 8 ) {
+        return stack;
+    }
+
+    // on the first instruction the return address is on top and rbp is still the caller's
+    stack[0] = load( low );
+
+    std::uint64_t frame_pointer = regs.rbp;
+
+    for ( std::size_t i = 1; i < heap_stack_depth && frame_pointer >= low && frame_pointer + 16 <= high; ++i ) {
+
+        std::uint64_t next_frame_pointer = load( frame_pointer );
+        stack[i] = load( frame_pointer + 8 );
+
+        if ( stack[i] == 0 || next_frame_pointer <= frame_pointer ) {
+            break;
+        }
+
+        frame_pointer = next_frame_pointer;
+    }
+
+    return stack;
+}
+
+
+bool HeapTracker::enter( pid_t tid, HeapFunction function, const user_regs_struct& regs, const HeapStack& stack ) {
+
+    auto pending = m_calls.find( tid );
+
+    if ( pending != m_calls.end() ) {
+
+        if ( regs.rsp <= pending->second.stack_pointer ) {
+            return false;
+        }
+
+        m_calls.erase( pending );   // it never returned: longjmp, or the return breakpoint belongs to the user
+    }
+
+    if ( function == HeapFunction::free ) {
+
+        if ( regs.rdi != 0 ) {
+
+            release( regs.rdi );
+            ++m_frees;
+        }
+
+        return false;
+    }
+
+    Call call;
+    call.function = function;
+    call.size = function == HeapFunction::calloc ? regs.rdi * regs.rsi : function == HeapFunction::realloc ? regs.rsi : regs.rdi;
+    call.pointer = function == HeapFunction::realloc ? regs.rdi : 0;
+    call.stack_pointer = regs.rsp;
+    call.return_address = stack[0];
+    call.site = site_of( stack );
+
+    m_calls[ tid ] = call;
+
+    return call.return_address != 0;
+}
+
+
+bool HeapTracker::leave( pid_t tid, std::uint64_t return_address, std::uint64_t result ) {
+
+    auto pending = m_calls.find( tid );
+
+    if ( pending == m_calls.end() || pending->second.return_address != return_address ) {
+        return false;
+    }
+
+    const Call call = pending->second;
+    m_calls.erase( pending );
+
+    if ( call.function == HeapFunction::realloc && call.pointer != 0 ) {
+
+        // a failed realloc leaves the old block alone, realloc( p, 0 ) may free it and return NULL
+        if ( result == 0 && call.size != 0 ) {
+
+            ++m_failures;
+            return true;
+        }
+
+        release( call.pointer );
+    }
+
+    if ( result == 0 ) {
+
+        m_failures += call.size != 0;
+        return true;
+    }
+
+    allocate( result, call.size, call.site );
+
+    return true;
+}
+
+
+void HeapTracker::clear() {
+
+    *this = HeapTracker();
+}
+
+
+std::uint32_t HeapTracker::site_of( const HeapStack& stack ) {
+
+    auto it = m_site_index.find( stack );
+
+    if ( it != m_site_index.end() ) {
+        return it->second;
+    }
+
+    m_sites.push_back( Site { stack } );
+    return m_site_index.emplace( stack, m_sites.size() - 1 ).first->second;
+}
+
+
+void HeapTracker::allocate( std::uint64_t pointer, std::uint64_t size, std::uint32_t site ) {
+
+    // a block freed behind our back (free inside libc, a missed return) is replaced
+    if ( m_blocks.count( pointer ) ) {
+
+        release( pointer );
+    }
+
+    m_blocks[ pointer ] = Block { size, site };
+
+    Site& s = m_sites[ site ];
+    s.live_bytes += size;
+    ++s.live_blocks;
+    ++s.allocations;
+    s.bytes += size;
+
+    ++m_allocations;
+    m_live_bytes += size;
+    m_peak_bytes = std::max( m_peak_bytes, m_live_bytes );
+}
+
+
+void HeapTracker::release( std::uint64_t pointer ) {
+
+    auto it = m_blocks.find( pointer );
+
+    if ( it == m_blocks.end() ) {
+
+        ++m_unknown_frees;
+        return;
+    }
+
+    Site& s = m_sites[ it->second.site ];
+    s.live_bytes -= it->second.size;
+    --s.live_blocks;
+
+    m_live_bytes -= it->second.size;
+    m_blocks.erase( it );
+}
+
+
+void HeapTracker::print_report( std::ostream& os, const std::function<std::string( std::uint64_t pc )>& symbolize, std::size_t top_n ) const {
+
+    os << std::dec << m_allocations << " allocations, " << m_frees << " frees, peak " << m_peak_bytes << " bytes, live "
+       << m_live_bytes << " bytes in " << m_blocks.size() << " blocks";
+
+    if ( m_unknown_frees != 0 || m_failures != 0 ) {
+
+        os << " (" << m_unknown_frees << " frees of untracked blocks, " << m_failures << " failed)";
+    }
+
+    os << std::endl;
+
+    std::vector<const Site*> live;
+
+    for ( const Site& site : m_sites ) {
+
+        if ( site.live_blocks != 0 ) {
+            live.push_back( &site );
+        }
+    }
+
+    std::sort( live.begin(), live.end(), []( const Site* a, const Site* b ) { return a->live_bytes > b->live_bytes; } );
+
+    if ( live.empty() ) {
+        return;
+    }
+
+    os << std::setw( 12 ) << "Live bytes" << std::setw( 8 ) << "Blocks" << std::setw( 8 ) << "Allocs" << "  Call site" << std::endl;
+
+    for ( std::size_t i = 0; i < live.size() && i < top_n; ++i ) {
+
+        const Site& site = *live[i];
+
+        os << std::setw( 12 ) << site.live_bytes << std::setw( 8 ) << site.live_blocks << std::setw( 8 ) << site.allocations << "  ";
+
+        for ( std::size_t f = 0; f < heap_stack_depth && site.stack[f] != 0; ++f ) {
+
+            os << ( f ? " <- " : "" ) << symbolize( site.stack[f] );
+        }
+
+        os << std::endl;
+    }
+
+    if ( live.size() > top_n ) {
+
+        os << "... " << live.size() - top_n << " more call sites" << std::endl;
+    }
+}
+
+} // namespace MiniDbg
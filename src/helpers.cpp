@@ -1,5 +1,9 @@
 #include "helpers.h"
 
+#include <sys/ptrace.h>
+#include <dirent.h>
+#include <fstream>
+
 
 std::vector<std::string> split( const std::string& s, char delimiter ) {
 
@@ -38,3 +42,87 @@ bool is_suffix( const std::string& s, const std::string& of ) {
     
     return std::equal( s.begin(), s.end(), of.begin() + diff );
 }
+
+
+// what follows the first n space separated words, for arguments that may contain spaces
+std::string skip_words( const std::string& line, std::size_t n ) {
+
+    std::size_t pos = line.find_first_not_of( ' ' );
+
+    for ( std::size_t i = 0; i < n && pos != std::string::npos; ++i ) {
+
+        pos = line.find( ' ', pos );
+        pos = pos == std::string::npos ? pos : line.find_first_not_of( ' ', pos );
+    }
+
+    return pos == std::string::npos ? "" : line.substr( pos );
+}
+
+
+std::vector<pid_t> list_threads( pid_t pid ) {
+
+    std::vector<pid_t> tids;
+    std::string task_dir = "/proc/" + std::to_string( pid ) + "/task";
+    DIR* dir = ::opendir( task_dir.c_str() );
+
+    if ( dir == nullptr ) {
+        return tids;
+    }
+
+    while ( dirent* entry = ::readdir( dir ) ) {
+
+        if ( entry->d_name[0] != '.' ) {
+            tids.push_back( std::stoi( entry->d_name ) );
+        }
+    }
+
+    ::closedir( dir );
+
+    return tids;
+}
+
+
+pid_t read_tgid( pid_t tid ) {
+
+    std::ifstream status( "/proc/" + std::to_string( tid ) + "/status" );
+    std::string line;
+
+    while ( std::getline( status, line ) ) {
+
+        if ( line.starts_with( "Tgid:" ) ) {
+            return std::stoi( line.substr( 5 ) );
+        }
+    }
+
+    return tid;
+}
+
+
+// threads can be created while the others are being seized, so the task list is read again until it holds nothing new
+std::vector<pid_t> seize_all_threads( pid_t pid, long options, std::set<pid_t>& seized, bool interrupt ) {
+
+    std::vector<pid_t> tids;
+    bool found_new = true;
+
+    while ( found_new ) {
+
+        found_new = false;
+
+        for ( pid_t tid : list_threads( pid ) ) {
+
+            if ( seized.count( tid ) || ::ptrace( PTRACE_SEIZE, tid, nullptr, options ) != 0 ) {
+                continue;
+            }
+
+            if ( interrupt ) {
+                ::ptrace( PTRACE_INTERRUPT, tid, nullptr, nullptr );
+            }
+
+            seized.insert( tid );
+            tids.push_back( tid );
+            found_new = true;
+        }
+    }
+
+    return tids;
+}
@@ -0,0 +1,783 @@
+#include "location.hpp"
+#include "memory.hpp"
+#include "dwarf_cursor.hpp"
+
+#include <algorithm>
+
+
+namespace MiniDbg {
+
+
+namespace {
+
+    constexpr std::size_t max_stack_depth = 64;
+    constexpr std::size_t max_steps = 10000;     // bra can loop
+
+    // DW_OP_*
+    constexpr std::uint8_t op_addr = 0x03;
+    constexpr std::uint8_t op_deref = 0x06;
+    constexpr std::uint8_t op_const1u = 0x08;
+    constexpr std::uint8_t op_const1s = 0x09;
+    constexpr std::uint8_t op_const2u = 0x0a;
+    constexpr std::uint8_t op_const2s = 0x0b;
+    constexpr std::uint8_t op_const4u = 0x0c;
+    constexpr std::uint8_t op_const4s = 0x0d;
+    constexpr std::uint8_t op_const8u = 0x0e;
+    constexpr std::uint8_t op_const8s = 0x0f;
+    constexpr std::uint8_t op_constu = 0x10;
+    constexpr std::uint8_t op_consts = 0x11;
+    constexpr std::uint8_t op_dup = 0x12;
+    constexpr std::uint8_t op_drop = 0x13;
+    constexpr std::uint8_t op_over = 0x14;
+    constexpr std::uint8_t op_pick = 0x15;
+    constexpr std::uint8_t op_swap = 0x16;
+    constexpr std::uint8_t op_rot = 0x17;
+    constexpr std::uint8_t op_abs = 0x19;
+    constexpr std::uint8_t op_and = 0x1a;
+    constexpr std::uint8_t op_div = 0x1b;
+    constexpr std::uint8_t op_minus = 0x1c;
+    constexpr std::uint8_t op_mod = 0x1d;
+    constexpr std::uint8_t op_mul = 0x1e;
+    constexpr std::uint8_t op_neg = 0x1f;
+    constexpr std::uint8_t op_not = 0x20;
+    constexpr std::uint8_t op_or = 0x21;
+    constexpr std::uint8_t op_plus = 0x22;
+    constexpr std::uint8_t op_plus_uconst = 0x23;
+    constexpr std::uint8_t op_shl = 0x24;
+    constexpr std::uint8_t op_shr = 0x25;
+    constexpr std::uint8_t op_shra = 0x26;
+    constexpr std::uint8_t op_xor = 0x27;
+    constexpr std::uint8_t op_bra = 0x28;
+    constexpr std::uint8_t op_eq = 0x29;
+    constexpr std::uint8_t op_ge = 0x2a;
+    constexpr std::uint8_t op_gt = 0x2b;
+    constexpr std::uint8_t op_le = 0x2c;
+    constexpr std::uint8_t op_lt = 0x2d;
+    constexpr std::uint8_t op_ne = 0x2e;
+    constexpr std::uint8_t op_skip = 0x2f;
+    constexpr std::uint8_t op_lit0 = 0x30;
+    constexpr std::uint8_t op_lit31 = 0x4f;
+    constexpr std::uint8_t op_reg0 = 0x50;
+    constexpr std::uint8_t op_reg31 = 0x6f;
+    constexpr std::uint8_t op_breg0 = 0x70;
+    constexpr std::uint8_t op_breg31 = 0x8f;
+    constexpr std::uint8_t op_regx = 0x90;
+    constexpr std::uint8_t op_fbreg = 0x91;
+    constexpr std::uint8_t op_bregx = 0x92;
+    constexpr std::uint8_t op_piece = 0x93;
+    constexpr std::uint8_t op_deref_size = 0x94;
+    constexpr std::uint8_t op_nop = 0x96;
+    constexpr std::uint8_t op_call_frame_cfa = 0x9c;
+    constexpr std::uint8_t op_bit_piece = 0x9d;
+    constexpr std::uint8_t op_implicit_value = 0x9e;
+    constexpr std::uint8_t op_stack_value = 0x9f;
+
+
+    bool is_register_op( std::uint8_t code ) {
+
+        return ( code >= op_reg0 && code <= op_reg31 ) || code == op_regx;
+    }
+
+
+    bool is_piece_op( std::uint8_t code ) {
+
+        return code == op_piece || code == op_bit_piece;
+    }
+}
+
+
+bool CompiledLocation::compile( const std::uint8_t* begin, const std::uint8_t* end ) {
+
+    m_pieces.clear();
+
+    Cursor c( begin, end );
+    std::vector<Op> ops;
+    std::vector<std::size_t> offsets;
+    std::vector<std::uint8_t> implicit;
+
+    while ( c.more() ) {
+
+        offsets.push_back( c.p - begin );
+
+        Op op { c.fixed<std::uint8_t>() };
+
+        if ( op.code >= op_breg0 && op.code <= op_breg31 ) {
+
+            op.operand = static_cast<std::uint64_t>( c.sleb() );
+        }
+        else if ( ( op.code >= op_lit0 && op.code <= op_lit31 ) || ( op.code >= op_reg0 && op.code <= op_reg31 ) ) {
+
+            // no operands
+        }
+        else {
+
+            switch ( op.code ) {
+
+                case op_addr:
+                case op_const8u:
+                case op_const8s:    op.operand = c.fixed<std::uint64_t>(); break;
+                case op_const1u:    op.operand = c.fixed<std::uint8_t>(); break;
+                case op_const1s:    op.operand = static_cast<std::int64_t>( c.fixed<std::int8_t>() ); break;
+                case op_const2u:    op.operand = c.fixed<std::uint16_t>(); break;
+                case op_const2s:    op.operand = static_cast<std::int64_t>( c.fixed<std::int16_t>() ); break;
+                case op_const4u:    op.operand = c.fixed<std::uint32_t>(); break;
+                case op_const4s:    op.operand = static_cast<std::int64_t>( c.fixed<std::int32_t>() ); break;
+                case op_constu:
+                case op_plus_uconst:
+                case op_regx:
+                case op_piece:      op.operand = c.uleb(); break;
+                case op_consts:
+                case op_fbreg:      op.operand = static_cast<std::uint64_t>( c.sleb() ); break;
+                case op_pick:
+                case op_deref_size: op.operand = c.fixed<std::uint8_t>(); break;
+                case op_skip:
+                case op_bra:        op.operand = static_cast<std::int64_t>( c.fixed<std::int16_t>() ); break;
+
+                case op_bregx:
+                    op.operand = c.uleb();
+                    op.operand2 = static_cast<std::uint64_t>( c.sleb() );
+                    break;
+
+                case op_bit_piece:
+                    op.operand = c.uleb();
+                    op.operand2 = c.uleb();
+
+                    if ( op.operand % 8 != 0 || op.operand2 != 0 ) {
+                        return false;   // sub-byte pieces are not worth supporting
+                    }
+
+                    op.code = op_piece;
+                    op.operand /= 8;
+                    break;
+
+                case op_implicit_value:
+                {
+                    op.operand = c.uleb();
+                    const std::uint8_t* data = c.p;
+                    c.skip( op.operand );
+
+                    if ( c.ok ) {
+
+                        op.operand2 = implicit.size();
+                        implicit.insert( implicit.end(), data, data + op.operand );
+                    }
+                    break;
+                }
+
+                case op_deref:
+                case op_dup:
+                case op_drop:
+                case op_over:
+                case op_swap:
+                case op_rot:
+                case op_abs:
+                case op_and:
+                case op_div:
+                case op_minus:
+                case op_mod:
+                case op_mul:
+                case op_neg:
+                case op_not:
+                case op_or:
+                case op_plus:
+                case op_shl:
+                case op_shr:
+                case op_shra:
+                case op_xor:
+                case op_eq:
+                case op_ge:
+                case op_gt:
+                case op_le:
+                case op_lt:
+                case op_ne:
+                case op_nop:
+                case op_call_frame_cfa:
+                case op_stack_value:
+                    break;
+
+                default:
+                    return false;   // entry values, TLS and the like
+            }
+        }
+
+        ops.push_back( op );
+    }
+
+    if ( !c.ok ) {
+        return false;
+    }
+
+    // branch offsets count bytes, turn them into op indices once
+    std::size_t total = end - begin;
+
+    for ( std::size_t i = 0; i < ops.size(); ++i ) {
+
+        if ( ops[i].code != op_skip && ops[i].code != op_bra ) {
+            continue;
+        }
+
+        std::size_t next = i + 1 < ops.size() ? offsets[ i + 1 ] : total;
+        std::uint64_t target = next + ops[i].operand;
+
+        if ( target == total ) {
+
+            ops[i].operand2 = ops.size();
+            continue;
+        }
+
+        auto it = std::lower_bound( offsets.begin(), offsets.end(), target );
+
+        if ( it == offsets.end() || *it != target ) {
+            return false;
+        }
+
+        ops[i].operand2 = it - offsets.begin();
+    }
+
+    // split at DW_OP_piece, each piece is a location of its own
+    std::size_t start = 0;
+
+    while ( start < ops.size() || m_pieces.empty() ) {
+
+        std::size_t stop = start;
+
+        while ( stop < ops.size() && !is_piece_op( ops[ stop ].code ) ) {
+            ++stop;
+        }
+
+        Piece piece;
+        piece.ops.assign( ops.begin() + start, ops.begin() + stop );
+        piece.size = stop < ops.size() ? ops[ stop ].operand : 0;
+
+        for ( Op& op : piece.ops ) {
+
+            if ( op.code == op_skip || op.code == op_bra ) {
+
+                if ( op.operand2 < start || op.operand2 > stop ) {
+                    return false;
+                }
+
+                op.operand2 -= start;
+            }
+        }
+
+        const std::vector<Op>& body = piece.ops;
+
+        if ( body.empty() ) {
+
+            piece.shape = Shape::empty;
+        }
+        else if ( body.size() == 1 && is_register_op( body[0].code ) ) {
+
+            piece.shape = Shape::reg;
+            piece.reg = body[0].code == op_regx ? static_cast<unsigned>( body[0].operand ) : body[0].code - op_reg0;
+        }
+        else if ( body.size() == 1 && ( ( body[0].code >= op_breg0 && body[0].code <= op_breg31 ) || body[0].code == op_bregx ) ) {
+
+            piece.shape = Shape::breg;
+            piece.reg = body[0].code == op_bregx ? static_cast<unsigned>( body[0].operand ) : body[0].code - op_breg0;
+            piece.offset = static_cast<std::int64_t>( body[0].code == op_bregx ? body[0].operand2 : body[0].operand );
+        }
+        else if ( body.size() == 1 && body[0].code == op_fbreg ) {
+
+            piece.shape = Shape::fbreg;
+            piece.offset = static_cast<std::int64_t>( body[0].operand );
+        }
+        else if ( body.size() == 1 && body[0].code == op_addr ) {
+
+            piece.shape = Shape::addr;
+            piece.offset = static_cast<std::int64_t>( body[0].operand );
+        }
+        else if ( body.size() == 1 && body[0].code == op_implicit_value ) {
+
+            piece.shape = Shape::implicit;
+            piece.implicit.assign( implicit.begin() + body[0].operand2, implicit.begin() + body[0].operand2 + body[0].operand );
+        }
+        else {
+
+            for ( const Op& op : body ) {
+
+                if ( is_register_op( op.code ) || op.code == op_implicit_value ) {
+                    return false;   // only valid as the whole of a piece
+                }
+            }
+
+            piece.shape = Shape::stack_machine;
+            piece.stack_value = body.back().code == op_stack_value;
+
+            if ( piece.stack_value ) {
+                piece.ops.pop_back();
+            }
+        }
+
+        m_pieces.push_back( std::move( piece ) );
+        start = stop + 1;
+    }
+
+    return true;
+}
+
+
+bool CompiledLocation::run( const Piece& piece, LocationContext& context, std::uint64_t& result ) const {
+
+    std::uint64_t stack[ max_stack_depth ];
+    std::size_t depth = 0;
+    std::size_t steps = 0;
+
+    auto push = [ & ]( std::uint64_t value ) {
+
+        if ( depth == max_stack_depth ) {
+            return false;
+        }
+
+        stack[ depth++ ] = value;
+        return true;
+    };
+
+    const std::vector<Op>& ops = piece.ops;
+
+    for ( std::size_t i = 0; i < ops.size(); ++i ) {
+
+        if ( ++steps > max_steps ) {
+            return false;
+        }
+
+        const Op& op = ops[i];
+        std::uint64_t value;
+
+        if ( op.code >= op_lit0 && op.code <= op_lit31 ) {
+
+            if ( !push( op.code - op_lit0 ) ) {
+                return false;
+            }
+            continue;
+        }
+
+        if ( ( op.code >= op_breg0 && op.code <= op_breg31 ) || op.code == op_bregx ) {
+
+            unsigned reg = op.code == op_bregx ? static_cast<unsigned>( op.operand ) : op.code - op_breg0;
+            std::uint64_t offset = op.code == op_bregx ? op.operand2 : op.operand;
+
+            if ( !context.reg( reg, value ) || !push( value + offset ) ) {
+                return false;
+            }
+            continue;
+        }
+
+        // binary operators take the second entry as the left hand side
+        std::uint64_t a = depth >= 2 ? stack[ depth - 2 ] : 0;
+        std::uint64_t b = depth >= 1 ? stack[ depth - 1 ] : 0;
+
+        auto binary = [ & ]( std::uint64_t r ) {
+
+            if ( depth < 2 ) {
+                return false;
+            }
+
+            stack[ depth - 2 ] = r;
+            --depth;
+            return true;
+        };
+
+        auto unary = [ & ]( std::uint64_t r ) {
+
+            if ( depth < 1 ) {
+                return false;
+            }
+
+            stack[ depth - 1 ] = r;
+            return true;
+        };
+
+        bool ok = true;
+
+        switch ( op.code ) {
+
+            case op_addr:
+                ok = push( op.operand + context.load_address() );
+                break;
+
+            case op_const1u: case op_const1s: case op_const2u: case op_const2s:
+            case op_const4u: case op_const4s: case op_const8u: case op_const8s:
+            case op_constu: case op_consts:
+                ok = push( op.operand );
+                break;
+
+            case op_fbreg:
+                ok = context.frame_base( value ) && push( value + op.operand );
+                break;
+
+            case op_call_frame_cfa:
+                ok = context.cfa( value ) && push( value );
+                break;
+
+            case op_deref:
+            case op_deref_size:
+            {
+                std::size_t size = op.code == op_deref ? sizeof( std::uint64_t ) : op.operand;
+                value = 0;
+                ok = depth >= 1 && size <= sizeof( value ) && context.read( b, &value, size ) && unary( value );
+                break;
+            }
+
+            case op_dup:    ok = depth >= 1 && push( b ); break;
+            case op_drop:   ok = depth >= 1; depth -= ok; break;
+            case op_over:   ok = depth >= 2 && push( a ); break;
+            case op_pick:   ok = op.operand < depth && push( stack[ depth - 1 - op.operand ] ); break;
+
+            case op_swap:
+
+                ok = depth >= 2;
+
+                if ( ok ) {
+                    std::swap( stack[ depth - 1 ], stack[ depth - 2 ] );
+                }
+                break;
+
+            case op_rot:
+
+                ok = depth >= 3;
+
+                if ( ok ) {
+
+                    std::uint64_t top = stack[ depth - 1 ];
+                    stack[ depth - 1 ] = stack[ depth - 2 ];
+                    stack[ depth - 2 ] = stack[ depth - 3 ];
+                    stack[ depth - 3 ] = top;
+                }
+                break;
+
+            case op_abs:    ok = unary( static_cast<std::int64_t>( b ) < 0 ? -b : b ); break;
+            case op_neg:    ok = unary( -b ); break;
+            case op_not:    ok = unary( ~b ); break;
+            case op_plus_uconst: ok = unary( b + op.operand ); break;
+
+            case op_and:    ok = binary( a & b ); break;
+            case op_or:     ok = binary( a | b ); break;
+            case op_xor:    ok = binary( a ^ b ); break;
+            case op_plus:   ok = binary( a + b ); break;
+            case op_minus:  ok = binary( a - b ); break;
+            case op_mul:    ok = binary( a * b ); break;
+            case op_div:    ok = b != 0 && binary( static_cast<std::uint64_t>( static_cast<std::int64_t>( a ) / static_cast<std::int64_t>( b ) ) ); break;
+            case op_mod:    ok = b != 0 && binary( a % b ); break;
+            case op_shl:    ok = binary( b < 64 ? a << b : 0 ); break;
+            case op_shr:    ok = binary( b < 64 ? a >> b : 0 ); break;
+            case op_shra:   ok = binary( static_cast<std::uint64_t>( static_cast<std::int64_t>( a ) >> std::min<std::uint64_t>( b, 63 ) ) ); break;
+
+            case op_eq:     ok = binary( a == b ); break;
+            case op_ne:     ok = binary( a != b ); break;
+            case op_ge:     ok = binary( static_cast<std::int64_t>( a ) >= static_cast<std::int64_t>( b ) ); break;
+            case op_gt:     ok = binary( static_cast<std::int64_t>( a ) > static_cast<std::int64_t>( b ) ); break;
+            case op_le:     ok = binary( static_cast<std::int64_t>( a ) <= static_cast<std::int64_t>( b ) ); break;
+            case op_lt:     ok = binary( static_cast<std::int64_t>( a ) < static_cast<std::int64_t>( b ) ); break;
+
+            case op_skip:
+
+                i = op.operand2 - 1;
+                break;
+
+            case op_bra:
+
+                ok = depth >= 1;
+
+                if ( ok && stack[ --depth ] != 0 ) {
+                    i = op.operand2 - 1;
+                }
+                break;
+
+            case op_nop:
+                break;
+
+            default:
+                ok = false;
+                break;
+        }
+
+        if ( !ok ) {
+            return false;
+        }
+    }
+
+    if ( depth == 0 ) {
+        return false;
+    }
+
+    result = stack[ depth - 1 ];
+    return true;
+}
+
+
+bool CompiledLocation::evaluate( LocationContext& context, std::vector<LocationPiece>& pieces ) const {
+
+    using Kind = LocationPiece::Kind;
+
+    pieces.clear();
+
+    for ( const Piece& piece : m_pieces ) {
+
+        LocationPiece out;
+        out.size = piece.size;
+        std::uint64_t value;
+
+        switch ( piece.shape ) {
+
+            case Shape::empty:
+                out.kind = Kind::optimized_out;
+                break;
+
+            case Shape::reg:
+                out.kind = Kind::reg;
+                out.value = piece.reg;
+                break;
+
+            case Shape::breg:
+
+                if ( !context.reg( piece.reg, value ) ) {
+                    return false;
+                }
+
+                out.kind = Kind::memory;
+                out.value = value + piece.offset;
+                break;
+
+            case Shape::fbreg:
+
+                if ( !context.frame_base( value ) ) {
+                    return false;
+                }
+
+                out.kind = Kind::memory;
+                out.value = value + piece.offset;
+                break;
+
+            case Shape::addr:
+                out.kind = Kind::memory;
+                out.value = piece.offset + context.load_address();
+                break;
+
+            case Shape::implicit:
+                out.kind = Kind::implicit;
+                out.data = piece.implicit;
+                break;
+
+            case Shape::stack_machine:
+
+                if ( !run( piece, context, value ) ) {
+                    return false;
+                }
+
+                out.kind = piece.stack_value ? Kind::value : Kind::memory;
+                out.value = value;
+                break;
+        }
+
+        pieces.push_back( std::move( out ) );
+    }
+
+    return true;
+}
+
+
+void LocationCache::clear() {
+
+    m_sections.reset();
+    m_debug_loc = nullptr;
+    m_debug_loc_size = 0;
+    m_ranges.clear();
+}
+
+
+void LocationCache::build( const std::shared_ptr<SectionLoader>& sections ) {
+
+    clear();
+    m_sections = sections;
+
+    if ( m_sections ) {
+
+        m_debug_loc = static_cast<const std::uint8_t*>( m_sections->load( ".debug_loc", m_debug_loc_size ) );
+    }
+}
+
+
+std::vector<LocationCache::Range> LocationCache::compile( const dwarf::die& die, dwarf::DW_AT attribute ) {
+
+    std::vector<Range> ranges;
+
+    if ( !die.has( attribute ) ) {
+        return ranges;
+    }
+
+    dwarf::value value = die[ attribute ];
+
+    if ( value.get_type() == dwarf::value::type::exprloc || value.get_type() == dwarf::value::type::block ) {
+
+        std::size_t size;
+        const std::uint8_t* expr = static_cast<const std::uint8_t*>( value.as_block( &size ) );
+
+        Range range { 0, ~0ull, {} };
+
+        if ( range.location.compile( expr, expr + size ) ) {
+            ranges.push_back( std::move( range ) );
+        }
+
+        return ranges;
+    }
+
+    if ( value.get_type() != dwarf::value::type::loclist || m_debug_loc == nullptr ) {
+        return ranges;
+    }
+
+    // .debug_loc entries are relative to the base address of the unit unless reset
+    const dwarf::die& root = die.get_unit().root();
+    std::uint64_t base = root.has( dwarf::DW_AT::low_pc ) ? root[ dwarf::DW_AT::low_pc ].as_address() : 0;
+
+    std::uint64_t offset = value.as_sec_offset();
+
+    if ( offset >= m_debug_loc_size ) {
+        return ranges;
+    }
+
+    Cursor c( m_debug_loc + offset, m_debug_loc + m_debug_loc_size );
+
+    while ( c.more() ) {
+
+        std::uint64_t low = c.fixed<std::uint64_t>();
+        std::uint64_t high = c.fixed<std::uint64_t>();
+
+        if ( low == 0 && high == 0 ) {
+            break;
+        }
+
+        if ( low == ~0ull ) {
+
+            base = high;
+            continue;
+        }
+
+        std::uint16_t length = c.fixed<std::uint16_t>();
+        const std::uint8_t* expr = c.p;
+        c.skip( length );
+
+        if ( !c.ok ) {
+            break;
+        }
+
+        Range range { base + low, base + high, {} };
+
+        // an entry we cannot compile leaves the value unavailable over its range only
+        if ( low < high && range.location.compile( expr, expr + length ) ) {
+            ranges.push_back( std::move( range ) );
+        }
+    }
+
+    std::sort( ranges.begin(), ranges.end(), []( const Range& a, const Range& b ) { return a.low < b.low; } );
+    return ranges;
+}
+
+
+const CompiledLocation* LocationCache::find( const dwarf::die& die, dwarf::DW_AT attribute, std::uint64_t pc ) {
+
+    auto it = m_ranges.find( die.get_section_offset() );
+
+    if ( it == m_ranges.end() ) {
+
+        it = m_ranges.emplace( die.get_section_offset(), compile( die, attribute ) ).first;
+    }
+
+    const std::vector<Range>& ranges = it->second;
+
+    auto range = std::upper_bound( ranges.begin(), ranges.end(), pc, []( std::uint64_t pc, const Range& r ) { return pc < r.low; } );
+
+    if ( range == ranges.begin() || pc >= std::prev( range )->high ) {
+        return nullptr;
+    }
+
+    return &std::prev( range )->location;
+}
+
+
+FrameLocationContext::FrameLocationContext( pid_t pid, const user_regs_struct& regs, std::uint64_t load_address,
+                                            CfiUnwinder& unwinder, LocationCache& locations, const dwarf::die& function )
+    : m_pid( pid ), m_regs( dwarf_registers( regs ) ), m_pc( regs.rip - load_address ), m_load_address( load_address ),
+      m_unwinder( unwinder ), m_locations( locations ), m_function( function ) {}
+
+
+bool FrameLocationContext::reg( unsigned regnum, std::uint64_t& value ) {
+
+    if ( regnum >= n_unwind_registers ) {
+        return false;   // vector registers are not read
+    }
+
+    value = m_regs[ regnum ];
+    return true;
+}
+
+
+bool FrameLocationContext::read( std::uint64_t address, void* buffer, std::size_t size ) {
+
+    return read_process_memory( m_pid, address, buffer, size ) == size;
+}
+
+
+bool FrameLocationContext::cfa( std::uint64_t& value ) {
+
+    const UnwindRow& row = m_unwinder.find_row( m_pc );
+
+    if ( !row.valid || row.cfa_expression || row.cfa_register >= n_unwind_registers ) {
+        return false;
+    }
+
+    value = m_regs[ row.cfa_register ] + row.cfa_offset;
+    return true;
+}
+
+
+bool FrameLocationContext::frame_base( std::uint64_t& value ) {
+
+    if ( m_frame_base_ready ) {
+
+        value = m_frame_base;
+        return true;
+    }
+
+    if ( m_in_frame_base || !m_function.valid() ) {
+        return false;   // a frame base defined through itself
+    }
+
+    const CompiledLocation* location = m_locations.find( m_function, dwarf::DW_AT::frame_base, m_pc );
+    std::vector<LocationPiece> pieces;
+
+    m_in_frame_base = true;
+    bool ok = location != nullptr && location->evaluate( *this, pieces ) && pieces.size() == 1;
+    m_in_frame_base = false;
+
+    if ( !ok ) {
+        return false;
+    }
+
+    // DW_OP_call_frame_cfa describes the CFA as a memory location, DW_OP_reg6 names rbp itself
+    switch ( pieces[0].kind ) {
+
+        case LocationPiece::Kind::memory:
+        case LocationPiece::Kind::value:
+            m_frame_base = pieces[0].value;
+            break;
+
+        case LocationPiece::Kind::reg:
+
+            if ( !reg( static_cast<unsigned>( pieces[0].value ), m_frame_base ) ) {
+                return false;
+            }
+            break;
+
+        default:
+            return false;
+    }
+
+    m_frame_base_ready = true;
+    value = m_frame_base;
+    return true;
+}
+
+
+}
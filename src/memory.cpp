@@ -0,0 +1,185 @@
+#include "memory.hpp"
+
+#include <sys/uio.h>
+#include <unistd.h>
+#include <vector>
+#include <algorithm>
+
+
+namespace MiniDbg {
+
+
+static const std::size_t page_size = 4096;
+static const std::size_t max_iovecs = 1024;
+static const std::size_t max_span_gap = 256;      // reading a small gap is cheaper than another iovec
+
+
+template <typename IoFn>
+static std::size_t transfer_process_memory( IoFn io, pid_t pid, std::uint64_t address, char* buffer, std::size_t size ) {
+
+    std::size_t done = 0;
+    std::vector<iovec> remote;
+    remote.reserve( max_iovecs );
+
+    while ( done < size ) {
+
+        remote.clear();
+
+        std::uint64_t chunk_address = address + done;
+        std::size_t chunk_total = 0;
+
+        while ( done + chunk_total < size && remote.size() < max_iovecs ) {
+
+            std::uint64_t current = chunk_address + chunk_total;
+            std::size_t to_page_end = page_size - ( current % page_size );
+            std::size_t len = std::min( to_page_end, size - done - chunk_total );
+
+            remote.push_back( iovec{ reinterpret_cast<void*>( current ), len } );
+            chunk_total += len;
+        }
+
+        iovec local { buffer + done, chunk_total };
+
+        ssize_t n = io( pid, &local, 1, remote.data(), remote.size(), 0 );
+
+        if ( n <= 0 ) {
+            break;
+        }
+
+        done += n;
+
+        if ( static_cast<std::size_t>( n ) < chunk_total ) {
+            break;
+        }
+    }
+
+    return done;
+}
+
+
+std::size_t read_process_memory( pid_t pid, std::uint64_t address, void* buffer, std::size_t size ) {
+
+    return transfer_process_memory( ::process_vm_readv, pid, address, static_cast<char*>( buffer ), size );
+}
+
+
+std::size_t read_process_memory_ranges( pid_t pid, MemoryRange* ranges, std::size_t count ) {
+
+    struct Span {
+
+        std::uint64_t address;
+        std::size_t size;
+        std::size_t offset;     // into scratch
+        std::size_t read = 0;
+    };
+
+    std::vector<std::size_t> order( count );
+
+    for ( std::size_t i = 0; i < count; ++i ) {
+
+        order[ i ] = i;
+        ranges[ i ].ok = false;
+    }
+
+    std::sort( order.begin(), order.end(), [ ranges ]( std::size_t a, std::size_t b ) { return ranges[ a ].address < ranges[ b ].address; } );
+
+    std::vector<Span> spans;
+    std::vector<std::size_t> span_of( count );
+    std::size_t total = 0;
+
+    for ( std::size_t i : order ) {
+
+        const MemoryRange& range = ranges[ i ];
+
+        if ( range.size == 0 ) {
+            continue;
+        }
+
+        if ( !spans.empty() && range.address <= spans.back().address + spans.back().size + max_span_gap ) {
+
+            Span& span = spans.back();
+            std::size_t end = std::max<std::uint64_t>( span.address + span.size, range.address + range.size ) - span.address;
+
+            total += end - span.size;
+            span.size = end;
+        }
+        else {
+
+            spans.push_back( Span { range.address, range.size, total } );
+            total += range.size;
+        }
+
+        span_of[ i ] = spans.size() - 1;
+    }
+
+    std::vector<char> scratch( total );
+    std::vector<iovec> local;
+    std::vector<iovec> remote;
+    std::size_t next = 0;
+
+    while ( next < spans.size() ) {
+
+        local.clear();
+        remote.clear();
+
+        for ( std::size_t i = next; i < spans.size() && remote.size() < max_iovecs; ++i ) {
+
+            local.push_back( iovec { scratch.data() + spans[ i ].offset, spans[ i ].size } );
+            remote.push_back( iovec { reinterpret_cast<void*>( spans[ i ].address ), spans[ i ].size } );
+        }
+
+        ssize_t n = ::process_vm_readv( pid, local.data(), local.size(), remote.data(), remote.size(), 0 );
+        std::size_t done = n > 0 ? n : 0;
+
+        // the kernel stops at the first remote iovec it cannot finish
+        std::size_t batch_end = next + remote.size();
+
+        while ( next < batch_end && done >= spans[ next ].size ) {
+
+            spans[ next ].read = spans[ next ].size;
+            done -= spans[ next ].size;
+            ++next;
+        }
+
+        if ( next < batch_end ) {
+
+            Span& span = spans[ next ];
+            span.read = read_process_memory( pid, span.address, scratch.data() + span.offset, span.size );
+            ++next;
+        }
+    }
+
+    std::size_t copied = 0;
+
+    for ( std::size_t i = 0; i < count; ++i ) {
+
+        MemoryRange& range = ranges[ i ];
+
+        if ( range.size == 0 ) {
+
+            range.ok = true;
+            ++copied;
+            continue;
+        }
+
+        const Span& span = spans[ span_of[ i ] ];
+        std::size_t start = range.address - span.address;
+
+        if ( start + range.size <= span.read ) {
+
+            std::copy_n( scratch.data() + span.offset + start, range.size, static_cast<char*>( range.buffer ) );
+            range.ok = true;
+            ++copied;
+        }
+    }
+
+    return copied;
+}
+
+
+std::size_t write_process_memory( pid_t pid, std::uint64_t address, const void* buffer, std::size_t size ) {
+
+    return transfer_process_memory( ::process_vm_writev, pid, address, const_cast<char*>( static_cast<const char*>( buffer ) ), size );
+}
+
+} // namespace MiniDbg
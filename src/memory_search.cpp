@@ -0,0 +1,256 @@
+#include "memory_search.hpp"
+#include "memory.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <future>
+
+#if defined( __x86_64__ )
+#include <immintrin.h>
+#endif
+
+
+namespace MiniDbg {
+
+
+namespace {
+
+    constexpr std::size_t chunk_size = 8 << 20;
+
+    using Kernel = void ( * )( const std::uint8_t*, std::size_t, const std::uint8_t*, std::size_t, const std::function<bool( std::size_t )>& );
+
+
+    void scan_scalar( const std::uint8_t* data, std::size_t size, const std::uint8_t* pattern, std::size_t length,
+                      const std::function<bool( std::size_t )>& found ) {
+
+        if ( length == 0 || size < length ) {
+            return;
+        }
+
+        const std::uint8_t* at = data;
+        const std::uint8_t* last = data + size - length;
+
+        while ( at <= last ) {
+
+            at = static_cast<const std::uint8_t*>( std::memchr( at, pattern[0], last - at + 1 ) );
+
+            if ( at == nullptr ) {
+                return;
+            }
+
+            if ( std::memcmp( at, pattern, length ) == 0 && !found( at - data ) ) {
+                return;
+            }
+
+            ++at;
+        }
+    }
+
+
+#if defined( __x86_64__ )
+
+    // bits of mask are candidate offsets from i, the first and the last byte both matched
+    template<typename Mask>
+    bool verify( const std::uint8_t* data, std::size_t i, Mask mask, const std::uint8_t* pattern, std::size_t length,
+                 const std::function<bool( std::size_t )>& found ) {
+
+        while ( mask != 0 ) {
+
+            unsigned bit = __builtin_ctz( mask );
+            mask &= mask - 1;
+
+            if ( std::memcmp( data + i + bit + 1, pattern + 1, length - 2 ) == 0 && !found( i + bit ) ) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+
+    void scan_sse2( const std::uint8_t* data, std::size_t size, const std::uint8_t* pattern, std::size_t length,
+                    const std::function<bool( std::size_t )>& found ) {
+
+        if ( length < 2 || size < length + 16 ) {
+
+            scan_scalar( data, size, pattern, length, found );
+            return;
+        }
+
+        const __m128i first = _mm_set1_epi8( static_cast<char>( pattern[0] ) );
+        const __m128i last = _mm_set1_epi8( static_cast<char>( pattern[ length - 1 ] ) );
+        std::size_t i = 0;
+
+        for ( ; i + length - 1 + 16 <= size; i += 16 ) {
+
+            __m128i head = _mm_loadu_si128( reinterpret_cast<const __m128i*>( data + i ) );
+            __m128i tail = _mm_loadu_si128( reinterpret_cast<const __m128i*>( data + i + length - 1 ) );
+            unsigned mask = _mm_movemask_epi8( _mm_and_si128( _mm_cmpeq_epi8( head, first ), _mm_cmpeq_epi8( tail, last ) ) );
+
+            if ( !verify( data, i, mask, pattern, length, found ) ) {
+                return;
+            }
+        }
+
+        scan_scalar( data + i, size - i, pattern, length, [ &found, i ]( std::size_t offset ) { return found( i + offset ); } );
+    }
+
+
+    __attribute__(( target( "avx2" ) ))
+    void scan_avx2( const std::uint8_t* data, std::size_t size, const std::uint8_t* pattern, std::size_t length,
+                    const std::function<bool( std::size_t )>& found ) {
+
+        if ( length < 2 || size < length + 32 ) {
+
+            scan_sse2( data, size, pattern, length, found );
+            return;
+        }
+
+        const __m256i first = _mm256_set1_epi8( static_cast<char>( pattern[0] ) );
+        const __m256i last = _mm256_set1_epi8( static_cast<char>( pattern[ length - 1 ] ) );
+        std::size_t i = 0;
+
+        for ( ; i + length - 1 + 32 <= size; i += 32 ) {
+
+            __m256i head = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( data + i ) );
+            __m256i tail = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( data + i + length - 1 ) );
+            unsigned mask = static_cast<unsigned>( _mm256_movemask_epi8( _mm256_and_si256( _mm256_cmpeq_epi8( head, first ),
+                                                                                           _mm256_cmpeq_epi8( tail, last ) ) ) );
+
+            if ( !verify( data, i, mask, pattern, length, found ) ) {
+                return;
+            }
+        }
+
+        scan_scalar( data + i, size - i, pattern, length, [ &found, i ]( std::size_t offset ) { return found( i + offset ); } );
+    }
+
+#endif
+
+
+    Kernel pick_kernel( const char*& name ) {
+
+#if defined( __x86_64__ )
+        if ( __builtin_cpu_supports( "avx2" ) ) {
+
+            name = "avx2";
+            return scan_avx2;
+        }
+
+        name = "sse2";
+        return scan_sse2;     // part of x86-64 itself
+#else
+        name = "scalar";
+        return scan_scalar;
+#endif
+    }
+
+
+    const char* g_kernel_name = nullptr;
+    const Kernel g_kernel = pick_kernel( g_kernel_name );
+
+
+    // A piece of one range; pieces of the same range overlap by length - 1 bytes so a
+    // match across the seam is seen, and only matches starting before step are reported
+    struct Chunk {
+
+        std::uint64_t address;
+        std::size_t size;
+        std::size_t step;
+    };
+}
+
+
+void scan_memory( const std::uint8_t* data, std::size_t size, const std::uint8_t* pattern, std::size_t length,
+                  const std::function<bool( std::size_t offset )>& found ) {
+
+    g_kernel( data, size, pattern, length, found );
+}
+
+
+const char* scan_kernel_name() {
+
+    return g_kernel_name;
+}
+
+
+SearchStats search_memory( pid_t pid, const std::vector<SearchRange>& ranges, const std::vector<std::uint8_t>& pattern,
+                           const std::function<bool( std::uint64_t address )>& found ) {
+
+    SearchStats stats;
+    auto start = std::chrono::steady_clock::now();
+
+    if ( pattern.empty() ) {
+        return stats;
+    }
+
+    std::vector<Chunk> chunks;
+    const std::size_t step = chunk_size - ( pattern.size() - 1 );
+
+    for ( const SearchRange& range : ranges ) {
+
+        for ( std::uint64_t at = range.start; at < range.end; at += step ) {
+
+            std::size_t size = std::min<std::uint64_t>( chunk_size, range.end - at );
+            chunks.push_back( Chunk { at, size, at + size >= range.end ? size : step } );
+
+            if ( at + size >= range.end ) {
+                break;
+            }
+        }
+    }
+
+    std::vector<std::uint8_t> buffers[2] = { std::vector<std::uint8_t>( chunk_size ), std::vector<std::uint8_t>( chunk_size ) };
+
+    auto read_chunk = [ pid, &chunks, &buffers ]( std::size_t index ) {
+
+        return read_process_memory( pid, chunks[ index ].address, buffers[ index % 2 ].data(), chunks[ index ].size );
+    };
+
+    std::future<std::size_t> pending;
+
+    if ( !chunks.empty() ) {
+        pending = std::async( std::launch::async, read_chunk, 0 );
+    }
+
+    for ( std::size_t i = 0; i < chunks.size(); ++i ) {
+
+        std::size_t got = pending.get();
+
+        // the next read runs while this chunk is scanned
+        if ( i + 1 < chunks.size() ) {
+            pending = std::async( std::launch::async, read_chunk, i + 1 );
+        }
+
+        stats.bytes += std::min( got, chunks[i].step );
+
+        const Chunk& chunk = chunks[i];
+        bool more = true;
+
+        scan_memory( buffers[ i % 2 ].data(), got, pattern.data(), pattern.size(), [ & ]( std::size_t offset ) {
+
+            if ( offset >= chunk.step ) {
+                return true;    // the next chunk starts there and reports it
+            }
+
+            ++stats.matches;
+            more = found( chunk.address + offset );
+            return more;
+        } );
+
+        if ( !more ) {
+
+            if ( pending.valid() ) {
+                pending.wait();
+            }
+            break;
+        }
+    }
+
+    stats.seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+
+    return stats;
+}
+
+} // namespace MiniDbg
@@ -1,15 +1,70 @@
 #include <iostream>
+#include <sys/wait.h>
 
 #include "debugger.hpp"
+#include "pstack.hpp"
+#include "coverage.hpp"
 
 int main( int argc, char* argv[] ) {
 
     if ( argc < 2 )  {
     
         std::cerr << "Usage: minidbg <program_name>" << std::endl;
+        std::cerr << "       minidbg --pstack <pid>" << std::endl;
+        std::cerr << "       minidbg --coverage <program> [args...]" << std::endl;
         return -1;
     }
 
+    // one-shot stack dump of a live process, no prompt
+    if ( std::string( argv[1] ) == "--pstack" ) {
+
+        if ( argc < 3 ) {
+
+            std::cerr << "Usage: minidbg --pstack <pid>" << std::endl;
+            return -1;
+        }
+
+        MiniDbg::StackDump dump( std::stoi( argv[2] ) );
+
+        if ( !dump.prepare() || !dump.capture() ) {
+            return 1;
+        }
+
+        dump.print( std::cout );
+        return 0;
+    }
+
+    // runs the program to the end under one-shot line breakpoints, then writes <program>.info
+    if ( std::string( argv[1] ) == "--coverage" ) {
+
+        if ( argc < 3 ) {
+
+            std::cerr << "Usage: minidbg --coverage <program> [args...]" << std::endl;
+            return -1;
+        }
+
+        MiniDbg::CoverageRun coverage( std::vector<std::string>( argv + 2, argv + argc ) );
+        int status;
+
+        if ( !coverage.prepare() || !coverage.run( status ) ) {
+            return 1;
+        }
+
+        std::string program = argv[2];
+        std::string output = program.substr( program.rfind( '/' ) + 1 ) + ".info";
+
+        if ( !coverage.write_lcov( output ) ) {
+
+            std::cerr << "[" << "Can't write " << output << "]" << std::endl;
+            return 1;
+        }
+
+        coverage.print_summary( std::cerr );
+        std::cerr << "[" << "lcov tracefile written to " << output << "]" << std::endl;
+
+        return WIFEXITED( status ) ? WEXITSTATUS( status ) : 128 + WTERMSIG( status );
+    }
+
     char* prog = argv[1];
     
     MiniDbg::Debugger debugger( prog );
@@ -0,0 +1,383 @@
+#include "modules.hpp"
+
+#include <link.h>
+#include <fcntl.h>
+#include <algorithm>
+#include <fstream>
+#include <unordered_map>
+
+#include "memory.hpp"
+#include "helpers.h"
+
+
+namespace MiniDbg {
+
+
+namespace {
+
+    constexpr std::size_t max_link_map_entries = 4096;     // the list is walked in a live process, guard against a cycle
+    constexpr std::size_t max_path_length = 4096;
+    constexpr std::size_t path_chunk = 256;
+
+
+    std::string read_process_string( pid_t pid, std::uint64_t address ) {
+
+        std::string result;
+        char chunk[ path_chunk ];
+
+        while ( result.size() < max_path_length ) {
+
+            std::size_t n = read_process_memory( pid, address + result.size(), chunk, sizeof( chunk ) );
+            const char* end = std::find( chunk, chunk + n, '\0' );
+
+            result.append( chunk, end - chunk );
+
+            if ( end != chunk + n || n < sizeof( chunk ) ) {
+                break;
+            }
+        }
+
+        return result;
+    }
+
+
+    std::uint64_t find_symbol( const elf::elf& elf, const std::string& name ) {
+
+        for ( const elf::section& sec : elf.sections() ) {
+
+            if ( sec.get_hdr().type != elf::sht::symtab && sec.get_hdr().type != elf::sht::dynsym ) {
+                continue;
+            }
+
+            for ( const elf::sym& sym : sec.as_symtab() ) {
+
+                if ( sym.get_data().value != 0 && sym.get_name() == name ) {
+                    return sym.get_data().value;
+                }
+            }
+        }
+
+        return 0;
+    }
+
+
+    std::shared_ptr<Module> open_module( const std::string& path, std::uint64_t link_map, std::uint64_t load_address ) {
+
+        auto module = std::make_shared<Module>();
+        module->path = path;
+        module->link_map = link_map;
+        module->load_address = load_address;
+        int fd = ::open( path.c_str(), O_RDONLY );
+
+        if ( fd < 0 ) {
+            return nullptr;     // linux-vdso.so.1 and friends have no file
+        }
+
+        try {
+
+            module->elf = elf::elf( elf::create_mmap_loader( fd ) );
+        }
+        catch ( std::exception& e ) {
+
+            return nullptr;
+        }
+
+        std::uint64_t low = ~0ull;
+        std::uint64_t high = 0;
+
+        for ( const elf::segment& seg : module->elf.segments() ) {
+
+            if ( seg.get_hdr().type == elf::pt::load ) {
+
+                low = std::min( low, seg.get_hdr().vaddr );
+                high = std::max( high, seg.get_hdr().vaddr + seg.get_hdr().memsz );
+            }
+        }
+
+        if ( low >= high ) {
+            return nullptr;
+        }
+
+        module->low = load_address + low;
+        module->high = load_address + high;
+
+        return module;
+    }
+
+
+    bool find_line_entry( const dwarf::dwarf& dwarf, std::uint64_t pc, dwarf::line_table::iterator& entry ) {
+
+        for ( const dwarf::compilation_unit& cu : dwarf.compilation_units() ) {
+
+            if ( dwarf::die_pc_range( cu.root() ).contains( pc ) ) {
+
+                const dwarf::line_table& lt = cu.get_line_table();
+                entry = lt.find_address( pc );
+
+                return entry != lt.end();
+            }
+        }
+
+        return false;
+    }
+}
+
+
+Module::~Module() {
+
+    close_debug_file( debug_file );
+}
+
+
+void Module::load() {
+
+    if ( loaded ) {
+        return;
+    }
+
+    loaded = true;
+
+    // stripped without a debug file, symbols and .eh_frame still work
+    dwarf = load_dwarf( elf, path, debug_file );
+
+    function_index.build( elf, dwarf );
+    unwinder.build( elf );
+}
+
+
+bool ModuleTable::start( pid_t pid, std::uint64_t interp_base, const std::string& path ) {
+
+    clear();
+
+    std::shared_ptr<Module> interp = path.empty() ? nullptr : open_module( path, 0, interp_base );
+
+    if ( interp == nullptr ) {
+        return false;
+    }
+
+    std::uint64_t r_debug_offset = find_symbol( interp->elf, "_r_debug" );
+    std::uint64_t hook_offset = find_symbol( interp->elf, "_dl_debug_state" );
+
+    if ( r_debug_offset == 0 ) {
+        return false;
+    }
+
+    m_r_debug = interp_base + r_debug_offset;
+
+    // after an attach the loader has filled in r_brk already, before it runs only the symbol tells
+    struct r_debug debug {};
+    read_process_memory( pid, m_r_debug, &debug, sizeof( debug ) );
+
+    m_hook = debug.r_brk != 0 ? debug.r_brk : ( hook_offset != 0 ? interp_base + hook_offset : 0 );
+
+    return m_hook != 0;
+}
+
+
+void ModuleTable::clear() {
+
+    m_r_debug = 0;
+    m_hook = 0;
+    m_modules.clear();
+}
+
+
+ModuleChanges ModuleTable::update( pid_t pid ) {
+
+    ModuleChanges changes;
+    struct r_debug debug;
+
+    if ( m_r_debug == 0 || read_process_memory( pid, m_r_debug, &debug, sizeof( debug ) ) != sizeof( debug ) ||
+         debug.r_state != r_debug::RT_CONSISTENT ) {
+
+        return changes;     // half edited, the loader calls the hook again when it is done
+    }
+
+    std::unordered_map<std::uint64_t, std::shared_ptr<Module>> previous;
+
+    for ( std::shared_ptr<Module>& module : m_modules ) {
+
+        std::uint64_t link_map = module->link_map;
+        previous.emplace( link_map, std::move( module ) );
+    }
+
+    m_modules.clear();
+
+    std::uint64_t address = reinterpret_cast<std::uint64_t>( debug.r_map );
+
+    for ( std::size_t n = 0; address != 0 && n < max_link_map_entries; ++n ) {
+
+        struct link_map entry;
+
+        if ( read_process_memory( pid, address, &entry, sizeof( entry ) ) != sizeof( entry ) ) {
+            break;
+        }
+
+        std::string path = entry.l_name ? read_process_string( pid, reinterpret_cast<std::uint64_t>( entry.l_name ) ) : "";
+
+        // the executable comes first with an empty name, it has its own debug data
+        if ( !path.empty() ) {
+
+            auto it = previous.find( address );
+
+            if ( it != previous.end() && it->second->path == path && it->second->load_address == entry.l_addr ) {
+
+                m_modules.push_back( std::move( it->second ) );
+                previous.erase( it );
+            }
+            else if ( std::shared_ptr<Module> module = open_module( path, address, entry.l_addr ) ) {
+
+                changes.added.push_back( module );
+                m_modules.push_back( std::move( module ) );
+            }
+        }
+
+        address = reinterpret_cast<std::uint64_t>( entry.l_next );
+    }
+
+    for ( auto& [ _, module ] : previous ) {
+
+        changes.removed.push_back( std::move( module ) );
+    }
+
+    std::sort( m_modules.begin(), m_modules.end(),
+               []( const std::shared_ptr<Module>& a, const std::shared_ptr<Module>& b ) { return a->low < b->low; } );
+
+    return changes;
+}
+
+
+Module* ModuleTable::find( std::uint64_t address ) {
+
+    auto it = std::upper_bound( m_modules.begin(), m_modules.end(), address,
+                                []( std::uint64_t value, const std::shared_ptr<Module>& m ) { return value < m->low; } );
+
+    if ( it == m_modules.begin() || address >= ( *--it )->high ) {
+        return nullptr;
+    }
+
+    ( *it )->load();
+
+    return it->get();
+}
+
+
+std::uint64_t read_auxv_entry( pid_t pid, std::uint64_t type ) {
+
+    std::ifstream auxv( "/proc/" + std::to_string( pid ) + "/auxv", std::ios::binary );
+    std::uint64_t entry[2];
+
+    while ( auxv.read( reinterpret_cast<char*>( entry ), sizeof( entry ) ) && entry[0] != AT_NULL ) {
+
+        if ( entry[0] == type ) {
+            return entry[1];
+        }
+    }
+
+    return 0;
+}
+
+
+std::vector<std::uint64_t> function_breakpoint_addresses( const elf::elf& elf, const dwarf::dwarf& dwarf, const std::string& name ) {
+
+    std::vector<std::uint64_t> addresses;
+
+    if ( dwarf.valid() ) {
+
+        for ( const dwarf::compilation_unit& cu : dwarf.compilation_units() ) {
+
+            for ( const dwarf::die& die : cu.root() ) {
+
+                if ( die.has( dwarf::DW_AT::name ) && dwarf::at_name( die ) == name && die.has( dwarf::DW_AT::low_pc ) ) {
+
+                    dwarf::line_table::iterator entry;
+
+                    if ( find_line_entry( dwarf, dwarf::at_low_pc( die ), entry ) ) {
+
+                        ++entry; //skip prologue
+                        addresses.push_back( entry->address );
+                    }
+                }
+            }
+        }
+    }
+
+    if ( addresses.empty() ) {
+
+        // no debug info for it, break on the symbol itself
+        for ( const elf::section& sec : elf.sections() ) {
+
+            if ( sec.get_hdr().type != elf::sht::symtab && sec.get_hdr().type != elf::sht::dynsym ) {
+                continue;
+            }
+
+            for ( const elf::sym& sym : sec.as_symtab() ) {
+
+                const elf::Sym<>& d = sym.get_data();
+
+                if ( d.type() == elf::stt::func && d.value != 0 && sym.get_name() == name &&
+                     std::find( addresses.begin(), addresses.end(), d.value ) == addresses.end() ) {
+
+                    addresses.push_back( d.value );
+                }
+            }
+        }
+    }
+
+    return addresses;
+}
+
+
+std::vector<std::uint64_t> line_breakpoint_addresses( const dwarf::dwarf& dwarf, const std::string& file, unsigned line ) {
+
+    if ( !dwarf.valid() ) {
+        return {};
+    }
+
+    for ( const dwarf::compilation_unit& cu : dwarf.compilation_units() ) {
+
+        if ( is_suffix( file, dwarf::at_name( cu.root() ) ) ) {
+
+            for ( const dwarf::line_table::entry& entry : cu.get_line_table() ) {
+
+                if ( entry.is_stmt && entry.line == line ) {
+
+                    return { entry.address };
+                }
+            }
+        }
+    }
+
+    return {};
+}
+
+
+bool has_function_symbol( const elf::elf& elf, const std::string& name ) {
+
+    // a C++ function is only in the table mangled, _Z...<length><name>...
+    std::string mangled = std::to_string( name.size() ) + name;
+
+    for ( const elf::section& sec : elf.sections() ) {
+
+        if ( sec.get_hdr().type != elf::sht::symtab && sec.get_hdr().type != elf::sht::dynsym ) {
+            continue;
+        }
+
+        for ( const elf::sym& sym : sec.as_symtab() ) {
+
+            if ( sym.get_data().type() != elf::stt::func ) {
+                continue;
+            }
+
+            std::string symbol = sym.get_name();
+
+            if ( symbol == name || ( symbol.starts_with( "_Z" ) && symbol.find( mangled ) != std::string::npos ) ) {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+} // namespace MiniDbg
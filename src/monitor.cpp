@@ -0,0 +1,187 @@
+#include "monitor.hpp"
+#include "memory.hpp"
+
+#include <poll.h>
+#include <signal.h>
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+
+namespace MiniDbg {
+
+
+using Clock = std::chrono::steady_clock;
+
+
+namespace {
+
+    std::string csv_field( const std::string& text ) {
+
+        if ( text.find_first_of( ",\"\n" ) == std::string::npos ) {
+            return text;
+        }
+
+        std::string quoted = "\"";
+
+        for ( char c : text ) {
+
+            quoted += c;
+
+            if ( c == '"' ) {
+                quoted += '"';
+            }
+        }
+
+        return quoted + "\"";
+    }
+}
+
+
+Monitor::Monitor( pid_t pid, std::vector<MonitoredValue> values, Formatter format )
+    : m_pid( pid ), m_values( std::move( values ) ), m_format( std::move( format ) ) {
+
+    for ( const MonitoredValue& value : m_values ) {
+
+        m_current.emplace_back( value.size );
+    }
+}
+
+
+bool Monitor::Run( double period_ms, unsigned seconds, int stop_fd, std::ostream& out, bool csv ) {
+
+    if ( period_ms <= 0 || m_values.empty() ) {
+
+        std::cerr << "[" << "Nothing to monitor" << "]" << std::endl;
+        return false;
+    }
+
+    if ( csv ) {
+
+        out << "time_ms";
+
+        for ( const MonitoredValue& value : m_values ) {
+
+            out << "," << csv_field( value.expression );
+        }
+
+        out << "\n";
+    }
+
+    const Clock::duration period = std::chrono::duration_cast<Clock::duration>( std::chrono::duration<double, std::milli>( period_ms ) );
+    const Clock::time_point start = Clock::now();
+    const Clock::time_point end = seconds ? start + std::chrono::seconds( seconds ) : Clock::time_point::max();
+
+    std::vector<MemoryRange> ranges( m_values.size() );
+    std::vector<bool> changed( m_values.size() );
+    Clock::time_point next = start;
+
+    while ( Clock::now() < end ) {
+
+        for ( std::size_t i = 0; i < m_values.size(); ++i ) {
+
+            ranges[i] = MemoryRange { m_values[i].address, m_current[i].data(), m_values[i].size };
+        }
+
+        Clock::time_point read_start = Clock::now();
+        std::size_t copied = read_process_memory_ranges( m_pid, ranges.data(), ranges.size() );
+        Clock::time_point read_end = Clock::now();
+
+        if ( copied == 0 && ::kill( m_pid, 0 ) != 0 ) {
+
+            out.flush();
+            std::cout << "[" << "Process " << std::dec << m_pid << " is gone" << "]" << std::endl;
+            break;
+        }
+
+        ++m_samples;
+        m_read_us += std::chrono::duration<double, std::micro>( read_end - read_start ).count();
+
+        bool any = m_last.empty();
+
+        for ( std::size_t i = 0; i < m_values.size(); ++i ) {
+
+            changed[i] = ranges[i].ok && ( m_last.empty() || m_current[i] != m_last[i] );
+            any = any || changed[i];
+        }
+
+        if ( any ) {
+
+            ++m_changes;
+            emit( out, csv, std::chrono::duration<double, std::milli>( read_start - start ).count(), changed );
+            m_last = m_current;
+        }
+
+        // absolute deadlines, so the time spent reading and printing does not drift the rate
+        next += period;
+        Clock::time_point now = Clock::now();
+
+        // a little late is caught up on the next tick, a whole period behind drops the missed ticks
+        if ( next < now ) {
+
+            ++m_late;
+
+            if ( now - next > period ) {
+                next = now;
+            }
+        }
+
+        std::chrono::nanoseconds wait = std::chrono::duration_cast<std::chrono::nanoseconds>( std::max( next - now, Clock::duration::zero() ) );
+        timespec timeout { static_cast<time_t>( wait.count() / 1000000000 ), static_cast<long>( wait.count() % 1000000000 ) };
+        pollfd fd { stop_fd, POLLIN, 0 };
+
+        if ( ::ppoll( &fd, stop_fd >= 0 ? 1 : 0, &timeout, nullptr ) > 0 ) {
+            break;
+        }
+    }
+
+    m_elapsed_ms = std::chrono::duration<double, std::milli>( Clock::now() - start ).count();
+    out.flush();
+
+    return true;
+}
+
+
+void Monitor::emit( std::ostream& out, bool csv, double at_ms, const std::vector<bool>& changed ) {
+
+    if ( csv ) {
+
+        out << std::fixed << std::setprecision( 3 ) << at_ms;
+
+        for ( std::size_t i = 0; i < m_values.size(); ++i ) {
+
+            out << "," << csv_field( m_format( i, m_current[i].data() ) );
+        }
+
+        out << "\n";
+        out.unsetf( std::ios_base::floatfield );
+        return;
+    }
+
+    for ( std::size_t i = 0; i < m_values.size(); ++i ) {
+
+        if ( changed[i] ) {
+
+            out << "[" << std::fixed << std::setprecision( 3 ) << std::setw( 10 ) << at_ms << " ms] "
+                << m_values[i].expression << " = " << m_format( i, m_current[i].data() ) << "\n";
+        }
+    }
+
+    out.unsetf( std::ios_base::floatfield );
+    out.flush();
+}
+
+
+void Monitor::print_summary( std::ostream& os ) const {
+
+    double seconds = m_elapsed_ms / 1000.0;
+
+    os << std::dec << m_samples << " samples in " << std::fixed << std::setprecision( 3 ) << seconds << " s ("
+       << std::setprecision( 1 ) << ( seconds > 0 ? m_samples / seconds : 0.0 ) << " Hz), " << m_changes << " with changes, "
+       << m_late << " late; " << std::setprecision( 2 ) << ( m_samples ? m_read_us / m_samples : 0.0 ) << " us per read" << std::endl;
+
+    os.unsetf( std::ios_base::floatfield );
+}
+
+} // namespace MiniDbg
@@ -0,0 +1,190 @@
+#include "perf_counters.hpp"
+#include "helpers.h"
+
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <cstring>
+#include <iomanip>
+
+
+namespace MiniDbg {
+
+
+struct CounterDescriptor {
+
+    std::uint32_t type;
+    std::uint64_t config;
+    const char* name;
+    bool kernel_only;       // happens in the kernel, always 0 with exclude_kernel
+};
+
+
+static const CounterDescriptor g_counter_descriptors[] {
+
+    { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK, "task-clock (ns)", false },
+    { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, "context-switches", true },
+    { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_MIGRATIONS, "cpu-migrations", true },
+    { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS, "page-faults", false },
+    { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS_MIN, "minor-faults", false },
+    { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS_MAJ, "major-faults", false },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, "cycles", false },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, "instructions", false },
+};
+
+
+static int perf_event_open( perf_event_attr* attr, pid_t pid ) {
+
+    return static_cast<int>( ::syscall( SYS_perf_event_open, attr, pid, -1, -1, PERF_FLAG_FD_CLOEXEC ) );
+}
+
+
+bool PerfCounters::Open( pid_t pid ) {
+
+    Close();
+
+    // callers have the debuggee stopped, so no thread appears between the listing and the opens
+    std::vector<pid_t> tids = list_threads( pid );
+
+    if ( tids.empty() ) {
+        tids.push_back( pid );      // perf_event_open reports the error
+    }
+
+    for ( const CounterDescriptor& desc : g_counter_descriptors ) {
+
+        perf_event_attr attr;
+        std::memset( &attr, 0, sizeof( attr ) );
+
+        attr.size = sizeof( attr );
+        attr.type = desc.type;
+        attr.config = desc.config;
+        attr.disabled = 1;
+        attr.inherit = 1;           // follow threads created from now on
+        attr.exclude_kernel = desc.type == PERF_TYPE_HARDWARE;     // allowed with the default perf_event_paranoid
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        int fd = perf_event_open( &attr, tids.front() );
+
+        // a perf_event_paranoid of 2 refuses kernel counting, the user side of the event is still worth having
+        if ( fd < 0 && !attr.exclude_kernel && !desc.kernel_only ) {
+
+            attr.exclude_kernel = 1;
+            fd = perf_event_open( &attr, tids.front() );
+        }
+
+        if ( fd < 0 ) {
+            continue;   // e.g. no hardware counters inside a VM
+        }
+
+        Counter counter { desc.name, { fd }, 0 };
+
+        for ( std::size_t i = 1; i < tids.size(); ++i ) {
+
+            fd = perf_event_open( &attr, tids[ i ] );
+
+            if ( fd >= 0 ) {
+
+                counter.fds.push_back( fd );
+            }
+        }
+
+        m_counters.push_back( counter );
+    }
+
+    return is_open();
+}
+
+
+void PerfCounters::Close() {
+
+    for ( const Counter& counter : m_counters ) {
+
+        for ( int fd : counter.fds ) {
+
+            ::close( fd );
+        }
+    }
+
+    m_counters.clear();
+    m_enabled = false;
+}
+
+
+void PerfCounters::Enable() {
+
+    if ( m_enabled ) {
+        return;
+    }
+
+    for ( const Counter& counter : m_counters ) {
+
+        for ( int fd : counter.fds ) {
+
+            ::ioctl( fd, PERF_EVENT_IOC_ENABLE, 0 );
+        }
+    }
+
+    m_enabled = is_open();
+}
+
+
+void PerfCounters::Disable() {
+
+    if ( !m_enabled ) {
+        return;
+    }
+
+    for ( const Counter& counter : m_counters ) {
+
+        for ( int fd : counter.fds ) {
+
+            ::ioctl( fd, PERF_EVENT_IOC_DISABLE, 0 );
+        }
+    }
+
+    m_enabled = false;
+}
+
+
+std::uint64_t PerfCounters::read_scaled( const Counter& counter ) const {
+
+    std::uint64_t total = 0;
+
+    for ( int fd : counter.fds ) {
+
+        std::uint64_t values[3] = { 0, 0, 0 };  // value, time enabled, time running
+
+        if ( ::read( fd, values, sizeof( values ) ) != sizeof( values ) ) {
+            return counter.last_value;
+        }
+
+        // the kernel multiplexes hardware counters when there are too few of them
+        if ( values[2] != 0 && values[2] < values[1] ) {
+
+            total += static_cast<std::uint64_t>( static_cast<double>( values[0] ) * values[1] / values[2] );
+        }
+        else {
+
+            total += values[0];
+        }
+    }
+
+    return total;
+}
+
+
+void PerfCounters::print_deltas( std::ostream& os ) {
+
+    for ( Counter& counter : m_counters ) {
+
+        std::uint64_t value = read_scaled( counter );
+
+        os << std::dec << std::setw( 16 ) << value - counter.last_value << "  " << counter.name << std::endl;
+
+        counter.last_value = value;
+    }
+}
+
+} // namespace MiniDbg
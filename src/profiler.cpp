@@ -0,0 +1,373 @@
+#include "profiler.hpp"
+#include "memory.hpp"
+#include "helpers.h"
+
+#include <sys/ptrace.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <cstring>
+#include <thread>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <set>
+
+
+namespace MiniDbg {
+
+
+using Clock = std::chrono::steady_clock;
+
+
+static double to_us( Clock::duration d ) {
+
+    return std::chrono::duration<double, std::micro>( d ).count();
+}
+
+
+static double mean( const std::vector<double>& values ) {
+
+    double sum = 0.0;
+
+    for ( double v : values ) {
+        sum += v;
+    }
+
+    return values.empty() ? 0.0 : sum / values.size();
+}
+
+
+static double percentile( std::vector<double> values, double p ) {
+
+    if ( values.empty() ) {
+        return 0.0;
+    }
+
+    std::sort( values.begin(), values.end() );
+    std::size_t idx = static_cast<std::size_t>( p * ( values.size() - 1 ) );
+
+    return values[ idx ];
+}
+
+
+Profiler::Profiler( pid_t pid, FunctionIndex& index, CfiUnwinder& unwinder, ModuleTable& modules, std::uint64_t load_address ) 
+    : m_pid( pid ), m_index( index ), m_unwinder( unwinder ), m_modules( modules ), m_load_address( load_address ) {}
+
+
+void Profiler::refresh_threads() {
+
+    std::set<pid_t> seized;
+
+    for ( const auto& [ tid, _ ] : m_threads ) {
+        seized.insert( tid );
+    }
+
+    for ( pid_t tid : seize_all_threads( m_pid, 0, seized, false ) ) {
+
+        m_threads.emplace( tid, true );
+    }
+}
+
+
+bool Profiler::wait_for_interrupt_stop( pid_t tid, bool& group_stop ) {
+
+    while ( true ) {
+
+        int status;
+
+        if ( ::waitpid( tid, &status, __WALL ) < 0 ) {
+            return false;
+        }
+
+        if ( WIFEXITED( status ) || WIFSIGNALED( status ) ) {
+            return false;
+        }
+
+        if ( !WIFSTOPPED( status ) ) {
+            continue;
+        }
+
+        if ( ( status >> 16 ) == PTRACE_EVENT_STOP ) {
+
+            group_stop = WSTOPSIG( status ) != SIGTRAP;
+            return true;
+        }
+
+        // a signal raced with the interrupt: deliver it, the interrupt stays pending
+        ::ptrace( PTRACE_CONT, tid, nullptr, static_cast<long>( WSTOPSIG( status ) ) );
+    }
+}
+
+
+void Profiler::take_sample() {
+
+    std::vector<pid_t> tids;
+
+    for ( const auto& [ tid, _ ] : m_threads ) {
+        tids.push_back( tid );
+    }
+
+    Clock::time_point sample_start = Clock::now();
+    std::vector<Clock::time_point> interrupted( tids.size() );
+
+    for ( std::size_t i = 0; i < tids.size(); ++i ) {
+
+        interrupted[i] = Clock::now();
+        ::ptrace( PTRACE_INTERRUPT, tids[i], nullptr, nullptr );
+    }
+
+    std::vector<StackCopy> copies;
+    copies.reserve( tids.size() );
+
+    for ( std::size_t i = 0; i < tids.size(); ++i ) {
+
+        bool group_stop = false;
+
+        if ( !wait_for_interrupt_stop( tids[i], group_stop ) ) {
+
+            m_threads.erase( tids[i] );
+            continue;
+        }
+
+        StackCopy copy;
+        ::ptrace( PTRACE_GETREGS, tids[i], nullptr, &copy.regs );
+
+        copy.stack.resize( stack_copy_size );
+        copy.stack.resize( read_process_memory( tids[i], copy.regs.rsp, copy.stack.data(), copy.stack.size() ) );
+
+        // a real group stop must stay stopped, PTRACE_LISTEN keeps it that way without a ptrace-stop
+        ::ptrace( group_stop ? PTRACE_LISTEN : PTRACE_CONT, tids[i], nullptr, nullptr );
+
+        m_thread_pause_us.push_back( to_us( Clock::now() - interrupted[i] ) );
+        copies.push_back( std::move( copy ) );
+    }
+
+    m_sample_pause_us.push_back( to_us( Clock::now() - sample_start ) );
+
+    for ( StackCopy& copy : copies ) {
+
+        m_stacks.push_back( unwind( copy ) );
+    }
+}
+
+
+void Profiler::release_threads() {
+
+    for ( const auto& [ tid, _ ] : m_threads ) {
+
+        ::ptrace( PTRACE_INTERRUPT, tid, nullptr, nullptr );
+
+        bool group_stop = false;
+
+        if ( wait_for_interrupt_stop( tid, group_stop ) ) {
+
+            ::ptrace( PTRACE_DETACH, tid, nullptr, nullptr );
+        }
+    }
+
+    m_threads.clear();
+}
+
+
+bool Profiler::Run( unsigned hz, unsigned seconds ) {
+
+    if ( hz == 0 ) {
+
+        std::cerr << "[" << "Sampling rate must be positive" << "]" << std::endl;
+        return false;
+    }
+
+    refresh_threads();
+
+    if ( m_threads.empty() ) {
+
+        std::cerr << "[" << "Can't seize process " << std::dec << m_pid << ": " << std::strerror( errno ) << "]" << std::endl;
+        return false;
+    }
+
+    const Clock::duration period = std::chrono::duration_cast<Clock::duration>( std::chrono::duration<double>( 1.0 / hz ) );
+    const Clock::time_point start = Clock::now();
+    const Clock::time_point end = start + std::chrono::seconds( seconds );
+
+    Clock::time_point next = start;
+
+    while ( Clock::now() < end && !m_threads.empty() ) {
+
+        refresh_threads();
+        take_sample();
+
+        next += period;
+        std::this_thread::sleep_until( next );
+    }
+
+    m_elapsed = Clock::now() - start;
+    release_threads();
+
+    return true;
+}
+
+
+std::vector<std::uint64_t> Profiler::unwind( StackCopy& copy ) const {
+
+    auto resolve = [ this ]( std::uint64_t pc, std::uint64_t& load_address ) -> CfiUnwinder* {
+
+        Module* module = m_modules.find( pc );
+
+        if ( module == nullptr ) {
+            return nullptr;
+        }
+
+        load_address = module->load_address;
+        return &module->unwinder;
+    };
+
+    StackReader stack( copy.regs.rsp, std::move( copy.stack ) );
+    std::vector<std::uint64_t> frames;
+
+    for ( const UnwoundFrame& frame : m_unwinder.unwind( stack, copy.regs, m_load_address, max_frames, resolve ) ) {
+
+        // attribute a return address to the call instruction
+        frames.push_back( frames.empty() ? frame.pc : frame.pc - 1 );
+    }
+
+    if ( frames.empty() ) {
+
+        frames.push_back( copy.regs.rip );
+    }
+
+    return frames;
+}
+
+
+std::string Profiler::symbolize( std::uint64_t pc ) const {
+
+    auto it = m_symbol_cache.find( pc );
+
+    if ( it != m_symbol_cache.end() ) {
+        return it->second;
+    }
+
+    std::string name;
+    const FunctionEntry* entry = nullptr;
+
+    if ( Module* module = m_modules.find( pc ) ) {
+
+        entry = module->function_index.find( pc - module->load_address );
+    }
+    else {
+
+        entry = m_index.find( pc - m_load_address );
+    }
+
+    if ( entry != nullptr ) {
+
+        name = entry->name;
+    }
+    else {
+
+        std::ostringstream ss;
+        ss << "0x" << std::hex << pc;
+        name = ss.str();
+    }
+
+    return m_symbol_cache.emplace( pc, name ).first->second;
+}
+
+
+void Profiler::print_report( std::ostream& os, std::size_t top_n ) const {
+
+    std::map<std::string, std::size_t> self_counts;
+    std::map<std::string, std::size_t> total_counts;
+
+    for ( const std::vector<std::uint64_t>& stack : m_stacks ) {
+
+        std::set<std::string> seen;
+
+        for ( std::size_t i = 0; i < stack.size(); ++i ) {
+
+            std::string name = symbolize( stack[i] );
+
+            if ( i == 0 ) {
+                ++self_counts[ name ];
+            }
+
+            if ( seen.insert( name ).second ) {
+                ++total_counts[ name ];
+            }
+        }
+    }
+
+    std::vector<std::pair<std::string, std::size_t>> sorted( self_counts.begin(), self_counts.end() );
+    std::sort( sorted.begin(), sorted.end(), []( const auto& a, const auto& b ) { return a.second > b.second; } );
+
+    double elapsed_us = to_us( m_elapsed );
+    double stopped_us = mean( m_sample_pause_us ) * m_sample_pause_us.size();
+
+    const double n_samples = m_stacks.empty() ? 1.0 : m_stacks.size();
+
+    os << std::dec << m_stacks.size() << " stack samples in " << m_sample_pause_us.size() << " ticks over "
+       << std::fixed << std::setprecision( 3 ) << elapsed_us / 1e6 << " s" << std::endl;
+
+    os << "Pause per thread (us): mean " << std::setprecision( 1 )
+       << mean( m_thread_pause_us )
+       << ", p50 " << percentile( m_thread_pause_us, 0.5 )
+       << ", p99 " << percentile( m_thread_pause_us, 0.99 )
+       << ", max " << percentile( m_thread_pause_us, 1.0 ) << std::endl;
+
+    os << "Pause per tick (us):   p50 " << percentile( m_sample_pause_us, 0.5 )
+       << ", p99 " << percentile( m_sample_pause_us, 0.99 )
+       << ", max " << percentile( m_sample_pause_us, 1.0 )
+       << "; target stopped " << std::setprecision( 3 ) << ( elapsed_us > 0 ? 100.0 * stopped_us / elapsed_us : 0.0 )
+       << "% of wall time" << std::endl << std::endl;
+
+    os << std::setw( 8 ) << "self%" << std::setw( 8 ) << "total%" << "  function" << std::endl;
+
+    for ( std::size_t i = 0; i < sorted.size() && i < top_n; ++i ) {
+
+        os << std::setprecision( 2 ) 
+           << std::setw( 8 ) << 100.0 * sorted[i].second / n_samples
+           << std::setw( 8 ) << 100.0 * total_counts[ sorted[i].first ] / n_samples
+           << "  " << sorted[i].first << std::endl;
+    }
+
+    os.unsetf( std::ios_base::floatfield );
+}
+
+
+bool Profiler::write_folded_stacks( const std::string& path ) const {
+
+    std::map<std::string, std::size_t> folded;
+
+    for ( const std::vector<std::uint64_t>& stack : m_stacks ) {
+
+        std::string line;
+
+        for ( auto it = stack.rbegin(); it != stack.rend(); ++it ) {
+
+            if ( !line.empty() ) {
+                line += ';';
+            }
+
+            line += symbolize( *it );
+        }
+
+        ++folded[ line ];
+    }
+
+    std::ofstream out( path );
+
+    if ( !out ) {
+        return false;
+    }
+
+    for ( const auto& [ line, count ] : folded ) {
+
+        out << line << ' ' << count << '\n';
+    }
+
+    return true;
+}
+
+} // namespace MiniDbg
@@ -0,0 +1,238 @@
+#include "pstack.hpp"
+#include "memory.hpp"
+#include "helpers.h"
+
+#include <sys/ptrace.h>
+#include <sys/wait.h>
+#include <sys/auxv.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <climits>
+#include <cstring>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <set>
+
+
+namespace MiniDbg {
+
+
+using Clock = std::chrono::steady_clock;
+
+
+namespace {
+
+    std::string thread_name( pid_t pid, pid_t tid ) {
+
+        std::ifstream comm( "/proc/" + std::to_string( pid ) + "/task/" + std::to_string( tid ) + "/comm" );
+        std::string name;
+        std::getline( comm, name );
+
+        return name;
+    }
+}
+
+
+StackDump::~StackDump() {
+
+    close_debug_file( m_debug_file );
+}
+
+
+bool StackDump::prepare() {
+
+    Clock::time_point start = Clock::now();
+
+    char path[ PATH_MAX ];
+    ssize_t length = ::readlink( ( "/proc/" + std::to_string( m_pid ) + "/exe" ).c_str(), path, sizeof( path ) - 1 );
+
+    if ( length <= 0 ) {
+
+        std::cerr << "[" << "No process " << std::dec << m_pid << "]" << std::endl;
+        return false;
+    }
+
+    m_path.assign( path, length );
+    int fd = ::open( m_path.c_str(), O_RDONLY );
+
+    if ( fd < 0 ) {
+
+        std::cerr << "[" << "Can't open " << m_path << "]" << std::endl;
+        return false;
+    }
+
+    try {
+
+        m_elf = elf::elf( elf::create_mmap_loader( fd ) );
+    }
+    catch ( std::exception& e ) {
+
+        std::cerr << "[" << "Can't read " << m_path << ": " << e.what() << "]" << std::endl;
+        return false;
+    }
+
+    m_dwarf = load_dwarf( m_elf, m_path, m_debug_file );
+    m_index.build( m_elf, m_dwarf );
+    m_unwinder.build( m_elf );
+
+    if ( m_elf.get_hdr().type == elf::et::dyn ) {
+
+        std::uint64_t entry = read_auxv_entry( m_pid, AT_ENTRY );
+        m_load_address = entry != 0 ? entry - m_elf.get_hdr().entry : 0;
+    }
+
+    // the library list is read from the running process; a library loaded in the
+    // meantime only loses its names, its frames still unwind through the frame pointer
+    std::uint64_t interp_base = read_auxv_entry( m_pid, AT_BASE );
+    const MemoryRegion* interp = interp_base != 0 ? m_address_space.find( m_pid, 1, interp_base ) : nullptr;
+
+    if ( interp != nullptr && m_modules.start( m_pid, interp_base, interp->path ) ) {
+
+        m_modules.update( m_pid );
+
+        for ( const std::shared_ptr<Module>& module : m_modules.modules() ) {
+
+            module->load();
+        }
+    }
+
+    m_prepare_ms = std::chrono::duration<double, std::milli>( Clock::now() - start ).count();
+
+    return true;
+}
+
+
+bool StackDump::wait_for_interrupt( pid_t tid ) {
+
+    while ( true ) {
+
+        int status;
+
+        if ( ::waitpid( tid, &status, __WALL ) < 0 || WIFEXITED( status ) || WIFSIGNALED( status ) ) {
+            return false;
+        }
+
+        if ( ( status >> 16 ) == PTRACE_EVENT_STOP ) {
+            return true;
+        }
+
+        // a signal raced with the interrupt: deliver it, the interrupt stays pending
+        ::ptrace( PTRACE_CONT, tid, nullptr, static_cast<long>( WSTOPSIG( status ) ) );
+    }
+}
+
+
+bool StackDump::capture() {
+
+    std::set<pid_t> seized;
+    Clock::time_point start = Clock::now();
+    std::vector<pid_t> tids = seize_all_threads( m_pid, 0, seized, true );
+
+    if ( tids.empty() ) {
+
+        std::cerr << "[" << "Can't seize process " << std::dec << m_pid << ": " << std::strerror( errno ) << "]" << std::endl;
+        return false;
+    }
+
+    for ( pid_t tid : tids ) {
+
+        if ( !wait_for_interrupt( tid ) ) {
+            continue;   // exited before it stopped
+        }
+
+        ThreadCopy copy;
+        copy.tid = tid;
+        ::ptrace( PTRACE_GETREGS, tid, nullptr, &copy.regs );
+
+        copy.stack.resize( stack_copy_size );
+        copy.stack.resize( read_process_memory( tid, copy.regs.rsp, copy.stack.data(), copy.stack.size() ) );
+
+        m_threads.push_back( std::move( copy ) );
+    }
+
+    // a thread that was in a group stop before stays in it after the detach
+    for ( pid_t tid : tids ) {
+
+        ::ptrace( PTRACE_DETACH, tid, nullptr, nullptr );
+    }
+
+    m_pause_us = std::chrono::duration<double, std::micro>( Clock::now() - start ).count();
+
+    for ( ThreadCopy& copy : m_threads ) {
+
+        copy.name = thread_name( m_pid, copy.tid );
+    }
+
+    return !m_threads.empty();
+}
+
+
+void StackDump::print( std::ostream& os ) {
+
+    Clock::time_point start = Clock::now();
+
+    auto resolve = [ this ]( std::uint64_t pc, std::uint64_t& load_address ) -> CfiUnwinder* {
+
+        Module* module = m_modules.find( pc );
+
+        if ( module == nullptr ) {
+            return nullptr;
+        }
+
+        load_address = module->load_address;
+        return &module->unwinder;
+    };
+
+    int thread_number = 0;
+
+    for ( ThreadCopy& copy : m_threads ) {
+
+        os << "Thread " << std::dec << ++thread_number << " (LWP " << copy.tid << " \"" << copy.name << "\"):" << std::endl;
+
+        StackReader stack( copy.regs.rsp, std::move( copy.stack ) );
+        int frame_number = 0;
+
+        for ( const UnwoundFrame& frame : m_unwinder.unwind( stack, copy.regs, m_load_address, max_frames, resolve ) ) {
+
+            // return addresses point past the call, look the caller up by the call itself
+            std::uint64_t adjust = frame_number == 0 ? 0 : 1;
+            const FunctionEntry* func = nullptr;
+            std::string from;
+
+            if ( Module* module = m_modules.find( frame.pc ) ) {
+
+                func = module->function_index.find( frame.pc - module->load_address - adjust );
+                from = module->path;
+            }
+            else if ( ( func = m_index.find( frame.pc - m_load_address - adjust ) ) == nullptr ) {
+
+                const MemoryRegion* region = m_address_space.find( m_pid, 1, frame.pc );
+                from = region == nullptr ? "" : region->path.empty() ? "anonymous memory" : region->path;
+            }
+
+            os << "#" << std::dec << std::left << std::setw( 3 ) << frame_number++ << std::right << "0x" << std::hex << std::setw( 16 ) << std::setfill( '0' )
+               << frame.pc << std::setfill( ' ' ) << " in " << ( func ? func->name : "??" ) << " ()";
+
+            if ( !from.empty() ) {
+                os << " from " << from;
+            }
+
+            os << std::endl;
+        }
+
+        os << std::endl;
+    }
+
+    double unwind_ms = std::chrono::duration<double, std::milli>( Clock::now() - start ).count();
+
+    os << "Process " << std::dec << m_pid << " stopped for " << std::fixed << std::setprecision( 1 ) << m_pause_us << " us ("
+       << m_threads.size() << " threads); indexes built in " << m_prepare_ms << " ms before the stop, unwound in "
+       << unwind_ms << " ms after it" << std::endl;
+
+    os.unsetf( std::ios_base::floatfield );
+}
+
+} // namespace MiniDbg
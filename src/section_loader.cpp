@@ -0,0 +1,220 @@
+#include "section_loader.hpp"
+
+#include <cstring>
+#include <zlib.h>
+
+#ifdef MINIDBG_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+
+namespace MiniDbg {
+
+
+namespace {
+
+    constexpr std::uint64_t shf_compressed = 0x800;
+    constexpr std::uint32_t elfcompress_zlib = 1;
+    constexpr std::uint32_t elfcompress_zstd = 2;
+    constexpr std::uint32_t zdebug_format = 0x100;     // "ZLIB" and a big endian size, the GNU format before SHF_COMPRESSED
+
+    constexpr std::size_t prefetch_threshold = 1 << 16;    // below this a thread costs more than it saves
+
+    // Elf64_Chdr
+    struct CompressionHeader {
+
+        std::uint32_t type;
+        std::uint32_t reserved;
+        std::uint64_t size;
+        std::uint64_t alignment;
+    };
+
+
+    bool is_prefetched( const std::string& name ) {
+
+        return name == ".debug_info" || name == ".debug_abbrev" || name == ".debug_str" || name == ".debug_line";
+    }
+
+
+    std::vector<std::uint8_t> inflate_zlib( const std::uint8_t* data, std::size_t size, std::uint64_t expanded ) {
+
+        std::vector<std::uint8_t> out( expanded );
+        uLongf length = expanded;
+
+        if ( ::uncompress( out.data(), &length, data, size ) != Z_OK || length != expanded ) {
+            return {};
+        }
+
+        return out;
+    }
+}
+
+
+std::vector<std::uint8_t> decompress_section( std::uint32_t format, const std::uint8_t* data, std::size_t size ) {
+
+    if ( format == zdebug_format ) {
+
+        if ( size < 12 || std::memcmp( data, "ZLIB", 4 ) != 0 ) {
+            return {};
+        }
+
+        std::uint64_t expanded = 0;
+
+        for ( int i = 4; i < 12; ++i ) {
+
+            expanded = ( expanded << 8 ) | data[i];
+        }
+
+        return inflate_zlib( data + 12, size - 12, expanded );
+    }
+
+    CompressionHeader header;
+
+    if ( size < sizeof( header ) ) {
+        return {};
+    }
+
+    std::memcpy( &header, data, sizeof( header ) );
+    data += sizeof( header );
+    size -= sizeof( header );
+
+    if ( header.type == elfcompress_zlib ) {
+
+        return inflate_zlib( data, size, header.size );
+    }
+
+#ifdef MINIDBG_HAVE_ZSTD
+    if ( header.type == elfcompress_zstd ) {
+
+        std::vector<std::uint8_t> out( header.size );
+        std::size_t length = ::ZSTD_decompress( out.data(), out.size(), data, size );
+
+        if ( ::ZSTD_isError( length ) || length != header.size ) {
+            return {};
+        }
+
+        return out;
+    }
+#endif
+
+    return {};
+}
+
+
+SectionLoader::SectionLoader( const elf::elf& elf ) : m_elf( elf ) {
+
+    for ( const elf::section& sec : m_elf.sections() ) {
+
+        std::string name = sec.get_name();
+        bool zdebug = name.starts_with( ".zdebug_" );
+
+        if ( ( !zdebug && !name.starts_with( ".debug_" ) ) || sec.get_hdr().type == elf::sht::nobits ) {
+            continue;
+        }
+
+        Section section;
+        section.name = zdebug ? "." + name.substr( 2 ) : name;
+        section.has_type = dwarf::elf::section_name_to_type( section.name.c_str(), &section.type );
+        section.data = static_cast<const std::uint8_t*>( sec.data() );     // libelfin maps lazily, not safe from the workers
+        section.size = sec.size();
+
+        if ( zdebug ) {
+
+            section.compressed = true;
+            section.format = zdebug_format;
+        }
+        else if ( static_cast<std::uint64_t>( sec.get_hdr().flags ) & shf_compressed ) {
+
+            section.compressed = true;
+            section.format = elfcompress_zlib;     // the header says which, decompress_section reads it
+        }
+
+        m_sections.push_back( std::move( section ) );
+    }
+}
+
+
+void SectionLoader::start( Section& section, std::launch policy ) {
+
+    std::uint32_t format = section.format;
+    const std::uint8_t* data = section.data;
+    std::size_t size = section.size;
+
+    section.contents = std::async( policy, [ format, data, size ]() { return decompress_section( format, data, size ); } ).share();
+    section.started = true;
+}
+
+
+const void* SectionLoader::load( Section& section, std::size_t& size ) {
+
+    if ( !section.compressed ) {
+
+        size = section.size;
+        return section.data;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock( m_mutex );
+
+        if ( !m_prefetched ) {
+
+            m_prefetched = true;
+
+            for ( Section& other : m_sections ) {
+
+                if ( &other != &section && other.compressed && !other.started && other.size >= prefetch_threshold && is_prefetched( other.name ) ) {
+
+                    start( other, std::launch::async );
+                }
+            }
+        }
+
+        // the one asked for expands on this thread while the workers do the rest
+        if ( !section.started ) {
+
+            start( section, std::launch::deferred );
+        }
+    }
+
+    const std::vector<std::uint8_t>& contents = section.contents.get();
+
+    size = contents.size();
+    return contents.empty() ? nullptr : contents.data();
+}
+
+
+const void* SectionLoader::load( dwarf::section_type type, std::size_t* size_out ) {
+
+    for ( Section& section : m_sections ) {
+
+        if ( section.has_type && section.type == type ) {
+
+            return load( section, *size_out );
+        }
+    }
+
+    return nullptr;
+}
+
+
+const void* SectionLoader::load( const std::string& name, std::size_t& size ) {
+
+    for ( Section& section : m_sections ) {
+
+        if ( section.name == name ) {
+
+            return load( section, size );
+        }
+    }
+
+    size = 0;
+    return nullptr;
+}
+
+
+std::shared_ptr<SectionLoader> create_section_loader( const elf::elf& elf ) {
+
+    return std::make_shared<SectionLoader>( elf );
+}
+
+} // namespace MiniDbg
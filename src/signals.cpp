@@ -0,0 +1,148 @@
+#include "signals.hpp"
+
+#include <cstring>
+#include <iomanip>
+
+
+namespace MiniDbg {
+
+
+SignalTable::SignalTable() {
+
+    for ( int signal : { SIGALRM, SIGURG, SIGCHLD, SIGWINCH, SIGIO, SIGVTALRM, SIGPROF } ) {
+
+        m_actions[ signal ] = SignalAction { false, false, true };
+    }
+
+    m_actions[ SIGINT ].pass = false;
+    m_actions[ SIGTRAP ].pass = false;
+}
+
+
+const SignalAction& SignalTable::get( int signal ) const {
+
+    static const SignalAction fallback;
+    return signal > 0 && signal < NSIG ? m_actions[ signal ] : fallback;
+}
+
+
+bool SignalTable::set( const std::vector<std::string>& args ) {
+
+    if ( args.size() < 2 ) {
+        return false;
+    }
+
+    std::vector<int> signals;
+
+    if ( args[1] == "all" ) {
+
+        // the debugger's own signals stay as they are
+        for ( int signal = 1; signal < NSIG; ++signal ) {
+
+            if ( signal != SIGINT && signal != SIGTRAP ) {
+                signals.push_back( signal );
+            }
+        }
+    }
+    else if ( int signal = signal_number( args[1] ) ) {
+
+        signals.push_back( signal );
+    }
+    else {
+
+        return false;
+    }
+
+    for ( std::size_t i = 2; i < args.size(); ++i ) {
+
+        for ( int signal : signals ) {
+
+            SignalAction& action = m_actions[ signal ];
+
+            // stopping without saying so is no use, and neither is printing what stopped
+            if ( args[i] == "stop" ) {
+                action.stop = action.print = true;
+            }
+            else if ( args[i] == "nostop" ) {
+                action.stop = false;
+            }
+            else if ( args[i] == "print" ) {
+                action.print = true;
+            }
+            else if ( args[i] == "noprint" ) {
+                action.print = action.stop = false;
+            }
+            else if ( args[i] == "pass" || args[i] == "noignore" ) {
+                action.pass = true;
+            }
+            else if ( args[i] == "nopass" || args[i] == "ignore" ) {
+                action.pass = false;
+            }
+            else {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+
+void SignalTable::print( std::ostream& out, int signal ) const {
+
+    out << std::left << std::setw( 12 ) << "Signal" << "Stop\tPrint\tPass\tDescription" << std::endl;
+
+    for ( int i = 1; i < NSIG; ++i ) {
+
+        if ( ( signal != 0 && i != signal ) || ::sigabbrev_np( i ) == nullptr ) {
+            continue;
+        }
+
+        const SignalAction& action = m_actions[i];
+
+        out << std::left << std::setw( 12 ) << signal_name( i ) << ( action.stop ? "Yes" : "No" ) << "\t" << ( action.print ? "Yes" : "No" )
+            << "\t" << ( action.pass ? "Yes" : "No" ) << "\t" << ::strsignal( i ) << std::endl;
+    }
+
+    out << std::right;
+}
+
+
+int signal_number( const std::string& name ) {
+
+    if ( !name.empty() && name.find_first_not_of( "0123456789" ) == std::string::npos ) {
+
+        int signal = std::stoi( name );
+        return signal > 0 && signal < NSIG ? signal : 0;
+    }
+
+    std::string abbrev = name.starts_with( "SIG" ) ? name.substr( 3 ) : name;
+
+    for ( int signal = 1; signal < NSIG; ++signal ) {
+
+        const char* known = ::sigabbrev_np( signal );
+
+        if ( known != nullptr && abbrev == known ) {
+            return signal;
+        }
+    }
+
+    return 0;
+}
+
+
+std::string signal_name( int signal ) {
+
+    const char* abbrev = ::sigabbrev_np( signal );
+    return abbrev != nullptr ? std::string( "SIG" ) + abbrev : std::to_string( signal );
+}
+
+
+bool is_fault_signal( const siginfo_t& info ) {
+
+    bool fault = info.si_signo == SIGSEGV || info.si_signo == SIGBUS || info.si_signo == SIGILL || info.si_signo == SIGFPE;
+
+    return fault && info.si_code > 0;   // kill() and friends use codes <= 0
+}
+
+} // namespace MiniDbg
@@ -0,0 +1,268 @@
+#include "snapshot.hpp"
+#include "memory.hpp"
+
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+
+
+namespace MiniDbg {
+
+
+namespace {
+
+    constexpr std::uint64_t page_size = 4096;
+    constexpr std::uint64_t pagemap_soft_dirty = 1ull << 55;
+    constexpr std::size_t merge_distance = 8;
+
+
+    // One pagemap entry per page of [start, end)
+    bool read_pagemap( int fd, std::uint64_t start, std::uint64_t end, std::vector<std::uint64_t>& entries ) {
+
+        entries.resize( ( end - start ) / page_size );
+
+        std::size_t size = entries.size() * sizeof( std::uint64_t );
+        ssize_t got = ::pread( fd, entries.data(), size, ( start / page_size ) * sizeof( std::uint64_t ) );
+
+        return got == static_cast<ssize_t>( size );
+    }
+
+
+    int open_proc( pid_t pid, const char* name, int flags ) {
+
+        std::string path = "/proc/" + std::to_string( pid ) + "/" + name;
+        return ::open( path.c_str(), flags );
+    }
+
+
+    void compare( std::uint64_t address, const std::uint8_t* before, const std::uint8_t* after, std::size_t size,
+                  std::vector<MemoryChange>& changes ) {
+
+        std::size_t i = 0;
+
+        while ( i < size ) {
+
+            if ( before[i] == after[i] ) {
+
+                ++i;
+                continue;
+            }
+
+            std::size_t first = i, last = i;
+
+            for ( ++i; i < size && i - last <= merge_distance; ++i ) {
+
+                if ( before[i] != after[i] ) {
+                    last = i;
+                }
+            }
+
+            changes.push_back( MemoryChange { address + first, std::vector<std::uint8_t>( before + first, before + last + 1 ),
+                                              std::vector<std::uint8_t>( after + first, after + last + 1 ) } );
+            i = last + 1;
+        }
+    }
+}
+
+
+bool MemorySnapshot::mark( pid_t pid, const std::vector<MemoryRegion>& regions, std::string& error ) {
+
+    clear();
+
+    int pagemap = open_proc( pid, "pagemap", O_RDONLY );
+    int clear_refs = open_proc( pid, "clear_refs", O_WRONLY );
+
+    if ( pagemap < 0 || clear_refs < 0 ) {
+
+        error = "Cannot open pagemap or clear_refs of process " + std::to_string( pid );
+
+        ::close( pagemap );
+        ::close( clear_refs );
+        return false;
+    }
+
+    std::vector<std::uint64_t> entries;
+
+    for ( const MemoryRegion& r : regions ) {
+
+        // [vvar] and device mappings fault on read, read-only memory cannot change under us
+        if ( !r.allows( MemoryRegion::read | MemoryRegion::write ) || r.path.starts_with( "[v" ) || r.path.starts_with( "/dev/" ) ) {
+            continue;
+        }
+
+        // every page written since the process started is soft-dirty, none at all means no support
+        if ( !m_soft_dirty && read_pagemap( pagemap, r.start, r.end, entries ) ) {
+
+            m_soft_dirty = std::any_of( entries.begin(), entries.end(), []( std::uint64_t e ) { return e & pagemap_soft_dirty; } );
+        }
+
+        m_regions.push_back( Saved { r.start, r.end, {} } );
+    }
+
+    ::close( pagemap );
+
+    bool cleared = ::write( clear_refs, "4", 1 ) == 1;
+    ::close( clear_refs );
+
+    if ( !cleared ) {
+
+        error = "Cannot clear the soft-dirty bits of process " + std::to_string( pid );
+        m_regions.clear();
+        return false;
+    }
+
+    // copied after the clear, anything written in between is compared again at worst
+    for ( Saved& saved : m_regions ) {
+
+        saved.data.resize( saved.end - saved.start );
+        saved.data.resize( read_process_memory( pid, saved.start, saved.data.data(), saved.data.size() ) );
+        saved.data.shrink_to_fit();
+    }
+
+    m_pid = pid;
+
+    return true;
+}
+
+
+bool MemorySnapshot::diff( pid_t pid, SnapshotDiff& result, std::string& error ) const {
+
+    if ( pid != m_pid ) {
+
+        error = "The snapshot is of process " + std::to_string( m_pid );
+        return false;
+    }
+
+    int pagemap = open_proc( pid, "pagemap", O_RDONLY );
+
+    if ( pagemap < 0 ) {
+
+        error = "Cannot open pagemap of process " + std::to_string( pid );
+        return false;
+    }
+
+    std::vector<std::uint64_t> entries;
+    std::vector<MemoryRange> ranges;
+    std::vector<std::pair<const Saved*, std::size_t>> origins;    // region and offset of each range
+    std::size_t total = 0;
+
+    for ( const Saved& saved : m_regions ) {
+
+        std::size_t pages = ( saved.data.size() + page_size - 1 ) / page_size;
+        result.pages += pages;
+
+        bool mapped = !m_soft_dirty || read_pagemap( pagemap, saved.start, saved.start + pages * page_size, entries );
+
+        // runs of dirty pages become one range each
+        for ( std::size_t page = 0; page < pages; ) {
+
+            bool dirty = !m_soft_dirty || ( mapped && ( entries[ page ] & pagemap_soft_dirty ) );
+
+            if ( !dirty ) {
+
+                ++page;
+                continue;
+            }
+
+            std::size_t first = page;
+
+            while ( page < pages && ( !m_soft_dirty || ( entries[ page ] & pagemap_soft_dirty ) ) ) {
+
+                ++page;
+            }
+
+            std::size_t offset = first * page_size;
+            std::size_t size = std::min( page * page_size, saved.data.size() ) - offset;
+
+            ranges.push_back( MemoryRange { saved.start + offset, nullptr, size } );
+            origins.push_back( { &saved, offset } );
+            result.dirty_pages += page - first;
+            total += size;
+        }
+    }
+
+    ::close( pagemap );
+
+    std::vector<std::uint8_t> buffer( total );
+    std::size_t at = 0;
+
+    for ( MemoryRange& range : ranges ) {
+
+        range.buffer = buffer.data() + at;
+        at += range.size;
+    }
+
+    read_process_memory_ranges( pid, ranges.data(), ranges.size() );
+
+    for ( std::size_t i = 0; i < ranges.size(); ++i ) {
+
+        // a range that is gone or shrank is compared as far as it was read
+        std::size_t size = ranges[i].ok ? ranges[i].size : read_process_memory( pid, ranges[i].address, ranges[i].buffer, ranges[i].size );
+
+        compare( ranges[i].address, origins[i].first->data.data() + origins[i].second, static_cast<const std::uint8_t*>( ranges[i].buffer ),
+                 size, result.changes );
+    }
+
+    return true;
+}
+
+
+void MemorySnapshot::clear() {
+
+    m_pid = 0;
+    m_soft_dirty = false;
+    m_regions.clear();
+}
+
+
+std::size_t MemorySnapshot::bytes() const {
+
+    std::size_t total = 0;
+
+    for ( const Saved& saved : m_regions ) {
+
+        total += saved.data.size();
+    }
+
+    return total;
+}
+
+
+void add_data_symbols( const elf::elf& elf, std::uint64_t load_address, std::vector<DataSymbol>& symbols ) {
+
+    for ( const elf::section& sec : elf.sections() ) {
+
+        if ( sec.get_hdr().type != elf::sht::symtab && sec.get_hdr().type != elf::sht::dynsym ) {
+            continue;
+        }
+
+        for ( const elf::sym& sym : sec.as_symtab() ) {
+
+            const elf::Sym<>& d = sym.get_data();
+
+            if ( d.type() == elf::stt::object && d.value != 0 ) {
+
+                symbols.push_back( DataSymbol { d.value + load_address, d.size, sym.get_name() } );
+            }
+        }
+    }
+
+    std::sort( symbols.begin(), symbols.end(), []( const DataSymbol& a, const DataSymbol& b ) { return a.address < b.address; } );
+}
+
+
+const DataSymbol* find_data_symbol( const std::vector<DataSymbol>& symbols, std::uint64_t address ) {
+
+    auto it = std::upper_bound( symbols.begin(), symbols.end(), address,
+                                []( std::uint64_t a, const DataSymbol& s ) { return a < s.address; } );
+
+    if ( it == symbols.begin() ) {
+        return nullptr;
+    }
+
+    --it;
+
+    return address < it->address + std::max<std::uint64_t>( it->size, 1 ) ? &*it : nullptr;
+}
+
+} // namespace MiniDbg
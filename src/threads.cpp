@@ -0,0 +1,23 @@
+#include "threads.hpp"
+
+
+namespace MiniDbg {
+
+
+std::string to_string( StopReason reason ) {
+
+    switch ( reason ) {
+
+        case StopReason::none: return "none";
+        case StopReason::starting: return "starting";
+        case StopReason::breakpoint: return "breakpoint";
+        case StopReason::single_step: return "single step";
+        case StopReason::signal: return "signal";
+        case StopReason::interrupted: return "interrupted";
+        case StopReason::syscall: return "syscall";
+
+        default: return "";
+    }
+}
+
+} // end namespace MiniDbg
@@ -0,0 +1,982 @@
+#include "types.hpp"
+#include "function_index.hpp"
+
+#include <cstring>
+#include <cstdio>
+
+
+namespace MiniDbg {
+
+
+namespace {
+
+    constexpr std::size_t max_string_length = 200;
+    constexpr std::size_t max_container_bytes = 1 << 24;
+    constexpr std::size_t max_tree_height = 128;      // a red-black tree of 2^64 nodes is shallower
+    constexpr int max_format_depth = 16;
+    constexpr int max_member_depth = 8;
+
+    // libstdc++ node layouts: _Rb_tree_node_base is color, parent, left, right and
+    // _List_node_base is next, prev; the element follows in the node
+    constexpr std::uint64_t rb_parent = 8;
+    constexpr std::uint64_t rb_left = 16;
+    constexpr std::uint64_t rb_right = 24;
+    constexpr std::uint64_t list_links = 16;
+
+    // DW_ATE_*
+    constexpr std::uint8_t ate_address = 0x01;
+    constexpr std::uint8_t ate_boolean = 0x02;
+    constexpr std::uint8_t ate_float = 0x04;
+    constexpr std::uint8_t ate_signed = 0x05;
+    constexpr std::uint8_t ate_signed_char = 0x06;
+    constexpr std::uint8_t ate_unsigned = 0x07;
+    constexpr std::uint8_t ate_unsigned_char = 0x08;
+
+
+    std::uint64_t load_unsigned( const std::uint8_t* data, std::size_t size ) {
+
+        std::uint64_t value = 0;
+        std::memcpy( &value, data, std::min<std::size_t>( size, sizeof( value ) ) );
+        return value;
+    }
+
+
+    std::int64_t load_signed( const std::uint8_t* data, std::size_t size ) {
+
+        std::uint64_t value = load_unsigned( data, size );
+
+        if ( size > 0 && size < 8 && ( value >> ( size * 8 - 1 ) ) & 1 ) {
+            value |= ~0ull << ( size * 8 );
+        }
+
+        return static_cast<std::int64_t>( value );
+    }
+
+
+    std::uint64_t attribute_constant( const dwarf::die& die, dwarf::DW_AT attribute, std::uint64_t fallback = 0 ) {
+
+        if ( !die.has( attribute ) ) {
+            return fallback;
+        }
+
+        dwarf::value value = die[ attribute ];
+
+        return value.get_type() == dwarf::value::type::sconstant ? static_cast<std::uint64_t>( value.as_sconstant() ) : value.as_uconstant();
+    }
+
+
+    // DWARF 2 style DW_OP_plus_uconst block, or a plain constant since DWARF 3
+    std::uint64_t member_offset( const dwarf::die& die ) {
+
+        if ( !die.has( dwarf::DW_AT::data_member_location ) ) {
+            return 0;
+        }
+
+        dwarf::value value = die[ dwarf::DW_AT::data_member_location ];
+
+        if ( value.get_type() == dwarf::value::type::block || value.get_type() == dwarf::value::type::exprloc ) {
+
+            std::size_t size;
+            const std::uint8_t* block = static_cast<const std::uint8_t*>( value.as_block( &size ) );
+
+            if ( size < 2 || block[0] != 0x23 ) {
+                return 0;
+            }
+
+            std::uint64_t offset = 0;
+            int shift = 0;
+
+            for ( std::size_t i = 1; i < size; ++i, shift += 7 ) {
+
+                offset |= static_cast<std::uint64_t>( block[i] & 0x7F ) << shift;
+
+                if ( !( block[i] & 0x80 ) ) {
+                    break;
+                }
+            }
+
+            return offset;
+        }
+
+        return attribute_constant( die, dwarf::DW_AT::data_member_location );
+    }
+
+
+    bool is_char( const TypeLayout* type ) {
+
+        return type != nullptr && type->kind == TypeKind::base && type->size == 1 &&
+               ( type->encoding == ate_signed_char || type->encoding == ate_unsigned_char );
+    }
+
+
+    void append_char( std::string& out, char c ) {
+
+        switch ( c ) {
+            case '\n': out += "\\n"; break;
+            case '\t': out += "\\t"; break;
+            case '\r': out += "\\r"; break;
+            case '"':  out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            default:
+
+                if ( c >= 0x20 && c < 0x7F ) {
+
+                    out += c;
+                }
+                else {
+
+                    char escaped[8];
+                    std::snprintf( escaped, sizeof( escaped ), "\\%03o", static_cast<unsigned char>( c ) );
+                    out += escaped;
+                }
+        }
+    }
+
+
+    void append_string( std::string& out, const char* text, std::size_t max_length ) {
+
+        out += '"';
+
+        std::size_t i = 0;
+
+        for ( ; i < max_length && text[i] != 0; ++i ) {
+            append_char( out, text[i] );
+        }
+
+        out += '"';
+
+        if ( i == max_length && max_length == max_string_length ) {
+            out += "...";
+        }
+    }
+
+
+    // Breadth first through members and base classes, offset is from the start of type
+    bool find_member( const TypeLayout& type, const std::string& name, TypeKind kind,
+                      std::uint64_t& offset, const TypeLayout*& member, int depth = 0 ) {
+
+        if ( depth > max_member_depth ) {
+            return false;
+        }
+
+        for ( const TypeLayout::Field& field : type.fields ) {
+
+            if ( field.name == name && field.type->kind == kind ) {
+
+                offset = field.offset;
+                member = field.type;
+                return true;
+            }
+        }
+
+        for ( const TypeLayout::Field& field : type.fields ) {
+
+            if ( field.type->kind == TypeKind::structure && find_member( *field.type, name, kind, offset, member, depth + 1 ) ) {
+
+                offset += field.offset;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+
+    // Type DIE of a direct member, with typedefs and qualifiers stripped
+    dwarf::die member_type( const dwarf::die& die, const std::string& name ) {
+
+        for ( const dwarf::die& child : die ) {
+
+            if ( child.tag != dwarf::DW_TAG::member || !child.has( dwarf::DW_AT::name ) || dwarf::at_name( child ) != name ||
+                 !child.has( dwarf::DW_AT::type ) ) {
+                continue;
+            }
+
+            dwarf::die type = child[ dwarf::DW_AT::type ].as_reference();
+
+            while ( ( type.tag == dwarf::DW_TAG::typedef_ || type.tag == dwarf::DW_TAG::const_type ||
+                      type.tag == dwarf::DW_TAG::volatile_type ) && type.has( dwarf::DW_AT::type ) ) {
+
+                type = type[ dwarf::DW_AT::type ].as_reference();
+            }
+
+            return type;
+        }
+
+        return dwarf::die();
+    }
+
+
+    // "class std::map<int, int, ...>" -> "std::map"
+    std::string container_name( const TypeLayout& type ) {
+
+        std::string name = type.name.substr( type.name.find( ' ' ) + 1 );
+        return "std::" + name.substr( 0, name.find( '<' ) );
+    }
+}
+
+
+const TypeLayout::Field* TypeLayout::find_field( const std::string& field_name ) const {
+
+    for ( const Field& field : fields ) {
+
+        if ( field.name == field_name ) {
+            return &field;
+        }
+    }
+
+    // members of anonymous structs and unions are reached as if they were our own
+    for ( const Field& field : fields ) {
+
+        if ( field.name.empty() && field.type->kind == TypeKind::structure && field.type->find_field( field_name ) ) {
+            return &field;
+        }
+    }
+
+    return nullptr;
+}
+
+
+void TypeCache::clear() {
+
+    m_layouts.clear();
+    m_storage.clear();
+    m_void = nullptr;
+}
+
+
+TypeLayout* TypeCache::make_layout() {
+
+    m_storage.push_back( std::make_shared<TypeLayout>() );
+    return m_storage.back().get();
+}
+
+
+const TypeLayout* TypeCache::void_type() {
+
+    if ( m_void == nullptr ) {
+
+        TypeLayout* layout = make_layout();
+        layout->name = "void";
+        m_void = layout;
+    }
+
+    return m_void;
+}
+
+
+const TypeLayout* TypeCache::resolve( const dwarf::die& die ) {
+
+    if ( !die.valid() ) {
+        return void_type();
+    }
+
+    auto it = m_layouts.find( die.get_section_offset() );
+
+    if ( it != m_layouts.end() ) {
+        return it->second;
+    }
+
+    auto referenced = [ this ]( const dwarf::die& d ) {
+
+        return d.has( dwarf::DW_AT::type ) ? resolve( d[ dwarf::DW_AT::type ].as_reference() ) : void_type();
+    };
+
+    switch ( die.tag ) {
+
+        case dwarf::DW_TAG::typedef_:
+        case dwarf::DW_TAG::const_type:
+        case dwarf::DW_TAG::volatile_type:
+        case dwarf::DW_TAG::restrict_type:
+        {
+            const TypeLayout* target = referenced( die );
+            m_layouts.emplace( die.get_section_offset(), target );
+            return target;
+        }
+        default:
+            break;
+    }
+
+    // registered before resolving what it refers to, so self-referential types terminate
+    TypeLayout* layout = make_layout();
+    m_layouts.emplace( die.get_section_offset(), layout );
+
+    layout->name = die.has( dwarf::DW_AT::name ) ? dwarf::at_name( die ) : "";
+    layout->size = attribute_constant( die, dwarf::DW_AT::byte_size );
+
+    switch ( die.tag ) {
+
+        case dwarf::DW_TAG::base_type:
+
+            layout->kind = TypeKind::base;
+            layout->encoding = static_cast<std::uint8_t>( attribute_constant( die, dwarf::DW_AT::encoding ) );
+            break;
+
+        case dwarf::DW_TAG::pointer_type:
+        case dwarf::DW_TAG::reference_type:
+        case dwarf::DW_TAG::rvalue_reference_type:
+
+            layout->kind = TypeKind::pointer;
+            layout->size = layout->size ? layout->size : sizeof( void* );
+            layout->target = referenced( die );
+            layout->name = layout->target->name + ( die.tag == dwarf::DW_TAG::pointer_type ? "*" : "&" );
+            break;
+
+        case dwarf::DW_TAG::array_type:
+
+            resolve_array( *layout, die );
+            break;
+
+        case dwarf::DW_TAG::structure_type:
+        case dwarf::DW_TAG::class_type:
+        case dwarf::DW_TAG::union_type:
+
+            resolve_structure( *layout, die );
+            break;
+
+        case dwarf::DW_TAG::enumeration_type:
+
+            layout->kind = TypeKind::enumeration;
+
+            for ( const dwarf::die& child : die ) {
+
+                if ( child.tag == dwarf::DW_TAG::enumerator ) {
+
+                    layout->enumerators.emplace_back( static_cast<std::int64_t>( attribute_constant( child, dwarf::DW_AT::const_value ) ),
+                                                      dwarf::at_name( child ) );
+                }
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    return layout;
+}
+
+
+void TypeCache::resolve_array( TypeLayout& layout, const dwarf::die& die ) {
+
+    const TypeLayout* element = die.has( dwarf::DW_AT::type ) ? resolve( die[ dwarf::DW_AT::type ].as_reference() ) : void_type();
+
+    std::vector<std::uint64_t> dimensions;
+
+    for ( const dwarf::die& child : die ) {
+
+        if ( child.tag != dwarf::DW_TAG::subrange_type ) {
+            continue;
+        }
+
+        if ( child.has( dwarf::DW_AT::count ) ) {
+
+            dimensions.push_back( attribute_constant( child, dwarf::DW_AT::count ) );
+        }
+        else if ( child.has( dwarf::DW_AT::upper_bound ) ) {
+
+            dimensions.push_back( attribute_constant( child, dwarf::DW_AT::upper_bound ) - attribute_constant( child, dwarf::DW_AT::lower_bound ) + 1 );
+        }
+        else {
+
+            dimensions.push_back( 0 );      // flexible array member
+        }
+    }
+
+    if ( dimensions.empty() ) {
+        dimensions.push_back( 0 );
+    }
+
+    // int a[2][3] is an array of 2 arrays of 3, the inner dimensions get layouts of their own
+    const TypeLayout* inner = element;
+
+    for ( std::size_t i = dimensions.size() - 1; i > 0; --i ) {
+
+        TypeLayout* dimension = make_layout();
+        dimension->kind = TypeKind::array;
+        dimension->target = inner;
+        dimension->count = dimensions[i];
+        dimension->size = inner->size * dimensions[i];
+        dimension->name = inner->name + "[" + std::to_string( dimensions[i] ) + "]";
+        inner = dimension;
+    }
+
+    layout.kind = TypeKind::array;
+    layout.target = inner;
+    layout.count = dimensions[0];
+    layout.size = inner->size * dimensions[0];
+    layout.name = inner->name + "[" + std::to_string( dimensions[0] ) + "]";
+}
+
+
+void TypeCache::resolve_structure( TypeLayout& layout, const dwarf::die& die ) {
+
+    layout.kind = TypeKind::structure;
+
+    std::string keyword = die.tag == dwarf::DW_TAG::union_type ? "union" : ( die.tag == dwarf::DW_TAG::class_type ? "class" : "struct" );
+    layout.name = layout.name.empty() ? keyword : keyword + " " + layout.name;
+
+    for ( const dwarf::die& child : die ) {
+
+        if ( child.tag != dwarf::DW_TAG::member && child.tag != dwarf::DW_TAG::inheritance ) {
+            continue;
+        }
+
+        if ( child.has( dwarf::DW_AT::external ) || child.has( dwarf::DW_AT::declaration ) ) {
+            continue;   // static data member, not part of the object
+        }
+
+        TypeLayout::Field field;
+        field.type = child.has( dwarf::DW_AT::type ) ? resolve( child[ dwarf::DW_AT::type ].as_reference() ) : void_type();
+        field.name = child.tag == dwarf::DW_TAG::inheritance ? "<" + field.type->name + ">" :
+                     ( child.has( dwarf::DW_AT::name ) ? dwarf::at_name( child ) : "" );
+        field.offset = member_offset( child );
+
+        if ( child.has( dwarf::DW_AT::bit_size ) ) {
+
+            field.bit_size = static_cast<std::uint32_t>( attribute_constant( child, dwarf::DW_AT::bit_size ) );
+
+            if ( child.has( dwarf::DW_AT::data_bit_offset ) ) {
+
+                std::uint64_t bits = attribute_constant( child, dwarf::DW_AT::data_bit_offset );
+                field.offset = bits / 8;
+                field.bit_offset = bits % 8;
+            }
+            else if ( child.has( dwarf::DW_AT::bit_offset ) ) {
+
+                // DWARF 2/3 count from the most significant bit of the storage unit
+                std::uint64_t storage = attribute_constant( child, dwarf::DW_AT::byte_size, field.type->size );
+                field.bit_offset = static_cast<std::uint32_t>( storage * 8 - attribute_constant( child, dwarf::DW_AT::bit_offset ) - field.bit_size );
+            }
+        }
+
+        layout.fields.push_back( field );
+    }
+
+    detect_container( layout, die );
+}
+
+
+void TypeCache::detect_container( TypeLayout& layout, const dwarf::die& die ) {
+
+    using Kind = TypeLayout::Container::Kind;
+
+    if ( !die.has( dwarf::DW_AT::name ) ) {
+        return;
+    }
+
+    // the name only picks the candidate, the members decide, so a lookalike stays a struct
+    std::string name = dwarf::at_name( die );
+    auto is = [ &name ]( std::initializer_list<const char*> prefixes ) {
+
+        for ( const char* prefix : prefixes ) {
+
+            if ( name.rfind( prefix, 0 ) == 0 ) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    TypeLayout::Container& c = layout.container;
+    std::uint64_t a, b;
+    const TypeLayout* ta;
+    const TypeLayout* tb;
+
+    if ( is( { "vector<" } ) ) {
+
+        if ( find_member( layout, "_M_start", TypeKind::pointer, a, ta ) && find_member( layout, "_M_finish", TypeKind::pointer, b, tb ) ) {
+
+            c.kind = Kind::vector;
+            c.start = a;
+            c.finish = b;
+            c.element = ta->target;
+        }
+    }
+    else if ( is( { "basic_string<" } ) ) {
+
+        if ( find_member( layout, "_M_p", TypeKind::pointer, a, ta ) && find_member( layout, "_M_string_length", TypeKind::base, b, tb ) &&
+             is_char( ta->target ) ) {
+
+            c.kind = Kind::string;
+            c.start = a;
+            c.count = b;
+            c.element = ta->target;
+        }
+    }
+    else if ( is( { "map<", "set<", "multimap<", "multiset<" } ) ) {
+
+        dwarf::die tree = member_type( die, "_M_t" );
+
+        if ( tree.valid() && find_member( layout, "_M_header", TypeKind::structure, a, ta ) &&
+             find_member( layout, "_M_node_count", TypeKind::base, b, tb ) ) {
+
+            c.kind = Kind::tree;
+            c.associative = is( { "map<", "multimap<" } );
+            c.start = a;
+            c.count = b;
+            c.node_value = ta->size;
+            c.element = template_type( tree, "_Val" );
+        }
+    }
+    else if ( is( { "unordered_map<", "unordered_set<", "unordered_multimap<", "unordered_multiset<" } ) ) {
+
+        dwarf::die table = member_type( die, "_M_h" );
+
+        if ( table.valid() && find_member( layout, "_M_before_begin", TypeKind::structure, a, ta ) &&
+             find_member( layout, "_M_element_count", TypeKind::base, b, tb ) ) {
+
+            c.kind = Kind::hashtable;
+            c.associative = is( { "unordered_map<", "unordered_multimap<" } );
+            c.start = a;
+            c.count = b;
+            c.node_value = ta->size;
+            c.element = template_type( table, "_Value" );
+        }
+    }
+    else if ( is( { "list<" } ) ) {
+
+        if ( find_member( layout, "_M_node", TypeKind::structure, a, ta ) && find_member( layout, "_M_size", TypeKind::base, b, tb ) ) {
+
+            c.kind = Kind::list;
+            c.start = a;
+            c.count = b;
+            c.node_value = list_links;
+            c.element = template_type( die, "_Tp" );
+        }
+    }
+    else if ( is( { "unique_ptr<" } ) ) {
+
+        // the deleter also sits in a _M_head_impl, only the pointer one is wanted
+        if ( find_member( layout, "_M_head_impl", TypeKind::pointer, a, ta ) ) {
+
+            c.kind = Kind::smart_pointer;
+            c.start = a;
+            c.element = ta->target;
+        }
+    }
+    else if ( is( { "shared_ptr<", "weak_ptr<" } ) ) {
+
+        if ( find_member( layout, "_M_ptr", TypeKind::pointer, a, ta ) ) {
+
+            c.kind = Kind::smart_pointer;
+            c.start = a;
+            c.element = ta->target;
+        }
+    }
+
+    if ( c.kind != Kind::none && ( c.element == nullptr || c.element == m_void ) && c.kind != Kind::smart_pointer ) {
+
+        c = TypeLayout::Container();    // no element layout, print the members instead
+    }
+}
+
+
+const TypeLayout* TypeCache::template_type( const dwarf::die& die, const std::string& parameter ) {
+
+    for ( const dwarf::die& child : die ) {
+
+        if ( child.tag == dwarf::DW_TAG::template_type_parameter && child.has( dwarf::DW_AT::name ) &&
+             dwarf::at_name( child ) == parameter && child.has( dwarf::DW_AT::type ) ) {
+
+            return resolve( child[ dwarf::DW_AT::type ].as_reference() );
+        }
+    }
+
+    return nullptr;
+}
+
+
+std::string TypeCache::format( const TypeLayout& type, const std::uint8_t* data, const MemoryReader& read ) const {
+
+    std::string out;
+    format_value( out, type, data, read, 0 );
+    return out;
+}
+
+
+std::string TypeCache::format( const TypeLayout::Field& field, const std::uint8_t* data, const MemoryReader& read ) const {
+
+    std::string out;
+    format_field( out, field, data, read, 0 );
+    return out;
+}
+
+
+void TypeCache::format_field( std::string& out, const TypeLayout::Field& field, const std::uint8_t* data, const MemoryReader& read, int depth ) const {
+
+    if ( field.bit_size == 0 ) {
+
+        format_value( out, *field.type, data, read, depth );
+        return;
+    }
+
+    // pull the bits out into a value of the field's own size and format that
+    std::uint64_t bits = load_unsigned( data, ( field.bit_offset + field.bit_size + 7 ) / 8 );
+    bits >>= field.bit_offset;
+
+    if ( field.bit_size < 64 ) {
+
+        bits &= ( 1ull << field.bit_size ) - 1;
+
+        bool is_signed = field.type->encoding == ate_signed || field.type->encoding == ate_signed_char;
+
+        if ( is_signed && ( bits >> ( field.bit_size - 1 ) ) & 1 ) {
+            bits |= ~0ull << field.bit_size;
+        }
+    }
+
+    std::uint8_t value[ sizeof( bits ) ];
+    std::memcpy( value, &bits, sizeof( bits ) );
+    format_value( out, *field.type, value, read, depth );
+}
+
+
+void TypeCache::format_value( std::string& out, const TypeLayout& type, const std::uint8_t* data, const MemoryReader& read, int depth ) const {
+
+    char buffer[64];
+
+    switch ( type.kind ) {
+
+        case TypeKind::base:
+
+            switch ( type.encoding ) {
+
+                case ate_boolean:
+                    out += load_unsigned( data, type.size ) ? "true" : "false";
+                    return;
+
+                case ate_float:
+
+                    if ( type.size == sizeof( float ) ) {
+
+                        float value;
+                        std::memcpy( &value, data, sizeof( value ) );
+                        std::snprintf( buffer, sizeof( buffer ), "%g", value );
+                    }
+                    else if ( type.size == sizeof( double ) ) {
+
+                        double value;
+                        std::memcpy( &value, data, sizeof( value ) );
+                        std::snprintf( buffer, sizeof( buffer ), "%.17g", value );
+                    }
+                    else {
+
+                        long double value = 0;
+                        std::memcpy( &value, data, std::min<std::size_t>( type.size, sizeof( value ) ) );
+                        std::snprintf( buffer, sizeof( buffer ), "%.21Lg", value );
+                    }
+
+                    out += buffer;
+                    return;
+
+                case ate_signed:
+                    out += std::to_string( load_signed( data, type.size ) );
+                    return;
+
+                case ate_signed_char:
+                case ate_unsigned_char:
+                {
+                    std::int64_t value = type.encoding == ate_signed_char ? load_signed( data, 1 ) : load_unsigned( data, 1 );
+                    out += std::to_string( value ) + " '";
+                    append_char( out, static_cast<char>( value ) );
+                    out += "'";
+                    return;
+                }
+                case ate_unsigned:
+                    out += std::to_string( load_unsigned( data, type.size ) );
+                    return;
+
+                case ate_address:
+                default:
+                    std::snprintf( buffer, sizeof( buffer ), "0x%llx", static_cast<unsigned long long>( load_unsigned( data, type.size ) ) );
+                    out += buffer;
+                    return;
+            }
+
+        case TypeKind::pointer:
+        {
+            std::uint64_t address = load_unsigned( data, type.size );
+            std::snprintf( buffer, sizeof( buffer ), "0x%llx", static_cast<unsigned long long>( address ) );
+            out += buffer;
+
+            if ( address != 0 && is_char( type.target ) && read ) {
+
+                char text[ max_string_length + 1 ] = {};
+                read( address, text, max_string_length );
+
+                out += ' ';
+                append_string( out, text, max_string_length );
+            }
+            return;
+        }
+
+        case TypeKind::array:
+
+            if ( is_char( type.target ) ) {
+
+                append_string( out, reinterpret_cast<const char*>( data ), std::min<std::size_t>( type.count, max_string_length ) );
+                return;
+            }
+
+            out += '{';
+
+            for ( std::uint64_t i = 0; i < type.count; ++i ) {
+
+                if ( i == m_element_limit && m_element_limit != 0 ) {
+
+                    out += "...";
+                    break;
+                }
+
+                if ( i != 0 ) {
+                    out += ", ";
+                }
+
+                format_value( out, *type.target, data + i * type.target->size, read, depth + 1 );
+            }
+
+            out += '}';
+            return;
+
+        case TypeKind::structure:
+
+            if ( depth > max_format_depth ) {
+
+                out += "{...}";
+                return;
+            }
+
+            if ( type.container.kind != TypeLayout::Container::Kind::none && read ) {
+
+                format_container( out, type, data, read, depth );
+                return;
+            }
+
+            out += '{';
+
+            for ( std::size_t i = 0; i < type.fields.size(); ++i ) {
+
+                const TypeLayout::Field& field = type.fields[i];
+
+                if ( i != 0 ) {
+                    out += ", ";
+                }
+
+                if ( !field.name.empty() ) {
+                    out += field.name + " = ";
+                }
+
+                format_field( out, field, data + field.offset, read, depth + 1 );
+            }
+
+            out += '}';
+            return;
+
+        case TypeKind::enumeration:
+        {
+            std::int64_t value = load_signed( data, type.size );
+
+            for ( const auto& [ enumerator, name ] : type.enumerators ) {
+
+                if ( enumerator == value ) {
+
+                    out += name;
+                    return;
+                }
+            }
+
+            out += std::to_string( value );
+            return;
+        }
+
+        case TypeKind::unknown:
+        default:
+
+            if ( type.size == 0 ) {
+
+                out += "<unknown type>";
+                return;
+            }
+
+            std::snprintf( buffer, sizeof( buffer ), "0x%llx", static_cast<unsigned long long>( load_unsigned( data, type.size ) ) );
+            out += buffer;
+            return;
+    }
+}
+
+
+void TypeCache::format_element( std::string& out, const TypeLayout& container, const std::uint8_t* data, const MemoryReader& read, int depth ) const {
+
+    const TypeLayout& element = *container.container.element;
+
+    // std::pair<const K, V> of a map reads better as [key] = value
+    if ( container.container.associative && element.kind == TypeKind::structure && element.fields.size() >= 2 ) {
+
+        out += '[';
+        format_field( out, element.fields[0], data + element.fields[0].offset, read, depth + 1 );
+        out += "] = ";
+        format_field( out, element.fields[1], data + element.fields[1].offset, read, depth + 1 );
+        return;
+    }
+
+    format_value( out, element, data, read, depth + 1 );
+}
+
+
+void TypeCache::format_container( std::string& out, const TypeLayout& type, const std::uint8_t* data, const MemoryReader& read, int depth ) const {
+
+    using Kind = TypeLayout::Container::Kind;
+
+    const TypeLayout::Container& c = type.container;
+    const TypeLayout& element = *c.element;
+    const std::uint64_t limit = m_element_limit ? m_element_limit : ~0ull;
+
+    std::uint64_t count = c.count ? load_unsigned( data + c.count, sizeof( std::uint64_t ) ) : 0;
+    std::uint64_t shown = 0;
+
+    auto separator = [ &out, &shown ]() {
+
+        if ( shown++ != 0 ) {
+            out += ", ";
+        }
+    };
+
+    switch ( c.kind ) {
+
+        case Kind::vector:
+        {
+            std::uint64_t begin = load_unsigned( data + c.start, sizeof( begin ) );
+            std::uint64_t end = load_unsigned( data + c.finish, sizeof( end ) );
+
+            count = element.size && end >= begin ? ( end - begin ) / element.size : 0;
+            out += container_name( type ) + " of length " + std::to_string( count ) + " = {";
+
+            // the head of the storage in one read, however long the vector is
+            std::uint64_t wanted = std::min( { count, limit, element.size ? max_container_bytes / element.size : 0 } );
+            std::vector<std::uint8_t> elements( wanted * element.size );
+            wanted = element.size ? read( begin, elements.data(), elements.size() ) / element.size : 0;
+
+            for ( std::uint64_t i = 0; i < wanted; ++i ) {
+
+                separator();
+                format_element( out, type, elements.data() + i * element.size, read, depth );
+            }
+            break;
+        }
+
+        case Kind::string:
+        {
+            std::uint64_t pointer = load_unsigned( data + c.start, sizeof( pointer ) );
+            std::vector<char> text( std::min( { count, limit, static_cast<std::uint64_t>( max_container_bytes ) } ) );
+            text.resize( read( pointer, text.data(), text.size() ) );
+
+            out += '"';
+
+            for ( char ch : text ) {
+                append_char( out, ch );
+            }
+
+            out += '"';
+
+            if ( text.size() < count ) {
+                out += "...";
+            }
+            return;
+        }
+
+        case Kind::tree:
+        {
+            out += container_name( type ) + " with " + std::to_string( count ) + " elements = {";
+
+            // in order with an explicit stack, every node read once with its element
+            std::size_t node_size = c.node_value + element.size;
+            std::vector<std::vector<std::uint8_t>> stack;
+            std::uint64_t node = load_unsigned( data + c.start + rb_parent, sizeof( node ) );
+
+            while ( shown < limit && shown < count && ( node != 0 || !stack.empty() ) ) {
+
+                while ( node != 0 && stack.size() < max_tree_height ) {
+
+                    std::vector<std::uint8_t> bytes( node_size );
+
+                    if ( read( node, bytes.data(), node_size ) != node_size ) {
+
+                        node = 0;
+                        break;
+                    }
+
+                    node = load_unsigned( bytes.data() + rb_left, sizeof( node ) );
+                    stack.push_back( std::move( bytes ) );
+                }
+
+                if ( stack.empty() ) {
+                    break;
+                }
+
+                std::vector<std::uint8_t> bytes = std::move( stack.back() );
+                stack.pop_back();
+
+                separator();
+                format_element( out, type, bytes.data() + c.node_value, read, depth );
+                node = load_unsigned( bytes.data() + rb_right, sizeof( node ) );
+            }
+            break;
+        }
+
+        case Kind::hashtable:
+        case Kind::list:
+        {
+            out += container_name( type ) + ( c.kind == Kind::list ? " of length " : " with " ) + std::to_string( count ) +
+                   ( c.kind == Kind::list ? "" : " elements" ) + " = {";
+
+            // singly linked through the first word of each node, the element count bounds the walk
+            std::size_t node_size = c.node_value + element.size;
+            std::vector<std::uint8_t> bytes( node_size );
+            std::uint64_t node = load_unsigned( data + c.start, sizeof( node ) );
+
+            while ( node != 0 && shown < limit && shown < count && read( node, bytes.data(), node_size ) == node_size ) {
+
+                separator();
+                format_element( out, type, bytes.data() + c.node_value, read, depth );
+                node = load_unsigned( bytes.data(), sizeof( node ) );
+            }
+            break;
+        }
+
+        case Kind::smart_pointer:
+        {
+            std::uint64_t pointer = load_unsigned( data + c.start, sizeof( pointer ) );
+
+            if ( pointer == 0 ) {
+
+                out += container_name( type ) + " = nullptr";
+                return;
+            }
+
+            char buffer[32];
+            std::snprintf( buffer, sizeof( buffer ), "0x%llx", static_cast<unsigned long long>( pointer ) );
+            out += container_name( type ) + " = " + buffer;
+
+            std::vector<std::uint8_t> pointee( std::min<std::uint64_t>( element.size, max_container_bytes ) );
+
+            if ( !pointee.empty() && read( pointer, pointee.data(), pointee.size() ) == pointee.size() ) {
+
+                out += " -> ";
+                format_value( out, element, pointee.data(), read, depth + 1 );
+            }
+            return;
+        }
+
+        case Kind::none:
+            return;
+    }
+
+    if ( shown < count ) {
+        out += shown ? ", ..." : "...";
+    }
+
+    out += '}';
+}
+
+
+}
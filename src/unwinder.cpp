@@ -0,0 +1,753 @@
+#include "unwinder.hpp"
+#include "memory.hpp"
+#include "dwarf_cursor.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+
+namespace MiniDbg {
+
+
+namespace {
+
+    constexpr std::size_t stack_window = 16 * 1024;
+    constexpr std::size_t max_stack_window = 1024 * 1024;
+    constexpr std::size_t max_overlapping_fdes = 4;
+
+    constexpr std::uint8_t DW_EH_PE_omit = 0xFF;
+    constexpr std::uint8_t DW_EH_PE_datarel_sdata4 = 0x3B;
+
+
+    // DW_EH_PE_* pointer, pcrel is resolved against the unrelocated address of the field
+    bool read_encoded( Cursor& c, std::uint8_t encoding, std::uint64_t field_addr, std::uint64_t data_base, std::uint64_t& out ) {
+
+        if ( encoding == DW_EH_PE_omit ) {
+            return false;
+        }
+
+        std::uint64_t value;
+
+        switch ( encoding & 0x0F ) {
+            case 0x00: value = c.fixed<std::uint64_t>(); break;
+            case 0x01: value = c.uleb(); break;
+            case 0x02: value = c.fixed<std::uint16_t>(); break;
+            case 0x03: value = c.fixed<std::uint32_t>(); break;
+            case 0x04: value = c.fixed<std::uint64_t>(); break;
+            case 0x09: value = c.sleb(); break;
+            case 0x0A: value = static_cast<std::int64_t>( c.fixed<std::int16_t>() ); break;
+            case 0x0B: value = static_cast<std::int64_t>( c.fixed<std::int32_t>() ); break;
+            case 0x0C: value = c.fixed<std::uint64_t>(); break;
+            default: return false;
+        }
+
+        switch ( encoding & 0x70 ) {
+            case 0x00: break;
+            case 0x10: value += field_addr; break;
+            case 0x30: value += data_base; break;
+            default: return false;
+        }
+
+        out = value;
+        return c.ok;
+    }
+
+
+    void set_rule( UnwindRow& row, std::uint64_t reg, RegisterRule::Kind kind, std::int64_t value ) {
+
+        if ( reg < n_unwind_registers ) {      // vector registers and such are not tracked
+
+            row.rules[ reg ] = RegisterRule { kind, value };
+        }
+    }
+}
+
+
+std::array<std::uint64_t, n_unwind_registers> dwarf_registers( const user_regs_struct& regs ) {
+
+    return { regs.rax, regs.rdx, regs.rcx, regs.rbx, regs.rsi, regs.rdi, regs.rbp, regs.rsp,
+             regs.r8, regs.r9, regs.r10, regs.r11, regs.r12, regs.r13, regs.r14, regs.r15, regs.rip };
+}
+
+
+bool StackReader::read( std::uint64_t address, std::uint64_t& value ) {
+
+    if ( m_pid == 0 ) {
+
+        if ( address < m_base || address - m_base + sizeof( value ) > m_data.size() ) {
+            return false;
+        }
+
+        std::memcpy( &value, m_data.data() + ( address - m_base ), sizeof( value ) );
+        return true;
+    }
+
+    if ( address >= m_base && address - m_base < max_stack_window ) {
+
+        std::size_t needed = address - m_base + sizeof( value );
+
+        if ( needed > m_data.size() ) {
+
+            std::size_t old_size = m_data.size();
+            std::size_t new_size = std::max( { needed, old_size * 2, stack_window } );
+
+            m_data.resize( new_size );
+            std::size_t got = read_process_memory( m_pid, m_base + old_size, m_data.data() + old_size, new_size - old_size );
+            m_data.resize( old_size + got );
+        }
+
+        if ( needed <= m_data.size() ) {
+
+            std::memcpy( &value, m_data.data() + ( address - m_base ), sizeof( value ) );
+            return true;
+        }
+    }
+
+    return read_process_memory( m_pid, address, &value, sizeof( value ) ) == sizeof( value );
+}
+
+
+void CfiUnwinder::clear() {
+
+    m_elf = elf::elf();
+    m_eh_frame = Section();
+    m_debug_frame = Section();
+    m_hdr_addr = 0;
+    m_hdr_table = nullptr;
+    m_hdr_count = 0;
+    m_fdes.clear();
+    m_cies.clear();
+    m_rows.clear();
+}
+
+
+void CfiUnwinder::build( const elf::elf& elf ) {
+
+    clear();
+    m_elf = elf;
+
+    Section hdr;
+
+    for ( const elf::section& sec : elf.sections() ) {
+
+        Section* target = nullptr;
+        const std::string name = sec.get_name();
+
+        if ( name == ".eh_frame" ) {
+            target = &m_eh_frame;
+        }
+        else if ( name == ".eh_frame_hdr" ) {
+            target = &hdr;
+        }
+        else if ( name == ".debug_frame" ) {
+            target = &m_debug_frame;
+        }
+
+        // a compressed .debug_frame (SHF_COMPRESSED) is left alone, .eh_frame never is
+        if ( target == nullptr || sec.get_hdr().type == elf::sht::nobits || ( static_cast<std::uint64_t>( sec.get_hdr().flags ) & 0x800 ) ) {
+            continue;
+        }
+
+        target->data = static_cast<const std::uint8_t*>( sec.data() );
+        target->size = sec.size();
+        target->addr = sec.get_hdr().addr;
+    }
+
+    m_debug_frame.is_eh = false;
+
+    if ( hdr.data != nullptr && m_eh_frame.data != nullptr ) {
+
+        Cursor c( hdr.data, hdr.data + hdr.size );
+
+        std::uint8_t version = c.fixed<std::uint8_t>();
+        std::uint8_t eh_frame_ptr_enc = c.fixed<std::uint8_t>();
+        std::uint8_t fde_count_enc = c.fixed<std::uint8_t>();
+        std::uint8_t table_enc = c.fixed<std::uint8_t>();
+
+        std::uint64_t eh_frame_ptr = 0;
+        std::uint64_t fde_count = 0;
+
+        if ( version == 1 &&
+             read_encoded( c, eh_frame_ptr_enc, hdr.addr + ( c.p - hdr.data ), hdr.addr, eh_frame_ptr ) &&
+             read_encoded( c, fde_count_enc, hdr.addr + ( c.p - hdr.data ), hdr.addr, fde_count ) &&
+             table_enc == DW_EH_PE_datarel_sdata4 &&     // fixed size entries, the only thing one can bisect
+             static_cast<std::uint64_t>( c.end - c.p ) >= fde_count * 8 ) {
+
+            m_hdr_addr = hdr.addr;
+            m_hdr_table = c.p;
+            m_hdr_count = fde_count;
+        }
+    }
+
+    if ( m_hdr_table == nullptr && m_eh_frame.data != nullptr ) {
+
+        index_section( m_eh_frame );
+    }
+
+    if ( m_debug_frame.data != nullptr ) {
+
+        index_section( m_debug_frame );
+    }
+
+    std::sort( m_fdes.begin(), m_fdes.end(), []( const FdeEntry& a, const FdeEntry& b ) { return a.low < b.low; } );
+}
+
+
+void CfiUnwinder::index_section( const Section& section ) {
+
+    std::size_t offset = 0;
+
+    while ( offset + 4 <= section.size ) {
+
+        Cursor c( section.data + offset, section.data + section.size );
+
+        std::uint64_t length = c.fixed<std::uint32_t>();
+
+        if ( length == 0xFFFFFFFF ) {
+            length = c.fixed<std::uint64_t>();
+        }
+
+        if ( length == 0 || !c.ok ) {
+            break;      // terminator
+        }
+
+        std::size_t next = ( c.p - section.data ) + length;
+
+        Fde fde;
+
+        if ( parse_fde( section, offset, fde ) && fde.low < fde.high ) {
+
+            m_fdes.push_back( FdeEntry { fde.low, section.is_eh, offset } );
+        }
+
+        offset = next;
+    }
+}
+
+
+const CfiUnwinder::Cie* CfiUnwinder::get_cie( const Section& section, const std::uint8_t* entry ) {
+
+    auto it = m_cies.find( entry );
+
+    if ( it != m_cies.end() ) {
+        return &it->second;
+    }
+
+    if ( entry < section.data || entry >= section.data + section.size ) {
+        return nullptr;
+    }
+
+    Cursor c( entry, section.data + section.size );
+
+    std::uint64_t length = c.fixed<std::uint32_t>();
+    bool is64 = length == 0xFFFFFFFF;
+
+    if ( is64 ) {
+        length = c.fixed<std::uint64_t>();
+    }
+
+    if ( !c.ok || length > static_cast<std::uint64_t>( c.end - c.p ) ) {
+        return nullptr;
+    }
+
+    Cie cie;
+    cie.end = c.p + length;
+    c.end = cie.end;
+    c.skip( is64 ? 8 : 4 );     // CIE id
+
+    std::uint8_t version = c.fixed<std::uint8_t>();
+
+    std::string augmentation;
+
+    while ( c.more() && *c.p != 0 ) {
+        augmentation += static_cast<char>( *c.p++ );
+    }
+
+    c.skip( 1 );
+
+    if ( augmentation.find( "eh" ) != std::string::npos ) {
+        c.skip( 8 );
+    }
+
+    if ( !section.is_eh && version >= 4 ) {
+        c.skip( 2 );    // address_size, segment_selector_size
+    }
+
+    cie.code_align = c.uleb();
+    cie.data_align = c.sleb();
+    cie.ra_column = version == 1 ? c.fixed<std::uint8_t>() : static_cast<int>( c.uleb() );
+
+    if ( !augmentation.empty() && augmentation[0] == 'z' ) {
+
+        cie.has_augmentation_data = true;
+
+        std::uint64_t size = c.uleb();
+        const std::uint8_t* data_end = c.p + std::min<std::uint64_t>( size, c.end - c.p );
+
+        for ( std::size_t i = 1; i < augmentation.size() && c.ok; ++i ) {
+
+            switch ( augmentation[i] ) {
+
+                case 'R':
+                    cie.fde_encoding = c.fixed<std::uint8_t>();
+                    break;
+
+                case 'L':
+                    c.skip( 1 );
+                    break;
+
+                case 'P':
+                {
+                    std::uint8_t encoding = c.fixed<std::uint8_t>();
+                    std::uint64_t personality;
+                    read_encoded( c, encoding & 0x7F, 0, 0, personality );
+                    break;
+                }
+                default:
+                    break;      // 'S' signal frame, 'B' ... carry no data
+            }
+        }
+
+        c.p = data_end;
+    }
+    else if ( !augmentation.empty() ) {
+
+        return nullptr;     // unknown augmentation without a size, cannot find the instructions
+    }
+
+    if ( !c.ok ) {
+        return nullptr;
+    }
+
+    cie.instructions = c.p;
+
+    return &m_cies.emplace( entry, cie ).first->second;
+}
+
+
+bool CfiUnwinder::parse_fde( const Section& section, std::size_t offset, Fde& fde ) {
+
+    Cursor c( section.data + offset, section.data + section.size );
+
+    std::uint64_t length = c.fixed<std::uint32_t>();
+    bool is64 = length == 0xFFFFFFFF;
+
+    if ( is64 ) {
+        length = c.fixed<std::uint64_t>();
+    }
+
+    if ( !c.ok || length == 0 || length > static_cast<std::uint64_t>( c.end - c.p ) ) {
+        return false;
+    }
+
+    const std::uint8_t* id_field = c.p;
+    c.end = c.p + length;
+
+    std::uint64_t id = is64 ? c.fixed<std::uint64_t>() : c.fixed<std::uint32_t>();
+
+    if ( section.is_eh ? id == 0 : id == ( is64 ? ~0ull : 0xFFFFFFFFull ) ) {
+        return false;   // a CIE
+    }
+
+    // .eh_frame points back from the id field, .debug_frame gives a section offset
+    const std::uint8_t* cie_entry = section.is_eh ? id_field - id : section.data + id;
+
+    fde.cie = get_cie( section, cie_entry );
+    fde.is_eh = section.is_eh;
+
+    if ( fde.cie == nullptr ) {
+        return false;
+    }
+
+    std::uint8_t encoding = section.is_eh ? fde.cie->fde_encoding : 0x00;
+    std::uint64_t range;
+
+    if ( !read_encoded( c, encoding, section.addr + ( c.p - section.data ), 0, fde.low ) ||
+         !read_encoded( c, encoding & 0x0F, 0, 0, range ) ) {
+        return false;
+    }
+
+    fde.high = fde.low + range;
+
+    if ( fde.cie->has_augmentation_data ) {
+        c.skip( c.uleb() );
+    }
+
+    fde.instructions = c.p;
+    fde.end = c.end;
+
+    return c.ok;
+}
+
+
+bool CfiUnwinder::find_fde( std::uint64_t pc, Fde& fde ) {
+
+    if ( m_hdr_table != nullptr ) {
+
+        // sorted (initial location, FDE address) pairs, both relative to the start of .eh_frame_hdr
+        auto entry = [ this ]( std::size_t i, int field ) {
+
+            std::int32_t value;
+            std::memcpy( &value, m_hdr_table + i * 8 + field * 4, sizeof( value ) );
+            return m_hdr_addr + static_cast<std::int64_t>( value );
+        };
+
+        std::size_t lo = 0;
+        std::size_t hi = m_hdr_count;
+
+        while ( lo < hi ) {
+
+            std::size_t mid = lo + ( hi - lo ) / 2;
+
+            if ( entry( mid, 0 ) <= pc ) {
+                lo = mid + 1;
+            }
+            else {
+                hi = mid;
+            }
+        }
+
+        if ( lo > 0 ) {
+
+            std::uint64_t fde_addr = entry( lo - 1, 1 );
+
+            if ( fde_addr >= m_eh_frame.addr && fde_addr < m_eh_frame.addr + m_eh_frame.size &&
+                 parse_fde( m_eh_frame, fde_addr - m_eh_frame.addr, fde ) && pc < fde.high ) {
+                return true;
+            }
+        }
+    }
+
+    auto it = std::upper_bound( m_fdes.begin(), m_fdes.end(), pc,
+                                []( std::uint64_t value, const FdeEntry& e ) { return value < e.low; } );
+
+    // .eh_frame and .debug_frame may both describe a function, look at a few candidates
+    for ( std::size_t i = 0; i < max_overlapping_fdes && it != m_fdes.begin(); ++i ) {
+
+        --it;
+
+        if ( parse_fde( it->is_eh ? m_eh_frame : m_debug_frame, it->offset, fde ) && pc >= fde.low && pc < fde.high ) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+bool CfiUnwinder::execute( const Section& section, const Fde& fde, const std::uint8_t* begin, const std::uint8_t* end,
+                           std::uint64_t pc, UnwindRow& row, const UnwindRow& initial ) {
+
+    using Kind = RegisterRule::Kind;
+
+    const Cie& cie = *fde.cie;
+    Cursor c( begin, end );
+    std::uint64_t loc = fde.low;
+    std::vector<UnwindRow> remembered;
+
+    auto advance = [ & ]( std::uint64_t delta ) {
+
+        loc += delta * cie.code_align;
+        return loc <= pc;
+    };
+
+    while ( c.more() ) {
+
+        std::uint8_t op = c.fixed<std::uint8_t>();
+        std::uint8_t operand = op & 0x3F;
+
+        switch ( op & 0xC0 ) {
+
+            case 0x40:
+                if ( !advance( operand ) ) return true;
+                continue;
+
+            case 0x80:
+                set_rule( row, operand, Kind::offset, static_cast<std::int64_t>( c.uleb() ) * cie.data_align );
+                continue;
+
+            case 0xC0:
+                if ( operand < n_unwind_registers ) row.rules[ operand ] = initial.rules[ operand ];
+                continue;
+
+            default:
+                break;
+        }
+
+        switch ( op ) {
+
+            case 0x00:      // nop
+                break;
+
+            case 0x01:      // set_loc
+            {
+                std::uint8_t encoding = section.is_eh ? cie.fde_encoding : 0x00;
+
+                if ( !read_encoded( c, encoding, section.addr + ( c.p - section.data ), 0, loc ) ) return false;
+                if ( loc > pc ) return true;
+                break;
+            }
+            case 0x02:
+                if ( !advance( c.fixed<std::uint8_t>() ) ) return true;
+                break;
+
+            case 0x03:
+                if ( !advance( c.fixed<std::uint16_t>() ) ) return true;
+                break;
+
+            case 0x04:
+                if ( !advance( c.fixed<std::uint32_t>() ) ) return true;
+                break;
+
+            case 0x05:      // offset_extended
+            {
+                std::uint64_t reg = c.uleb();
+                set_rule( row, reg, Kind::offset, static_cast<std::int64_t>( c.uleb() ) * cie.data_align );
+                break;
+            }
+            case 0x06:      // restore_extended
+            {
+                std::uint64_t reg = c.uleb();
+                if ( reg < n_unwind_registers ) row.rules[ reg ] = initial.rules[ reg ];
+                break;
+            }
+            case 0x07:
+                set_rule( row, c.uleb(), Kind::undefined, 0 );
+                break;
+
+            case 0x08:
+                set_rule( row, c.uleb(), Kind::same_value, 0 );
+                break;
+
+            case 0x09:      // register
+            {
+                std::uint64_t reg = c.uleb();
+                std::uint64_t from = c.uleb();
+                set_rule( row, reg, from < n_unwind_registers ? Kind::reg : Kind::undefined, static_cast<std::int64_t>( from ) );
+                break;
+            }
+            case 0x0A:
+                remembered.push_back( row );
+                break;
+
+            case 0x0B:
+                if ( remembered.empty() ) return false;
+                row = remembered.back();
+                remembered.pop_back();
+                break;
+
+            case 0x0C:      // def_cfa
+                row.cfa_register = static_cast<int>( c.uleb() );
+                row.cfa_offset = static_cast<std::int64_t>( c.uleb() );
+                row.cfa_expression = false;
+                break;
+
+            case 0x0D:
+                row.cfa_register = static_cast<int>( c.uleb() );
+                row.cfa_expression = false;
+                break;
+
+            case 0x0E:
+                row.cfa_offset = static_cast<std::int64_t>( c.uleb() );
+                break;
+
+            case 0x0F:      // def_cfa_expression
+                c.skip( c.uleb() );
+                row.cfa_expression = true;
+                break;
+
+            case 0x10:      // expression
+            case 0x16:      // val_expression
+            {
+                std::uint64_t reg = c.uleb();
+                c.skip( c.uleb() );
+                set_rule( row, reg, Kind::expression, 0 );
+                break;
+            }
+            case 0x11:      // offset_extended_sf
+            {
+                std::uint64_t reg = c.uleb();
+                set_rule( row, reg, Kind::offset, c.sleb() * cie.data_align );
+                break;
+            }
+            case 0x12:      // def_cfa_sf
+                row.cfa_register = static_cast<int>( c.uleb() );
+                row.cfa_offset = c.sleb() * cie.data_align;
+                row.cfa_expression = false;
+                break;
+
+            case 0x13:
+                row.cfa_offset = c.sleb() * cie.data_align;
+                break;
+
+            case 0x14:      // val_offset
+            {
+                std::uint64_t reg = c.uleb();
+                set_rule( row, reg, Kind::val_offset, static_cast<std::int64_t>( c.uleb() ) * cie.data_align );
+                break;
+            }
+            case 0x15:      // val_offset_sf
+            {
+                std::uint64_t reg = c.uleb();
+                set_rule( row, reg, Kind::val_offset, c.sleb() * cie.data_align );
+                break;
+            }
+            case 0x2E:      // GNU_args_size
+                c.uleb();
+                break;
+
+            case 0x2F:      // GNU_negative_offset_extended
+            {
+                std::uint64_t reg = c.uleb();
+                set_rule( row, reg, Kind::offset, -static_cast<std::int64_t>( c.uleb() ) * cie.data_align );
+                break;
+            }
+            default:
+                return false;
+        }
+    }
+
+    return c.ok;
+}
+
+
+const UnwindRow& CfiUnwinder::find_row( std::uint64_t pc ) {
+
+    auto it = m_rows.find( pc );
+
+    if ( it != m_rows.end() ) {
+        return it->second;
+    }
+
+    UnwindRow row;
+    Fde fde;
+
+    if ( find_fde( pc, fde ) && fde.cie->ra_column == return_address_column ) {
+
+        const Section& section = fde.is_eh ? m_eh_frame : m_debug_frame;
+
+        UnwindRow initial;
+        initial.valid = true;
+
+        if ( execute( section, fde, fde.cie->instructions, fde.cie->end, ~0ull, initial, initial ) ) {
+
+            row = initial;
+            row.valid = execute( section, fde, fde.instructions, fde.end, pc, row, initial );
+        }
+    }
+
+    return m_rows.emplace( pc, row ).first->second;
+}
+
+
+std::vector<UnwoundFrame> CfiUnwinder::unwind( pid_t pid, const user_regs_struct& user_regs, std::uint64_t load_address, std::size_t max_frames,
+                                                const UnwinderResolver& resolve ) {
+
+    StackReader stack( pid, user_regs.rsp );
+    return unwind( stack, user_regs, load_address, max_frames, resolve );
+}
+
+
+std::vector<UnwoundFrame> CfiUnwinder::unwind( StackReader& stack, const user_regs_struct& user_regs, std::uint64_t load_address, std::size_t max_frames,
+                                                const UnwinderResolver& resolve ) {
+
+    using Kind = RegisterRule::Kind;
+
+    std::vector<UnwoundFrame> frames;
+
+    std::array<std::uint64_t, n_unwind_registers> regs = dwarf_registers( user_regs );
+    std::array<bool, n_unwind_registers> known;
+    known.fill( true );
+
+    while ( frames.size() < max_frames ) {
+
+        std::uint64_t pc = regs[ return_address_column ];
+        std::uint64_t sp = regs[ 7 ];
+
+        std::uint64_t base = load_address;
+        CfiUnwinder* unwinder = resolve ? resolve( pc, base ) : nullptr;
+
+        if ( unwinder == nullptr ) {
+
+            unwinder = this;
+            base = load_address;
+        }
+
+        // a return address points after the call, which may be the last byte of the function
+        std::uint64_t lookup = pc - base - ( frames.empty() ? 0 : 1 );
+        const UnwindRow& row = unwinder->find_row( lookup );
+
+        std::array<std::uint64_t, n_unwind_registers> caller = regs;
+        std::array<bool, n_unwind_registers> caller_known = known;
+        std::uint64_t cfa;
+
+        if ( row.valid && !row.cfa_expression && row.cfa_register < n_unwind_registers && known[ row.cfa_register ] ) {
+
+            cfa = regs[ row.cfa_register ] + row.cfa_offset;
+
+            for ( int r = 0; r < n_unwind_registers; ++r ) {
+
+                const RegisterRule& rule = row.rules[ r ];
+
+                switch ( rule.kind ) {
+
+                    case Kind::same_value:
+                        break;
+
+                    case Kind::offset:
+                        caller_known[ r ] = stack.read( cfa + rule.value, caller[ r ] );
+                        break;
+
+                    case Kind::val_offset:
+                        caller[ r ] = cfa + rule.value;
+                        break;
+
+                    case Kind::reg:
+                        caller[ r ] = regs[ rule.value ];
+                        caller_known[ r ] = known[ rule.value ];
+                        break;
+
+                    case Kind::undefined:
+                    case Kind::expression:
+                        caller_known[ r ] = false;
+                        break;
+                }
+            }
+        }
+        else {
+
+            // no usable CFI for this pc, try the frame pointer chain
+            std::uint64_t saved_rbp;
+
+            if ( !known[ 6 ] || regs[ 6 ] == 0 || !stack.read( regs[ 6 ], saved_rbp ) ||
+                 !stack.read( regs[ 6 ] + 8, caller[ return_address_column ] ) ) {
+
+                frames.push_back( UnwoundFrame { pc, 0 } );
+                break;
+            }
+
+            cfa = regs[ 6 ] + 16;
+            caller[ 6 ] = saved_rbp;
+            caller_known[ return_address_column ] = true;
+        }
+
+        frames.push_back( UnwoundFrame { pc, cfa } );
+
+        caller[ 7 ] = cfa;
+        caller_known[ 7 ] = true;
+
+        // the outermost frame leaves the return address undefined, a stack that does not grow up means garbage
+        if ( !caller_known[ return_address_column ] || caller[ return_address_column ] == 0 || cfa <= sp ) {
+            break;
+        }
+
+        regs = caller;
+        known = caller_known;
+    }
+
+    return frames;
+}
+
+
+}
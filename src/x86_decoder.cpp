@@ -0,0 +1,346 @@
+#include "x86_decoder.hpp"
+
+
+namespace MiniDbg {
+
+
+namespace {
+
+    constexpr std::size_t max_instruction_length = 15;
+
+
+    bool is_legacy_prefix( std::uint8_t b ) {
+
+        switch ( b ) {
+            case 0x26: case 0x2E: case 0x36: case 0x3E: case 0x64: case 0x65:
+            case 0x66: case 0x67: case 0xF0: case 0xF2: case 0xF3:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+
+    bool is_invalid_in_64bit( std::uint8_t op ) {
+
+        switch ( op ) {
+            case 0x06: case 0x07: case 0x0E: case 0x16: case 0x17: case 0x1E: case 0x1F:
+            case 0x27: case 0x2F: case 0x37: case 0x3F: case 0x60: case 0x61: case 0x82:
+            case 0x9A: case 0xD4: case 0xD5: case 0xD6: case 0xEA:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+
+    bool has_modrm_one_byte( std::uint8_t op ) {
+
+        if ( op < 0x40 ) {
+            return ( op & 0x07 ) < 4;
+        }
+
+        if ( op >= 0x80 && op <= 0x8F ) {
+            return true;
+        }
+
+        if ( ( op >= 0xD0 && op <= 0xD3 ) || ( op >= 0xD8 && op <= 0xDF ) ) {
+            return true;
+        }
+
+        switch ( op ) {
+            case 0x63: case 0x69: case 0x6B: case 0xC0: case 0xC1: case 0xC6: case 0xC7:
+            case 0xF6: case 0xF7: case 0xFE: case 0xFF:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+
+    std::size_t immediate_one_byte( std::uint8_t op, int reg, bool opsize16, bool addr32, bool rex_w ) {
+
+        std::size_t z = opsize16 ? 2 : 4;
+
+        if ( op < 0x40 ) {
+
+            switch ( op & 0x07 ) {
+                case 4: return 1;
+                case 5: return z;
+                default: return 0;
+            }
+        }
+
+        if ( ( op >= 0x70 && op <= 0x7F ) || ( op >= 0xB0 && op <= 0xB7 ) || ( op >= 0xE0 && op <= 0xE7 ) ) {
+            return 1;
+        }
+
+        if ( op >= 0xB8 && op <= 0xBF ) {
+            return rex_w ? 8 : z;
+        }
+
+        if ( op >= 0xA0 && op <= 0xA3 ) {
+            return addr32 ? 4 : 8;      // moffs
+        }
+
+        switch ( op ) {
+            case 0x6A: case 0x6B: case 0x80: case 0x83: case 0xA8: case 0xC0: case 0xC1:
+            case 0xC6: case 0xEB:
+                return 1;
+            case 0x68: case 0x69: case 0x81: case 0xA9: case 0xC7:
+                return z;
+            case 0xE8: case 0xE9:
+                return 4;
+            case 0xC2: case 0xCA:
+                return 2;
+            case 0xC8:
+                return 3;
+            case 0xF6:
+                return reg < 2 ? 1 : 0;
+            case 0xF7:
+                return reg < 2 ? z : 0;
+            default:
+                return 0;
+        }
+    }
+
+
+    bool has_modrm_two_byte( std::uint8_t op ) {
+
+        if ( ( op >= 0x30 && op <= 0x37 ) || ( op >= 0x80 && op <= 0x8F ) || ( op >= 0xC8 && op <= 0xCF ) ) {
+            return false;
+        }
+
+        switch ( op ) {
+            case 0x05: case 0x06: case 0x07: case 0x08: case 0x09: case 0x0B: case 0x0E:
+            case 0x77: case 0xA0: case 0xA1: case 0xA2: case 0xA8: case 0xA9: case 0xAA:
+                return false;
+            default:
+                return true;
+        }
+    }
+
+
+    std::size_t immediate_two_byte( std::uint8_t op ) {
+
+        if ( op >= 0x80 && op <= 0x8F ) {
+            return 4;
+        }
+
+        if ( op >= 0x70 && op <= 0x73 ) {
+            return 1;
+        }
+
+        switch ( op ) {
+            case 0xA4: case 0xAC: case 0xBA: case 0xC2: case 0xC4: case 0xC5: case 0xC6:
+                return 1;
+            default:
+                return 0;
+        }
+    }
+
+
+    // Skips ModRM, SIB and displacement, returns false if they run past the buffer
+    bool decode_modrm( const std::uint8_t* code, std::size_t size, std::size_t& i, int& reg, Instruction& insn ) {
+
+        if ( i >= size ) {
+            return false;
+        }
+
+        std::uint8_t modrm = code[ i++ ];
+        int mod = modrm >> 6;
+        int rm = modrm & 0x07;
+        reg = ( modrm >> 3 ) & 0x07;
+
+        std::size_t disp = 0;
+
+        if ( mod != 3 ) {
+
+            if ( rm == 4 ) {
+
+                if ( i >= size ) {
+                    return false;
+                }
+
+                std::uint8_t sib = code[ i++ ];
+
+                if ( mod == 0 && ( sib & 0x07 ) == 5 ) {
+                    disp = 4;
+                }
+            }
+            else if ( mod == 0 && rm == 5 ) {
+
+                insn.rip_disp_offset = static_cast<int>( i );
+                disp = 4;
+            }
+
+            if ( mod == 1 ) {
+                disp = 1;
+            }
+            else if ( mod == 2 ) {
+                disp = 4;
+            }
+        }
+
+        i += disp;
+        return i <= size;
+    }
+}
+
+
+bool decode_instruction( const std::uint8_t* code, std::size_t size, Instruction& insn ) {
+
+    insn = Instruction();
+
+    if ( size > max_instruction_length ) {
+        size = max_instruction_length;
+    }
+
+    std::size_t i = 0;
+    bool opsize16 = false;
+    bool addr32 = false;
+    std::uint8_t rex = 0;
+
+    while ( i < size ) {
+
+        std::uint8_t b = code[ i ];
+
+        if ( is_legacy_prefix( b ) ) {
+
+            opsize16 |= b == 0x66;
+            addr32 |= b == 0x67;
+            rex = 0;            // REX only counts right before the opcode
+            ++i;
+        }
+        else if ( ( b & 0xF0 ) == 0x40 ) {
+
+            rex = b;
+            ++i;
+        }
+        else {
+            break;
+        }
+    }
+
+    if ( i >= size ) {
+        return false;
+    }
+
+    bool rex_w = rex & 0x08;
+    std::uint8_t op = code[ i++ ];
+    int reg = 0;
+    std::size_t immediate = 0;
+
+    if ( op == 0xC4 || op == 0xC5 || op == 0x62 ) {
+
+        // VEX/EVEX: the payload selects the opcode map, every instruction but vzeroupper/vzeroall has ModRM
+        std::size_t payload = op == 0xC5 ? 1 : ( op == 0xC4 ? 2 : 3 );
+
+        if ( i + payload >= size ) {
+            return false;
+        }
+
+        int map = op == 0xC5 ? 1 : ( code[ i ] & ( op == 0xC4 ? 0x1F : 0x07 ) );
+        i += payload;
+
+        std::uint8_t vex_op = code[ i++ ];
+
+        if ( !( map == 1 && vex_op == 0x77 ) && !decode_modrm( code, size, i, reg, insn ) ) {
+            return false;
+        }
+
+        if ( map == 3 || ( map == 1 && immediate_two_byte( vex_op ) == 1 ) ) {
+            immediate = 1;
+        }
+    }
+    else if ( op == 0x0F ) {
+
+        if ( i >= size ) {
+            return false;
+        }
+
+        std::uint8_t op2 = code[ i++ ];
+
+        switch ( op2 ) {
+
+            case 0x05: case 0x07: case 0x0F: case 0x34: case 0x35:
+                return false;   // syscall, sysret, 3DNow!, sysenter, sysexit
+
+            case 0x38:
+            case 0x3A:
+
+                if ( i >= size ) {
+                    return false;
+                }
+
+                ++i;
+                immediate = op2 == 0x3A ? 1 : 0;
+
+                if ( !decode_modrm( code, size, i, reg, insn ) ) {
+                    return false;
+                }
+                break;
+
+            default:
+
+                if ( has_modrm_two_byte( op2 ) && !decode_modrm( code, size, i, reg, insn ) ) {
+                    return false;
+                }
+
+                immediate = immediate_two_byte( op2 );
+
+                if ( op2 >= 0x80 && op2 <= 0x8F ) {
+                    insn.flow = ControlFlow::relative_jump;
+                }
+                break;
+        }
+    }
+    else {
+
+        switch ( op ) {
+            case 0xCC: case 0xCD: case 0xCE: case 0xF1: case 0xF4:
+                return false;   // int3, int n, into, int1, hlt
+            default:
+                break;
+        }
+
+        if ( is_invalid_in_64bit( op ) ) {
+            return false;
+        }
+
+        if ( has_modrm_one_byte( op ) && !decode_modrm( code, size, i, reg, insn ) ) {
+            return false;
+        }
+
+        immediate = immediate_one_byte( op, reg, opsize16, addr32, rex_w );
+
+        if ( ( op >= 0x70 && op <= 0x7F ) || ( op >= 0xE0 && op <= 0xE3 ) || op == 0xE9 || op == 0xEB ) {
+
+            insn.flow = ControlFlow::relative_jump;
+        }
+        else if ( op == 0xE8 ) {
+
+            insn.flow = ControlFlow::relative_call;
+        }
+        else if ( op == 0xFF && ( reg == 2 || reg == 3 ) ) {
+
+            insn.flow = ControlFlow::indirect_call;
+        }
+        else if ( ( op == 0xFF && ( reg == 4 || reg == 5 ) ) || op == 0xC2 || op == 0xC3 || op == 0xCA || op == 0xCB || op == 0xCF ) {
+
+            insn.flow = ControlFlow::absolute_jump;
+        }
+    }
+
+    i += immediate;
+
+    if ( i > size ) {
+        return false;
+    }
+
+    insn.length = i;
+    return true;
+}
+
+
+}